@@ -0,0 +1,70 @@
+// Acquire/release throughput of DbPool (mutex + condition variable) vs LockFreeDbPool.
+// usage: bench_dbpool [iterations per thread] [pool capacity]  (configure with -DCMAKE_BUILD_TYPE=Release)
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "dbpool.hpp"
+
+namespace {
+
+class NullConn final : public SQLConnection {
+public:
+    void connect(const std::string&) override { }
+    void disconnect() override { }
+    std::unique_ptr<SQLStatement> prepare(const std::string&, int) override { return nullptr; }
+    bool begin() override { return true; }
+    bool commit() override { return true; }
+    void rollback() override { }
+    int64_t nextValue(std::string) override { return 0; }
+};
+
+struct Result {
+    double seconds;
+    long ops;
+    long failed;
+};
+
+Result run(pool::IDbPool& pool, int threads, long iterations) {
+    std::vector<std::thread> workers;
+    std::vector<long> failed(threads, 0);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (long i = 0; i < iterations; ++i) {
+                auto r = pool.acquire(pool::DbIntent::Write, std::chrono::seconds(30));
+                if (!r.ok) ++failed[t];
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+    long f = 0;
+    for (long x : failed) f += x;
+    return { dt.count(), threads * iterations, f };
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const long iterations = argc > 1 ? std::atol(argv[1]) : 200000;
+    const std::size_t capacity = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8;
+    auto factory = [] { return std::make_unique<NullConn>(); };
+
+    std::printf("pool capacity %zu, %ld acquire/release per thread\n", capacity, iterations);
+    std::printf("%8s %16s %16s %8s\n", "threads", "DbPool ops/s", "LockFree ops/s", "speedup");
+    for (int threads : { 1, 8, 32, 128 }) {
+        const long per_thread = std::max(1L, iterations * 8 / std::max(8, threads)); // similar total work
+        DbPool locked(capacity, "", factory);
+        LockFreeDbPool lockfree(capacity, "", factory);
+        Result a = run(locked, threads, per_thread);
+        Result b = run(lockfree, threads, per_thread);
+        const double ra = a.ops / a.seconds, rb = b.ops / b.seconds;
+        std::printf("%8d %16.0f %16.0f %7.2fx", threads, ra, rb, rb / ra);
+        if (a.failed || b.failed) std::printf("  (timeouts: %ld / %ld)", a.failed, b.failed);
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * aio - minimal C++20 coroutine support for the pool and the connections
+ *  - Task<T>: lazy, single-awaiter coroutine; exceptions propagate to the awaiter
+ *  - EventLoop: one thread's epoll reactor (fd readiness, timers, cross-thread post)
+ *  - run(loop, task): drive a task to completion on the calling thread
+ * Awaiting code that finds no EventLoop::current() falls back to blocking calls, so the same
+ * coroutine also works from plain threads.
+ */
+namespace aio {
+
+template <class T = void>
+class Task;
+
+namespace detail {
+
+    // resumes whoever awaited the task when it finishes (symmetric transfer: no stack growth)
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) const noexcept {
+            auto next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() const noexcept { }
+    };
+
+    struct PromiseBase {
+        std::coroutine_handle<> continuation {};
+        std::exception_ptr error {};
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() noexcept { error = std::current_exception(); }
+    };
+
+    template <class T>
+    struct Promise : PromiseBase {
+        std::optional<T> value;
+        Task<T> get_return_object() noexcept;
+        template <class U>
+        void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+        T take() {
+            if (error) std::rethrow_exception(error);
+            return std::move(*value);
+        }
+    };
+
+    template <>
+    struct Promise<void> : PromiseBase {
+        Task<void> get_return_object() noexcept;
+        void return_void() const noexcept { }
+        void take() const {
+            if (error) std::rethrow_exception(error);
+        }
+    };
+
+} // namespace detail
+
+template <class T>
+class Task {
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle h) noexcept
+        : h_(h) { }
+    Task(Task&& o) noexcept
+        : h_(std::exchange(o.h_, {})) { }
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) {
+            if (h_) h_.destroy();
+            h_ = std::exchange(o.h_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (h_) h_.destroy();
+    }
+
+    bool done() const noexcept { return !h_ || h_.done(); }
+
+    // co_await task: starts it, resumes the awaiter when it finishes
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            Handle h;
+            bool await_ready() const noexcept { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+                h.promise().continuation = caller;
+                return h;
+            }
+            T await_resume() { return h.promise().take(); }
+        };
+        return Awaiter { h_ };
+    }
+
+private:
+    Handle h_;
+};
+
+namespace detail {
+    template <class T>
+    Task<T> Promise<T>::get_return_object() noexcept { return Task<T> { std::coroutine_handle<Promise<T>>::from_promise(*this) }; }
+    inline Task<void> Promise<void>::get_return_object() noexcept { return Task<void> { std::coroutine_handle<Promise<void>>::from_promise(*this) }; }
+} // namespace detail
+
+/**
+ * EventLoop
+ *  - Runs on one thread at a time (run()/run_until()); everything below except post() and stop()
+ *    must be called from that thread, i.e. from coroutines it resumes
+ *  - readable()/writable(): one-shot epoll readiness, one waiter per fd
+ *  - Timers are a small ordered map: few and short-lived (acquire timeouts, sleeps)
+ *  - post() and stop() are thread-safe (eventfd wakeup); posted handles resume on the loop thread
+ */
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Timer = std::pair<Clock::time_point, uint64_t>;
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // loop running on this thread, nullptr outside run()/run_until()
+    static EventLoop* current();
+
+    void post(std::coroutine_handle<> h);
+    void stop();
+
+    void run(); // until stop()
+    template <class Pred>
+    void run_until(Pred done) {
+        while (!done()) run_once_(true);
+    }
+
+    Timer add_timer(Clock::time_point at, std::function<void()> fn);
+    void cancel_timer(const Timer& t); // no-op once fired
+
+    struct FdAwaiter {
+        EventLoop& loop;
+        int fd;
+        uint32_t events;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { loop.watch_(fd, events, h); }
+        void await_resume() const noexcept { }
+    };
+    FdAwaiter readable(int fd);
+    FdAwaiter writable(int fd);
+
+    struct SleepAwaiter {
+        EventLoop& loop;
+        Clock::time_point at;
+        bool await_ready() const noexcept { return Clock::now() >= at; }
+        void await_suspend(std::coroutine_handle<> h) {
+            loop.add_timer(at, [l = &loop, h] { l->post(h); });
+        }
+        void await_resume() const noexcept { }
+    };
+    SleepAwaiter sleep_until(Clock::time_point at) { return { *this, at }; }
+    SleepAwaiter sleep_for(Clock::duration d) { return { *this, Clock::now() + d }; }
+
+private:
+    void run_once_(bool block);
+    void watch_(int fd, uint32_t events, std::coroutine_handle<> h);
+
+    int epfd_ { -1 };
+    int wakefd_ { -1 };
+    bool stop_ { false };
+    uint64_t timer_seq_ { 0 };
+    std::map<Timer, std::function<void()>> timers_;
+    std::map<int, std::coroutine_handle<>> fds_; // fd -> waiter
+
+    std::mutex mx_; // posted_ and stop_ from other threads
+    std::vector<std::coroutine_handle<>> posted_;
+};
+
+namespace detail {
+    // self-destroying root coroutine used by run(); starts when the loop resumes it
+    struct Detached {
+        std::coroutine_handle<> h;
+        struct promise_type {
+            Detached get_return_object() noexcept { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept { }
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    template <class T>
+    Detached drive(Task<T>& task, std::optional<T>& out, std::exception_ptr& err, bool& done) {
+        try {
+            out.emplace(co_await std::move(task));
+        } catch (...) {
+            err = std::current_exception();
+        }
+        done = true;
+    }
+
+    inline Detached drive(Task<void>& task, std::exception_ptr& err, bool& done) {
+        try {
+            co_await std::move(task);
+        } catch (...) {
+            err = std::current_exception();
+        }
+        done = true;
+    }
+
+    inline Detached own(Task<void> task) { co_await std::move(task); }
+} // namespace detail
+
+// Start @p task on @p loop and let it run on its own; an exception escaping it terminates
+inline void spawn(EventLoop& loop, Task<void> task) { loop.post(detail::own(std::move(task)).h); }
+
+// Run @p task to completion on this thread, driving @p loop meanwhile; rethrows its exception
+template <class T>
+T run(EventLoop& loop, Task<T> task) {
+    std::exception_ptr err;
+    bool done = false;
+    if constexpr (std::is_void_v<T>) {
+        loop.post(detail::drive(task, err, done).h);
+        loop.run_until([&] { return done; });
+        if (err) std::rethrow_exception(err);
+    } else {
+        std::optional<T> out;
+        loop.post(detail::drive(task, out, err, done).h);
+        loop.run_until([&] { return done; });
+        if (err) std::rethrow_exception(err);
+        return std::move(*out);
+    }
+}
+
+} // namespace aio
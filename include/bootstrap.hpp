@@ -11,7 +11,7 @@ static constexpr const char *SCHEMA_CATALOG_JSON = R"JSON(
                 "id": {
                 "type": "integer",
                 "idprop": true,
-                "idkind": "DBSerial"
+                "idkind": "snowflake"
                 },
                 "name": {
                 "type": "string",
@@ -48,10 +48,10 @@ static constexpr const char *SCHEMA_VERSIONS_JSON = R"JSON(
                 "id": {
                 "type": "integer",
                 "idprop": true,
-                "idkind": "DBSerial"
+                "idkind": "snowflake"
                 },
                 "schema": {
-                "type": "object",
+                "type": "integer",
                 "schema": "schema_catalog",
                 "prop": "id",
                 "relation": "one-to-many"
@@ -60,7 +60,6 @@ static constexpr const char *SCHEMA_VERSIONS_JSON = R"JSON(
                 "type": "integer",
                 "minimum": 1,
                 "default": "1"
-                "unique": true
                 },
                 "applied": {
                 "type": "boolean",
@@ -1,18 +1,30 @@
 #pragma once
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdio>
+#include <algorithm>
 #include <deque>
+#include <exception>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <source_location>
+#include <thread>
 #include <sqlconnection.hpp>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "aio.hpp"
+#include "histogram.hpp"
 #include "lib.hpp"
 
 using PConn = std::shared_ptr<SQLConnection>;
 
 PSQLConnection make_postgres_connection();
 PSQLConnection make_sqlite_connection();
+PSQLConnection make_sqlite_reader_connection(); // SQLITE_OPEN_READONLY
 
 namespace pool {
 
@@ -21,15 +33,111 @@ enum class DbIntent { Read,
 enum class PoolAcquireError { Timeout,
     Shutdown };
 
+// DbPool wait queue order: arrival (ticket) order, or one intent strictly ahead of the other
+// (FIFO within each intent; the other intent only gets connections nobody preferred is waiting for)
+enum class WaitPriority { Fifo,
+    Writes,
+    Reads };
+
 struct PoolStats {
     std::size_t size { 0 };
     std::size_t in_use { 0 };
     std::size_t waiters { 0 };
+
+    // monotonic since construction
+    uint64_t acquired { 0 };  // successful acquires
+    uint64_t timeouts { 0 };  // PoolAcquireError::Timeout
+    uint64_t shutdowns { 0 }; // PoolAcquireError::Shutdown
+};
+
+// Latency distributions (microseconds), indexed by DbIntent
+struct PoolLatency {
+    HistogramSnapshot wait[2]; // acquire() call -> lease handed out
+    HistogramSnapshot hold[2]; // lease handed out -> returned
+
+    const HistogramSnapshot& wait_of(DbIntent i) const { return wait[static_cast<int>(i)]; }
+    const HistogramSnapshot& hold_of(DbIntent i) const { return hold[static_cast<int>(i)]; }
+
+    void merge(const PoolLatency& o) {
+        for (int i = 0; i < 2; ++i) {
+            wait[i].merge(o.wait[i]);
+            hold[i].merge(o.hold[i]);
+        }
+    }
+};
+
+/**
+ * PoolMetrics
+ *  - Recording side of PoolStats counters and PoolLatency, shared by the pools
+ *  - Relaxed atomics only: recording never takes a lock, reading never blocks recorders
+ */
+class PoolMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void acquired(DbIntent i, Clock::duration waited) {
+        acquired_.fetch_add(1, std::memory_order_relaxed);
+        wait_[static_cast<int>(i)].record(waited);
+    }
+    void released(DbIntent i, Clock::duration held) { hold_[static_cast<int>(i)].record(held); }
+    void failed(PoolAcquireError e) {
+        (e == PoolAcquireError::Timeout ? timeouts_ : shutdowns_).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void fill(PoolStats& s) const {
+        s.acquired = acquired_.load(std::memory_order_relaxed);
+        s.timeouts = timeouts_.load(std::memory_order_relaxed);
+        s.shutdowns = shutdowns_.load(std::memory_order_relaxed);
+    }
+
+    PoolLatency latency() const {
+        PoolLatency l;
+        for (int i = 0; i < 2; ++i) {
+            l.wait[i] = wait_[i].snapshot();
+            l.hold[i] = hold_[i].snapshot();
+        }
+        return l;
+    }
+
+private:
+    std::atomic<uint64_t> acquired_ { 0 };
+    std::atomic<uint64_t> timeouts_ { 0 };
+    std::atomic<uint64_t> shutdowns_ { 0 };
+    Histogram wait_[2];
+    Histogram hold_[2];
+};
+
+// An outstanding lease: who took the connection, where and for how long
+struct LeaseInfo {
+    uint64_t id { 0 };
+    DbIntent intent { DbIntent::Read };
+    std::chrono::steady_clock::time_point acquired {};
+    std::chrono::milliseconds held { 0 }; // at snapshot/report time
+    std::source_location where {};        // acquire() call site
+    std::thread::id thread {};
+    bool overdue { false };               // exceeded max_lease_time (reported once)
 };
 
 struct AcquirePolicy {
     std::chrono::milliseconds acquire_timeout { 1500 }; // never block forever
     std::chrono::milliseconds max_lease_time { 0 }; // 0 = disabled (tests/guardrail)
+
+    // max_lease_time watchdog (DbPool): report overdue leases, optionally cancel their query
+    bool cancel_overdue { false };                           // SQLConnection::cancel()
+    std::function<void(const LeaseInfo&)> on_overdue {};     // default: one line on stderr
+
+    // elastic sizing (DbPool)
+    std::size_t min_size { 0 }; // opened by the constructor and never reaped
+    std::size_t max_size { 0 }; // 0 = the pool capacity
+    std::chrono::milliseconds idle_timeout { 0 }; // close connections idle this long above min_size; 0 = never
+
+    // health (DbPool): SQLConnection::healthy() on every handout/return, ping() after idling this long
+    std::chrono::milliseconds ping_after_idle { 0 }; // 0 = never ping
+    std::chrono::milliseconds reconnect_backoff_min { 50 };   // after a failed connect, doubling
+    std::chrono::milliseconds reconnect_backoff_max { 10000 }; // up to this
+
+    // wait queue (DbPool): who gets the next connection when several threads wait
+    WaitPriority wait_priority { WaitPriority::Fifo };
 };
 
 // Forward decl
@@ -90,12 +198,27 @@ public:
     };
 
     virtual AcquireResult acquire(DbIntent intent,
-        std::chrono::milliseconds timeoutOverride = std::chrono::milliseconds::zero())
+        std::chrono::milliseconds timeoutOverride = std::chrono::milliseconds::zero(),
+        std::source_location where = std::source_location::current())
         = 0;
 
+    // Awaitable acquire for coroutines running on an aio::EventLoop: waiting for a connection
+    // suspends the coroutine instead of the thread. The default blocks in acquire().
+    virtual aio::Task<AcquireResult> co_acquire(DbIntent intent,
+        std::chrono::milliseconds timeoutOverride = std::chrono::milliseconds::zero(),
+        std::source_location where = std::source_location::current()) {
+        co_return acquire(intent, timeoutOverride, where);
+    }
+
     virtual PoolStats stats() const = 0;
     virtual void shutdown() = 0;
 
+    // snapshot of outstanding leases (pools that track them)
+    virtual std::vector<LeaseInfo> leases() const { return {}; }
+
+    // wait/hold time histograms (pools that record them); copies the buckets, takes no pool lock
+    virtual PoolLatency latency() const { return {}; }
+
 protected:
     // Only pools are allowed to “return” leases:
     virtual void release(std::shared_ptr<SQLConnection> conn, DbIntent intent) = 0;
@@ -105,7 +228,7 @@ protected:
 // Lease releases back to its owner (no friend gymnastics)
 inline void Lease::release_() {
     if (owner_ && conn_) {
-        owner_->release(conn_, intent_);
+        owner_->release(std::move(conn_), intent_); // hand the reference over, no refcount traffic
     }
     owner_ = nullptr;
     conn_.reset();
@@ -113,64 +236,158 @@ inline void Lease::release_() {
 
 } // namespace mapper
 
+/**
+ * DbPool
+ *  - Elastic: min_size connections are opened up front, the rest on demand up to max_size
+ *  - Waiters queue with a ticket and are served strictly in order (FIFO, or writes/reads first per
+ *    wait_priority): only the head of the queue takes an idle connection or opens one, so a newcomer
+ *    never overtakes a thread already waiting; each waiter has its own condition variable and
+ *    release() wakes just the head; co_acquire() coroutines queue alongside and are resumed through
+ *    their aio::EventLoop
+ *  - Growth is driven by waiters: the head opens a new connection and leaves the queue while
+ *    connecting, so the next waiter can open another one in parallel
+ *  - Connects run outside the pool lock; a failed connect is rethrown to the acquiring caller
+ *  - Idle connections are reused LIFO; the coldest ones above min_size are closed once idle
+ *    for idle_timeout (on release() or reap())
+ *  - Health: healthy() is checked on return and on handout, ping() after ping_after_idle or when
+ *    the connection sat idle across a detected failure (failover); broken connections are dropped
+ *    and replaced through the factory, with exponential backoff between failed connects
+ *  - Metrics: acquire/timeout/shutdown counters in stats(), wait and hold histograms in latency()
+ */
 class DbPool final : public pool::IDbPool {
 public:
     DbPool(std::size_t capacity,
         std::string dsn,
         std::function<PSQLConnection()> factory,
         pool::AcquirePolicy policy = {})
-        : cap_(capacity)
+        : max_(policy.max_size ? policy.max_size : capacity)
+        , min_(std::min(policy.min_size, max_))
         , dsn_(std::move(dsn))
         , factory_(std::move(factory))
         , policy_(policy) { load_(); }
 
+    ~DbPool() override { stop_watchdog_(); }
+
     AcquireResult acquire(
         pool::DbIntent intent,
-        std::chrono::milliseconds to = std::chrono::milliseconds::zero()) override {
-        auto deadline = std::chrono::steady_clock::now() + (to.count() ? to : policy_.acquire_timeout);
+        std::chrono::milliseconds to = std::chrono::milliseconds::zero(),
+        std::source_location where = std::source_location::current()) override {
+        const auto start = std::chrono::steady_clock::now();
+        auto deadline = start + (to.count() ? to : policy_.acquire_timeout);
 
         std::unique_lock<std::mutex> lk(mx_);
         ++stats_.waiters;
-        auto on_exit = Finally([&]() { --stats_.waiters; });
-
-        while (!shutdown_ && free_.empty()) {
-            if (cv_.wait_until(lk, deadline) == std::cv_status::timeout) {
-                return { false, { nullptr, nullptr, pool::DbIntent::Read }, pool::PoolAcquireError::Timeout };
-            }
-        }
-        if (shutdown_) {
-            return { false, { nullptr, nullptr, pool::DbIntent::Read }, pool::PoolAcquireError::Shutdown };
+        Waiter me { ++ticket_seq_, intent };
+        enqueue_(me);
+        auto on_exit = Finally([&]() {
+            --stats_.waiters;
+            dequeue_(me);
+        });
+
+        for (;;) {
+            std::chrono::steady_clock::time_point wake;
+            if (auto r = attempt_(me, lk, where, start, deadline, wake)) return std::move(*r);
+            me.cv.wait_until(lk, wake);
         }
+    }
 
-        auto conn = std::move(free_.front());
-        free_.pop_front();
-        ++stats_.in_use;
+    // Same queue as acquire(), but a waiting coroutine is parked on its EventLoop instead of
+    // blocking the thread; ping/connect still run inline on the loop thread
+    aio::Task<AcquireResult> co_acquire(
+        pool::DbIntent intent,
+        std::chrono::milliseconds to = std::chrono::milliseconds::zero(),
+        std::source_location where = std::source_location::current()) override {
+        aio::EventLoop* loop = aio::EventLoop::current();
+        if (!loop) co_return acquire(intent, to, where);
+        const auto start = std::chrono::steady_clock::now();
+        auto deadline = start + (to.count() ? to : policy_.acquire_timeout);
 
-        return { true, pool::Lease { this, std::move(conn), intent }, {} };
+        std::unique_lock<std::mutex> lk(mx_);
+        ++stats_.waiters;
+        Waiter me { ++ticket_seq_, intent };
+        me.loop = loop;
+        enqueue_(me);
+        auto on_exit = Finally([&]() {
+            --stats_.waiters;
+            dequeue_(me);
+        });
+
+        for (;;) {
+            std::chrono::steady_clock::time_point wake;
+            if (auto r = attempt_(me, lk, where, start, deadline, wake)) co_return std::move(*r);
+            co_await Park { *this, me, lk, wake };
+        }
     }
 
+    // size = open connections (including connects in flight)
     pool::PoolStats stats() const override {
         std::lock_guard<std::mutex> lk(mx_);
         auto s = stats_;
-        s.size = cap_;
+        s.size = size_;
+        metrics_.fill(s);
         return s;
     }
 
+    pool::PoolLatency latency() const override { return metrics_.latency(); }
+
     void shutdown() override {
+        std::deque<Idle> closing;
+        {
+            std::lock_guard<std::mutex> lk(mx_);
+            shutdown_ = true;
+            size_ -= free_.size();
+            closing.swap(free_);
+            for (const auto& q : queue_)
+                for (Waiter* w : q) wake_(*w);
+        }
+        stop_watchdog_();
+    }
+
+    std::vector<pool::LeaseInfo> leases() const override {
         std::lock_guard<std::mutex> lk(mx_);
-        shutdown_ = true;
-        cv_.notify_all();
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<pool::LeaseInfo> out;
+        out.reserve(leased_.size());
+        for (const auto& [conn, t] : leased_) {
+            out.push_back(t.info);
+            out.back().held = std::chrono::duration_cast<std::chrono::milliseconds>(now - t.info.acquired);
+        }
+        std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+        return out;
     }
 
+    // Close connections idle longer than idle_timeout, keeping min_size open
+    void reap() {
+        std::vector<std::shared_ptr<SQLConnection>> closing;
+        {
+            std::lock_guard<std::mutex> lk(mx_);
+            reap_(closing);
+        }
+    } // disconnects happen here, outside the lock
+
 protected:
-    void release(std::shared_ptr<SQLConnection> conn, pool::DbIntent) override {
-        std::lock_guard<std::mutex> lk(mx_);
-        if (conn && !shutdown_) {
-            free_.push_back(std::move(conn));
+    void release(std::shared_ptr<SQLConnection> conn, pool::DbIntent intent) override {
+        std::vector<std::shared_ptr<SQLConnection>> closing;
+        {
+            std::lock_guard<std::mutex> lk(mx_);
+            if (stats_.in_use)
+                --stats_.in_use;
+            if (auto it = conn ? leased_.find(conn.get()) : leased_.end(); it != leased_.end()) {
+                metrics_.released(intent, std::chrono::steady_clock::now() - it->second.info.acquired);
+                leased_.erase(it);
+            }
+            if (conn) {
+                if (shutdown_ || !conn->healthy()) { // broken connections are replaced on demand
+                    if (!shutdown_) broken_at_ = std::chrono::steady_clock::now();
+                    --size_;
+                    closing.push_back(std::move(conn));
+                } else {
+                    free_.push_back({ std::move(conn), std::chrono::steady_clock::now() });
+                    reap_(closing);
+                }
+            }
+            wake_head_();
         }
-        if (stats_.in_use)
-            --stats_.in_use;
-        cv_.notify_one();
     }
 
 private:
@@ -195,30 +412,548 @@ private:
         }
     };
 
+    struct Idle {
+        std::shared_ptr<SQLConnection> conn;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    // a thread blocked in acquire() or a coroutine parked in co_acquire(), woken individually
+    struct Waiter {
+        uint64_t ticket;
+        pool::DbIntent intent;
+        std::condition_variable cv {};
+        bool queued { false };
+        // co_acquire(): resumed through its loop instead of cv
+        aio::EventLoop* loop { nullptr };
+        std::coroutine_handle<> handle {};
+        bool parked { false };
+        aio::EventLoop::Timer timer {};
+    };
+
+    // suspends a co_acquire() waiter until wake_() or its timer, without holding mx_
+    struct Park {
+        DbPool& pool;
+        Waiter& me;
+        std::unique_lock<std::mutex>& lk;
+        std::chrono::steady_clock::time_point wake;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            me.handle = h;
+            me.parked = true;
+            me.timer = me.loop->add_timer(wake, [p = &pool, w = &me] {
+                std::lock_guard<std::mutex> g(p->mx_);
+                p->wake_(*w);
+            });
+            lk.unlock();
+        }
+        void await_resume() {
+            me.loop->cancel_timer(me.timer); // loop thread, like the timer itself
+            lk.lock();
+        }
+    };
+
+    // caller holds mx_. One pass of the acquire loop for @p me: a result (lease, shutdown, timeout)
+    // or nullopt with @p wake set to when to look again
+    std::optional<AcquireResult> attempt_(Waiter& me, std::unique_lock<std::mutex>& lk,
+        const std::source_location& where, std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point deadline, std::chrono::steady_clock::time_point& wake) {
+        const pool::DbIntent intent = me.intent;
+        for (;;) {
+            if (shutdown_) {
+                return fail_(pool::PoolAcquireError::Shutdown);
+            }
+            auto now = std::chrono::steady_clock::now();
+            const bool turn = head_() == &me; // only the head of the queue may take or open a connection
+            if (turn && !free_.empty()) {
+                Idle idle = std::move(free_.back()); // hottest first
+                free_.pop_back();
+                if (!idle.conn->healthy()) {
+                    drop_(std::move(idle.conn), lk);
+                    continue;
+                }
+                // idle long enough to have gone stale, or idle across a detected failure: ping first
+                const bool stale = policy_.ping_after_idle.count() > 0 && now - idle.since >= policy_.ping_after_idle;
+                if (stale || idle.since <= broken_at_) {
+                    lk.unlock();
+                    bool alive = false;
+                    try {
+                        alive = idle.conn->ping();
+                    } catch (...) { }
+                    lk.lock();
+                    if (!alive) {
+                        drop_(std::move(idle.conn), lk);
+                        continue;
+                    }
+                }
+                return take_(std::move(idle.conn), intent, where, start);
+            }
+            if (turn && size_ < max_ && now >= retry_at_) {
+                // grow by one (or replace a dropped connection): reserve the slot, connect without the lock;
+                // the next waiter gets its turn meanwhile, so connects run in parallel up to max_size
+                ++size_;
+                dequeue_(me);
+                lk.unlock();
+                std::shared_ptr<SQLConnection> conn;
+                std::exception_ptr err;
+                try {
+                    conn = open_();
+                } catch (...) {
+                    err = std::current_exception();
+                }
+                lk.lock();
+                if (err) {
+                    --size_;
+                    backoff_();
+                    wake_head_(); // another waiter may retry
+                    std::rethrow_exception(err);
+                }
+                connect_failures_ = 0;
+                retry_at_ = {};
+                if (shutdown_) {
+                    --size_;
+                    continue;
+                }
+                return take_(std::move(conn), intent, where, start);
+            }
+            if (now >= deadline) {
+                return fail_(pool::PoolAcquireError::Timeout);
+            }
+            // reconnect backoff: the head wakes up when the next connect is allowed
+            wake = deadline;
+            if (turn && size_ < max_ && retry_at_ > now && retry_at_ < deadline) wake = retry_at_;
+            return std::nullopt;
+        }
+    }
+
+    // caller holds mx_
+    void enqueue_(Waiter& w) {
+        queue_[static_cast<int>(w.intent)].push_back(&w);
+        w.queued = true;
+    }
+
+    // caller holds mx_; the next head is woken when w had the turn
+    void dequeue_(Waiter& w) {
+        if (!w.queued) return;
+        const bool was_head = head_() == &w;
+        auto& q = queue_[static_cast<int>(w.intent)];
+        q.erase(std::find(q.begin(), q.end(), &w));
+        w.queued = false;
+        if (was_head) wake_head_();
+    }
+
+    // caller holds mx_: oldest ticket, or the oldest of the preferred intent
+    Waiter* head_() const {
+        const auto& r = queue_[static_cast<int>(pool::DbIntent::Read)];
+        const auto& w = queue_[static_cast<int>(pool::DbIntent::Write)];
+        if (r.empty()) return w.empty() ? nullptr : w.front();
+        if (w.empty()) return r.front();
+        switch (policy_.wait_priority) {
+        case pool::WaitPriority::Writes: return w.front();
+        case pool::WaitPriority::Reads: return r.front();
+        default: return w.front()->ticket < r.front()->ticket ? w.front() : r.front();
+        }
+    }
+
+    // caller holds mx_
+    void wake_(Waiter& w) {
+        if (!w.loop) {
+            w.cv.notify_one();
+        } else if (w.parked) { // at most one resume per park
+            w.parked = false;
+            w.loop->post(w.handle);
+        }
+    }
+
+    void wake_head_() {
+        if (Waiter* h = head_()) wake_(*h);
+    }
+
+    struct Tracked {
+        pool::LeaseInfo info;
+        std::weak_ptr<SQLConnection> conn; // for cancel(), without keeping it alive
+    };
+
+    // caller holds mx_
+    AcquireResult take_(std::shared_ptr<SQLConnection>&& conn, pool::DbIntent intent,
+        const std::source_location& where, std::chrono::steady_clock::time_point start) {
+        ++stats_.in_use;
+        metrics_.acquired(intent, track_(conn, intent, where).acquired - start);
+        return { true, pool::Lease { this, std::move(conn), intent }, {} };
+    }
+
+    AcquireResult fail_(pool::PoolAcquireError e) {
+        metrics_.failed(e);
+        return { false, { nullptr, nullptr, pool::DbIntent::Read }, e };
+    }
+
+    // caller holds mx_
+    const pool::LeaseInfo& track_(const std::shared_ptr<SQLConnection>& conn, pool::DbIntent intent, const std::source_location& where) {
+        Tracked& t = leased_[conn.get()];
+        t.info = { ++lease_seq_, intent, std::chrono::steady_clock::now(), std::chrono::milliseconds(0),
+            where, std::this_thread::get_id(), false };
+        t.conn = conn;
+        return t.info;
+    }
+
+    // max_lease_time watchdog: wakes a few times per limit, reports each overdue lease once
+    void start_watchdog_() {
+        if (policy_.max_lease_time.count() <= 0) return;
+        const auto period = std::clamp(policy_.max_lease_time / 4,
+            std::chrono::milliseconds(5), std::chrono::milliseconds(1000));
+        watchdog_ = std::thread([this, period] {
+            std::unique_lock<std::mutex> lk(mx_);
+            while (!wd_stop_) {
+                wd_cv_.wait_for(lk, period, [this] { return wd_stop_; });
+                if (wd_stop_) break;
+                const auto now = std::chrono::steady_clock::now();
+                std::vector<Tracked> overdue;
+                for (auto& [conn, t] : leased_) {
+                    if (t.info.overdue || now - t.info.acquired < policy_.max_lease_time) continue;
+                    t.info.overdue = true;
+                    t.info.held = std::chrono::duration_cast<std::chrono::milliseconds>(now - t.info.acquired);
+                    overdue.push_back(t);
+                }
+                if (overdue.empty()) continue;
+                lk.unlock(); // report/cancel without blocking the pool
+                for (const auto& t : overdue) report_overdue_(t);
+                lk.lock();
+            }
+        });
+    }
+
+    void stop_watchdog_() {
+        {
+            std::lock_guard<std::mutex> lk(mx_);
+            wd_stop_ = true;
+        }
+        wd_cv_.notify_all();
+        if (watchdog_.joinable() && watchdog_.get_id() != std::this_thread::get_id()) watchdog_.join();
+    }
+
+    void report_overdue_(const Tracked& t) {
+        if (policy_.on_overdue) {
+            policy_.on_overdue(t.info);
+        } else {
+            std::fprintf(stderr, "DbPool: lease #%llu held %lld ms (max_lease_time %lld ms), acquired at %s:%u in %s\n",
+                static_cast<unsigned long long>(t.info.id), static_cast<long long>(t.info.held.count()),
+                static_cast<long long>(policy_.max_lease_time.count()),
+                t.info.where.file_name(), t.info.where.line(), t.info.where.function_name());
+        }
+        if (policy_.cancel_overdue) {
+            if (auto conn = t.conn.lock()) conn->cancel();
+        }
+    }
+
+    // caller holds mx_ (released while the connection closes); the slot is free for a replacement
+    void drop_(std::shared_ptr<SQLConnection>&& conn, std::unique_lock<std::mutex>& lk) {
+        --size_;
+        broken_at_ = std::chrono::steady_clock::now(); // other idle connections are suspect now
+        lk.unlock();
+        conn.reset();
+        lk.lock();
+    }
+
+    // caller holds mx_: exponential backoff between failed connects (reconnect storms)
+    void backoff_() {
+        ++connect_failures_;
+        auto delay = policy_.reconnect_backoff_min;
+        for (unsigned i = 1; i < connect_failures_ && delay < policy_.reconnect_backoff_max; ++i) delay *= 2;
+        retry_at_ = std::chrono::steady_clock::now() + std::min(delay, policy_.reconnect_backoff_max);
+        broken_at_ = std::chrono::steady_clock::now();
+    }
+
+    std::shared_ptr<SQLConnection> open_() {
+        if (!factory_) THROW("DbPool: null connection factory");
+        PSQLConnection up = factory_();
+        if (!up) THROW("DbPool: factory returned null connection");
+        up->connect(dsn_);
+        // move unique_ptr -> shared_ptr with custom deleter
+        return std::shared_ptr<SQLConnection>(up.release(), [](SQLConnection* p) { delete p; });
+    }
+
+    // caller holds mx_; the coldest idle connections sit at the front
+    void reap_(std::vector<std::shared_ptr<SQLConnection>>& closing) {
+        if (policy_.idle_timeout.count() <= 0) return;
+        const auto cutoff = std::chrono::steady_clock::now() - policy_.idle_timeout;
+        while (size_ > min_ && !free_.empty() && free_.front().since <= cutoff) {
+            closing.push_back(std::move(free_.front().conn));
+            free_.pop_front();
+            --size_;
+        }
+    }
+
     void load_() {
         std::lock_guard<std::mutex> lk(mx_);
         free_.clear();
-        for (std::size_t i = 0; i < cap_; ++i) {
-            if (!factory_) THROW("DbPool: null connection factory");
-            PSQLConnection up = factory_();
-            if (!up) THROW("DbPool: factory returned null connection");
-            up->connect(dsn_);
-            // move unique_ptr -> shared_ptr with custom deleter
-            std::shared_ptr<SQLConnection> sp(up.release(), [](SQLConnection* p) { delete p; });
-            free_.push_back(std::move(sp));
-        }
         stats_ = {};
-        stats_.size = cap_;
+        size_ = 0;
+        for (std::size_t i = 0; i < min_; ++i) {
+            free_.push_back({ open_(), std::chrono::steady_clock::now() });
+            ++size_;
+        }
+        start_watchdog_();
     }
 
-    std::size_t cap_;
+    std::size_t max_;
+    std::size_t min_;
     std::string dsn_;
+    std::function<PSQLConnection()> factory_;
     pool::AcquirePolicy policy_;
 
     mutable std::mutex mx_;
-    std::condition_variable cv_;
-    std::deque<std::shared_ptr<SQLConnection>> free_;
+    std::deque<Idle> free_; // back = most recently released
+    std::deque<Waiter*> queue_[2]; // per DbIntent, ticket order
+    uint64_t ticket_seq_ { 0 };
+    std::size_t size_ { 0 }; // open + opening
     bool shutdown_ { false };
     pool::PoolStats stats_;
-    std::function<PSQLConnection()> factory_;
+    pool::PoolMetrics metrics_;
+
+    std::chrono::steady_clock::time_point broken_at_ {}; // last broken connection / failed connect
+    std::chrono::steady_clock::time_point retry_at_ {};  // no connect before this (backoff)
+    unsigned connect_failures_ { 0 };
+
+    std::unordered_map<const SQLConnection*, Tracked> leased_; // outstanding leases
+    uint64_t lease_seq_ { 0 };
+    std::thread watchdog_;
+    std::condition_variable wd_cv_;
+    bool wd_stop_ { false };
+};
+
+/**
+ * LockFreeDbPool
+ *  - Fixed set of connections opened up front, like DbPool
+ *  - Free connections sit on a lock-free LIFO (Treiber stack of slot indexes, ABA-tagged head):
+ *    an uncontended acquire/release is one CAS each - no mutex, no allocation, no refcount change
+ *    (the connection's shared_ptr is moved between its slot and the Lease)
+ *  - Only when the pool is exhausted does acquire() fall back to the mutex + condition variable;
+ *    release() takes the mutex only if someone is waiting
+ */
+class LockFreeDbPool final : public pool::IDbPool {
+public:
+    LockFreeDbPool(std::size_t capacity,
+        std::string dsn,
+        std::function<PSQLConnection()> factory,
+        pool::AcquirePolicy policy = {})
+        : dsn_(std::move(dsn))
+        , policy_(policy)
+        , slots_(capacity)
+        , next_(capacity)
+        , since_(capacity) {
+        if (capacity == 0 || capacity >= 0xFFFFFFFFu) THROW("LockFreeDbPool: invalid capacity %zu", capacity);
+        if (!factory) THROW("LockFreeDbPool: null connection factory");
+        for (std::size_t i = 0; i < capacity; ++i) {
+            PSQLConnection up = factory();
+            if (!up) THROW("LockFreeDbPool: factory returned null connection");
+            up->connect(dsn_);
+            slots_[i] = std::shared_ptr<SQLConnection>(up.release());
+            index_[slots_[i].get()] = static_cast<uint32_t>(i);
+        }
+        for (std::size_t i = capacity; i-- > 0;) push_(static_cast<uint32_t>(i)); // slot 0 on top
+    }
+
+    AcquireResult acquire(
+        pool::DbIntent intent,
+        std::chrono::milliseconds to = std::chrono::milliseconds::zero(),
+        std::source_location = std::source_location::current()) override {
+        if (shutdown_.load(std::memory_order_acquire)) return fail_(pool::PoolAcquireError::Shutdown);
+
+        const auto start = std::chrono::steady_clock::now();
+        uint32_t i;
+        if (pop_(i)) return take_(i, intent, start); // fast path
+
+        // exhausted: wait for a release
+        auto deadline = start + (to.count() ? to : policy_.acquire_timeout);
+        std::unique_lock<std::mutex> lk(mx_);
+        waiters_.fetch_add(1); // seq_cst: pairs with the waiters_ check in release()
+        auto err = pool::PoolAcquireError::Timeout;
+        bool got = false;
+        for (;;) {
+            if (shutdown_.load()) { err = pool::PoolAcquireError::Shutdown; break; }
+            if ((got = pop_(i))) break;
+            if (cv_.wait_until(lk, deadline) == std::cv_status::timeout) { got = pop_(i); break; }
+        }
+        waiters_.fetch_sub(1);
+        lk.unlock();
+        return got ? take_(i, intent, start) : fail_(err);
+    }
+
+    pool::PoolStats stats() const override {
+        pool::PoolStats s;
+        s.size = slots_.size();
+        s.in_use = in_use_.load(std::memory_order_relaxed);
+        s.waiters = waiters_.load(std::memory_order_relaxed);
+        metrics_.fill(s);
+        return s;
+    }
+
+    pool::PoolLatency latency() const override { return metrics_.latency(); }
+
+    void shutdown() override {
+        std::lock_guard<std::mutex> lk(mx_);
+        shutdown_.store(true);
+        cv_.notify_all();
+    }
+
+protected:
+    void release(std::shared_ptr<SQLConnection> conn, pool::DbIntent intent) override {
+        if (!conn) return;
+        auto it = index_.find(conn.get()); // read-only after construction
+        if (it == index_.end()) return;    // not ours
+        const uint32_t i = it->second;
+        metrics_.released(intent, std::chrono::steady_clock::now() - since_[i]);
+        slots_[i] = std::move(conn);
+        in_use_.fetch_sub(1, std::memory_order_relaxed);
+        push_(i);
+        if (waiters_.load() > 0) { // seq_cst: a waiter either sees the push or is notified
+            std::lock_guard<std::mutex> lk(mx_);
+            cv_.notify_one();
+        }
+    }
+
+private:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    // head_ = (tag << 32) | (index + 1); 0 in the low half = empty
+    bool pop_(uint32_t& out) {
+        out = kNone;
+        uint64_t h = head_.load();
+        for (;;) {
+            const uint32_t top = static_cast<uint32_t>(h);
+            if (top == 0) return false;
+            const uint64_t nh = ((h >> 32) + 1) << 32 | next_[top - 1].load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(h, nh)) {
+                out = top - 1;
+                return true;
+            }
+        }
+    }
+
+    void push_(uint32_t i) {
+        uint64_t h = head_.load();
+        for (;;) {
+            next_[i].store(static_cast<uint32_t>(h), std::memory_order_relaxed);
+            const uint64_t nh = ((h >> 32) + 1) << 32 | (i + 1);
+            if (head_.compare_exchange_weak(h, nh)) return;
+        }
+    }
+
+    AcquireResult take_(uint32_t i, pool::DbIntent intent, std::chrono::steady_clock::time_point start) {
+        in_use_.fetch_add(1, std::memory_order_relaxed);
+        since_[i] = std::chrono::steady_clock::now(); // slot is ours until release() pushes it back
+        metrics_.acquired(intent, since_[i] - start);
+        return { true, pool::Lease { this, std::move(slots_[i]), intent }, {} };
+    }
+
+    AcquireResult fail_(pool::PoolAcquireError e) {
+        metrics_.failed(e);
+        return { false, { nullptr, nullptr, pool::DbIntent::Read }, e };
+    }
+
+    std::string dsn_;
+    pool::AcquirePolicy policy_;
+
+    std::vector<std::shared_ptr<SQLConnection>> slots_; // filled while the slot is free
+    std::vector<std::atomic<uint32_t>> next_;           // stack links (index + 1, 0 = end)
+    std::vector<std::chrono::steady_clock::time_point> since_; // lease start, written by the slot owner
+    std::unordered_map<const SQLConnection*, uint32_t> index_;
+    std::atomic<uint64_t> head_ { 0 };
+    std::atomic<std::size_t> in_use_ { 0 };
+    std::atomic<std::size_t> waiters_ { 0 };
+    std::atomic<bool> shutdown_ { false };
+    pool::PoolMetrics metrics_;
+
+    std::mutex mx_; // slow path only
+    std::condition_variable cv_;
+};
+
+/**
+ * SplitDbPool
+ *  - Read/write split over independent sub-pools: DbIntent::Write -> writer, DbIntent::Read -> readers
+ *  - Readers never queue behind writers (separate connections, separate waiters)
+ *  - Several reader pools (e.g. one per Postgres replica DSN) are used round-robin
+ *  - No readers: reads share the writer pool (e.g. SQLite :memory:)
+ * Leases are handed out by the sub-pools and return to them directly.
+ */
+class SplitDbPool final : public pool::IDbPool {
+public:
+    SplitDbPool(std::unique_ptr<pool::IDbPool> writer,
+        std::vector<std::unique_ptr<pool::IDbPool>> readers = {})
+        : writer_(std::move(writer))
+        , readers_(std::move(readers)) {
+        if (!writer_) THROW("SplitDbPool: null writer pool");
+    }
+
+    AcquireResult acquire(
+        pool::DbIntent intent,
+        std::chrono::milliseconds to = std::chrono::milliseconds::zero(),
+        std::source_location where = std::source_location::current()) override {
+        if (intent == pool::DbIntent::Write || readers_.empty()) return writer_->acquire(intent, to, where);
+        const std::size_t n = readers_.size();
+        const std::size_t first = next_.fetch_add(1, std::memory_order_relaxed) % n;
+        return readers_[first]->acquire(intent, to, where);
+    }
+
+    aio::Task<AcquireResult> co_acquire(
+        pool::DbIntent intent,
+        std::chrono::milliseconds to = std::chrono::milliseconds::zero(),
+        std::source_location where = std::source_location::current()) override {
+        if (intent == pool::DbIntent::Write || readers_.empty()) co_return co_await writer_->co_acquire(intent, to, where);
+        const std::size_t n = readers_.size();
+        const std::size_t first = next_.fetch_add(1, std::memory_order_relaxed) % n;
+        co_return co_await readers_[first]->co_acquire(intent, to, where);
+    }
+
+    std::vector<pool::LeaseInfo> leases() const override {
+        std::vector<pool::LeaseInfo> out = writer_->leases();
+        for (const auto& r : readers_) {
+            auto rl = r->leases();
+            out.insert(out.end(), rl.begin(), rl.end());
+        }
+        return out;
+    }
+
+    // totals over writer + readers
+    pool::PoolStats stats() const override {
+        pool::PoolStats s = writer_->stats();
+        for (const auto& r : readers_) add_(s, r->stats());
+        return s;
+    }
+
+    pool::PoolStats stats(pool::DbIntent intent) const {
+        if (intent == pool::DbIntent::Write || readers_.empty()) return writer_->stats();
+        pool::PoolStats s;
+        for (const auto& r : readers_) add_(s, r->stats());
+        return s;
+    }
+
+    pool::PoolLatency latency() const override {
+        pool::PoolLatency l = writer_->latency();
+        for (const auto& r : readers_) l.merge(r->latency());
+        return l;
+    }
+
+    void shutdown() override {
+        writer_->shutdown();
+        for (auto& r : readers_) r->shutdown();
+    }
+
+protected:
+    // never reached: leases belong to the sub-pools
+    void release(std::shared_ptr<SQLConnection>, pool::DbIntent) override { }
+
+private:
+    static void add_(pool::PoolStats& s, const pool::PoolStats& o) {
+        s.size += o.size;
+        s.in_use += o.in_use;
+        s.waiters += o.waiters;
+        s.acquired += o.acquired;
+        s.timeouts += o.timeouts;
+        s.shutdowns += o.shutdowns;
+    }
+
+    std::unique_ptr<pool::IDbPool> writer_;
+    std::vector<std::unique_ptr<pool::IDbPool>> readers_;
+    std::atomic<std::size_t> next_ { 0 };
 };
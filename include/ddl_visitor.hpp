@@ -2,6 +2,7 @@
 #include "orm.hpp"
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 class DDLVisitor {
 public:
@@ -9,6 +10,12 @@ public:
     virtual std::string visit(const OrmSchema& schema) = 0;
     virtual std::string sql_type(const OrmProp& f) = 0;
     virtual std::string sql_default(const OrmProp& f);
+    // visit() output, one statement per entry (for prepare())
+    static std::vector<std::string> split(const std::string& script);
+    // CREATE [UNIQUE] INDEX IF NOT EXISTS: re-running visit() on an existing table is a no-op;
+    // unnamed indexes get the name Postgres would give them (<table>_<fields>_idx)
+    static std::string index_ddl(const std::string& table, const std::string& name, bool unique,
+        const std::vector<std::string>& fields);
 };
 
 class PgDDLVisitor : public DDLVisitor {
@@ -1,5 +1,9 @@
 #pragma once
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <stdexcept>
 #include "orm.hpp"
@@ -16,19 +20,89 @@
  *     update:        selected non-PK fields, then PK last
  *     delete:        PK only (first param)
  * - No RETURNING is emitted.
+ *
+ * Batch variants (insert_batch / upsert_batch) emit one VALUES tuple per row:
+ *     INSERT INTO t (a, b) VALUES (?1, ?2), (?3, ?4), ...
+ * - Column set comes from the FIRST object; every row must have the same shape.
+ * - insert_batch: non-PK fields in JSON order, PK always LAST (generated by caller)
+ * - upsert_batch: fields in JSON order (PK included), ON CONFLICT(pk)
+ * - Returned int is the total number of bound parameters (rows * columns).
+ * - Callers size batches with batch_rows() to stay under max_params().
+ *
+ * sql() is the cached front of the generators above (see DmlSql): the write path of Storage uses it,
+ * so a steady stream of same-shaped requests builds no SQL text at all.
  */
+enum class DmlOp : uint8_t { Insert, Upsert, Update, Remove, InsertBatch, UpsertBatch };
+
+// Generated statement, interned by DMLVisitor::sql(): shared, never modified
+struct DmlSql {
+    std::string sql;
+    int params = 0;
+    std::string schema;            // schema name (invalidate())
+    std::vector<std::string> keys; // JSON key shape it was built for, in order
+};
+
 class DMLVisitor {
 public:
     virtual ~DMLVisitor() = default;
 
+    /**
+     * @brief Cached insert/upsert/update/remove/insert_batch/upsert_batch SQL
+     *
+     * Keyed by (schema name, schema version, JSON key shape in order, op, rows): the SQL follows the
+     * JSON key order, so the shape is the ordered key list (fingerprinted, then compared) rather than
+     * a set of columns. A (name, version) pair is taken to identify the schema's fields.
+     * Lookups share a lock; a miss generates outside it. Bounded: cleared when kMaxSql is reached.
+     *
+     * @param obj first object of the batch (ignored for Remove)
+     * @param rows VALUES tuples for the batch ops, 1 otherwise
+     */
+    std::shared_ptr<const DmlSql> sql(DmlOp op, OrmSchema& schema, const jval& obj, size_t rows = 1) const;
+
+    // drop every cached statement of @p schema (all versions)
+    void invalidate(const std::string& schema) const;
+    // drop the statements of one version only: it was retired (SchemaBoss::Lease)
+    void invalidate(const std::string& schema, int version) const;
+    void invalidate_all() const;
+    size_t cached_sql() const;
+
+    static constexpr size_t kMaxSql = 4096;
+
     virtual dml_pair insert (const OrmSchema& schema, const jval& value) const = 0;
     virtual dml_pair upsert (OrmSchema& schema, const jval& value) const = 0;
     virtual dml_pair update (OrmSchema& schema, const jval& value) const = 0;
     virtual dml_pair remove (OrmSchema& schema, const jval& value) const = 0;
 
+    virtual dml_pair insert_batch(const OrmSchema& schema, const jval& value, size_t rows) const;
+    virtual dml_pair upsert_batch(const OrmSchema& schema, const jval& value, size_t rows) const;
+
+    // Max bound parameters accepted by one statement
+    virtual size_t max_params() const = 0;
+
+    // Rows per batch for rows of @p cols params: @p wanted, capped by @p limit - the connection's
+    // parameter limit (SQLConnection::max_params()), max_params() when 0 - (at least 1)
+    size_t batch_rows(size_t cols, size_t wanted, size_t limit = 0) const;
+
 protected:
     // 1-based placeholder
     virtual std::string ph(size_t index1) const = 0;
+
+private:
+    struct SqlKey {
+        uint64_t schema; // hash of the name
+        int version;
+        uint64_t shape;  // BindPlan::fingerprint() of the keys
+        DmlOp op;
+        size_t rows;
+        bool operator==(const SqlKey&) const = default;
+    };
+    struct SqlKeyHash {
+        size_t operator()(const SqlKey& k) const;
+    };
+
+    mutable std::shared_mutex sql_mx_;
+    mutable std::unordered_map<SqlKey, std::vector<std::shared_ptr<const DmlSql>>, SqlKeyHash> sql_;
+    mutable size_t sql_count_ = 0;
 };
 
 class SqliteDMLVisitor final : public DMLVisitor {
@@ -37,6 +111,7 @@ public:
     dml_pair upsert (OrmSchema& schema, const jval& value) const override;
     dml_pair update (OrmSchema& schema, const jval& value) const override;
     dml_pair remove (OrmSchema& schema, const jval& value) const override;
+    size_t max_params() const override { return 999; } // SQLITE_MAX_VARIABLE_NUMBER default before 3.32; connections report theirs
 private:
     std::string ph(size_t index1) const override; // ?1
 };
@@ -47,6 +122,7 @@ public:
     dml_pair upsert (OrmSchema& schema, const jval& value) const override;
     dml_pair update (OrmSchema& schema, const jval& value) const override;
     dml_pair remove (OrmSchema& schema, const jval& value) const override;
+    size_t max_params() const override { return 65535; } // protocol limit: Int16 parameter count
 private:
     std::string ph(size_t index1) const override; // $1
 };
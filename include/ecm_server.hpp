@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "jsonhlp.hpp"
+#include "rapidjson/stringbuffer.h"
+#include "storage.hpp"
+
+/**
+ * RequestArena
+ *  - One per FastCGI worker, reused for every request it serves: nothing below is freed between
+ *    requests, so a steady-state request does no heap allocation for its body, parse or reply
+ *  - doc() allocates from a memory pool whose first chunk is the arena's own buffer; reset()
+ *    rewinds it (extra chunks from an unusually large request are released)
+ */
+class RequestArena {
+public:
+    explicit RequestArena(std::size_t chunk = 64 * 1024);
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    void reset(); // between requests
+
+    std::string& body() { return body_; }     // request body (capacity kept)
+    jdoc& doc() { return *doc_; }             // parse target, pool-allocated
+    json::StringBuffer& out() { return out_; } // reply body (capacity kept)
+
+    std::size_t pool_capacity() const { return alloc_.Capacity(); }
+
+private:
+    std::vector<char> chunk_;
+    jalloc alloc_;
+    std::optional<jdoc> doc_;
+    std::string body_;
+    json::StringBuffer out_;
+};
+
+/**
+ * EcmRouter
+ *  - /ecm/<schema>[/...][?query] -> Storage, by HTTP method:
+ *      POST -> Storage::insert (or Storage::insert_stream for streamed bodies), PUT -> Storage::update, DELETE -> Storage::del (JSON body: object or
+ *      array of objects), GET -> Storage::count (on a reader connection)
+ *  - Replies are JSON: {"rows": n} or {"error": "..."}; the status code is returned
+ *  - No FastCGI types: main.cpp feeds it from FCGX_Request, the tests call it directly
+ */
+class EcmRouter {
+public:
+    explicit EcmRouter(Storage& storage)
+        : storage_(storage) { }
+
+    // @p uri is REQUEST_URI; the request body is arena.body(); the reply goes to arena.out()
+    int handle(std::string_view method, std::string_view uri, RequestArena& arena);
+
+    // Large bodies: POST streams @p body into Storage::insert_stream() (bounded memory), the other
+    // methods read it into arena.body() and go through handle() above
+    int handle(std::string_view method, std::string_view uri, std::istream& body, RequestArena& arena);
+
+    // "<schema>" of "/ecm/<schema>..."; empty when the path does not match
+    static std::string_view schema_of(std::string_view uri);
+
+    static const char* reason(int status); // "OK", "Not Found", ...
+
+private:
+    int reply_(RequestArena& arena, int status, const char* key, const char* error, int64_t rows = 0);
+
+    Storage& storage_;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace pool {
+
+/**
+ * Log-linear (HDR-style) latency histogram buckets
+ *  - values are microseconds; 16 linear sub-buckets per power of two (~6% relative error)
+ *  - values >= 2^32 us (~71 min) land in the last bucket
+ */
+struct HistogramLayout {
+    static constexpr unsigned kSubBits = 4;
+    static constexpr unsigned kSub = 1u << kSubBits;
+    static constexpr unsigned kMaxBits = 32;
+    static constexpr std::size_t kBuckets = kSub + (kMaxBits - kSubBits) * kSub;
+
+    static constexpr std::size_t index(uint64_t v) {
+        if (v < kSub) return static_cast<std::size_t>(v);
+        const unsigned msb = 63u - static_cast<unsigned>(std::countl_zero(v)); // >= kSubBits
+        if (msb >= kMaxBits) return kBuckets - 1;
+        const unsigned shift = msb - kSubBits;
+        return kSub + shift * kSub + static_cast<std::size_t>((v >> shift) & (kSub - 1));
+    }
+
+    // smallest value of bucket i
+    static constexpr uint64_t lower(std::size_t i) {
+        if (i < kSub) return i;
+        const std::size_t shift = (i - kSub) / kSub;
+        const uint64_t mant = (i - kSub) % kSub;
+        return (kSub + mant) << shift;
+    }
+
+    // largest value of bucket i
+    static constexpr uint64_t upper(std::size_t i) {
+        return i + 1 < kBuckets ? lower(i + 1) - 1 : UINT64_MAX;
+    }
+};
+
+// Plain copy of a Histogram: cheap to pass around, merge and query
+struct HistogramSnapshot {
+    std::array<uint64_t, HistogramLayout::kBuckets> counts {};
+    uint64_t count { 0 };
+    uint64_t sum { 0 }; // us
+    uint64_t max { 0 }; // us
+
+    double mean() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+
+    // upper bound of the bucket holding the q-quantile (0..1), clamped to max; 0 when empty
+    uint64_t percentile(double q) const {
+        if (!count) return 0;
+        if (q <= 0) q = 0;
+        if (q >= 1) return max;
+        const uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count)) + 1;
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                const uint64_t hi = HistogramLayout::upper(i);
+                return hi < max ? hi : max;
+            }
+        }
+        return max;
+    }
+
+    void merge(const HistogramSnapshot& o) {
+        for (std::size_t i = 0; i < counts.size(); ++i) counts[i] += o.counts[i];
+        count += o.count;
+        sum += o.sum;
+        if (o.max > max) max = o.max;
+    }
+};
+
+/**
+ * Histogram
+ *  - record() is wait-free: relaxed fetch_add on one bucket + count/sum, CAS only to raise max
+ *  - snapshot() reads the atomics one by one: not a point-in-time cut, good enough for metrics
+ */
+class Histogram {
+public:
+    void record(uint64_t us) {
+        buckets_[HistogramLayout::index(us)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(us, std::memory_order_relaxed);
+        uint64_t m = max_.load(std::memory_order_relaxed);
+        while (us > m && !max_.compare_exchange_weak(m, us, std::memory_order_relaxed)) { }
+    }
+
+    template <class Rep, class Period>
+    void record(std::chrono::duration<Rep, Period> d) {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        record(static_cast<uint64_t>(us > 0 ? us : 0));
+    }
+
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot s;
+        for (std::size_t i = 0; i < buckets_.size(); ++i) s.counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        s.count = count_.load(std::memory_order_relaxed);
+        s.sum = sum_.load(std::memory_order_relaxed);
+        s.max = max_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, HistogramLayout::kBuckets> buckets_ {};
+    std::atomic<uint64_t> count_ { 0 };
+    std::atomic<uint64_t> sum_ { 0 };
+    std::atomic<uint64_t> max_ { 0 };
+};
+
+} // namespace pool
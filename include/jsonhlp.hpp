@@ -69,12 +69,12 @@ namespace jhlp {
 
     inline const jval& first_obj(const jval& value) {
         if (value.IsArray()) {
-            if (value.Empty()) THROW("JSON array is empty");
-            const jval& val = value.MemberBegin()->value;
-            if (!val.IsObject()) THROW("First array element is not an object");
+            if (value.Empty()) THROW_INVALID("JSON array is empty");
+            const jval& val = value[0];
+            if (!val.IsObject()) THROW_INVALID("First array element is not an object");
             return val;
         }
-        if (!value.IsObject()) THROW("JSON must be an object or array of objects");
+        if (!value.IsObject()) THROW_INVALID("JSON must be an object or array of objects");
         return value;
     }
 
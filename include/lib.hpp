@@ -11,5 +11,8 @@ using dml_pair = std::pair<std::string, int>;
 using er = std::runtime_error;
 
 void error(const std::string& msg, const char* file, int line, ...);
+void invalid(const std::string& msg, const char* file, int line, ...);
 // A helper macro to automatically pass __FILE__ and __LINE__
 #define THROW(msg, ...) error(msg, __FILE__, __LINE__, ##__VA_ARGS__)
+// Rejected input (std::invalid_argument): EcmRouter answers 400 instead of 500
+#define THROW_INVALID(msg, ...) invalid(msg, __FILE__, __LINE__, ##__VA_ARGS__)
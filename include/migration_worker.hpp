@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "schemaboss.hpp"
+#include "schemaupdate.hpp"
+#include "sqlconnection.hpp"
+
+/**
+ * MigrationWorker
+ *  - Background thread applying new schema versions, so no request waits for the DDL
+ *  - Registers with SchemaBoss::set_on_pending(): add() hands it the name, and from then on get()
+ *    keeps leasing the last applied version instead of migrating in-line
+ *  - Each step (from -> to) is the SchemaUpdate plan (CREATE TABLE for the first version) run in one
+ *    transaction on its own write connection; SchemaBoss publishes the new version after the commit
+ *  - With @p online, steps that change a column type run SchemaUpdate::plan_online() instead: chunked
+ *    backfill in many short transactions, so the table stays writable; the version is published after the swap
+ *  - SQLite has no ALTER COLUMN: a step changing a column's type, default or nullability always runs the
+ *    plan_online() rebuild (unthrottled without @p online)
+ *  - A failed step rolls back, is reported (stderr, last_error()) and retried every retry_interval;
+ *    requests stay on the old version
+ *  - Stops (and joins) on destruction
+ */
+class MigrationWorker {
+public:
+    MigrationWorker(SchemaBoss& boss, PSQLConnection conn, Dialect dialect,
+        std::chrono::milliseconds retry_interval = std::chrono::milliseconds(1000),
+        std::optional<OnlineMigration> online = std::nullopt);
+    ~MigrationWorker();
+
+    MigrationWorker(const MigrationWorker&) = delete;
+    MigrationWorker& operator=(const MigrationWorker&) = delete;
+
+    void enqueue(const std::string& name); // no-op once stopped
+    void stop();
+
+    // true when the queue is empty and no step runs (failed names may still wait for a retry)
+    bool wait_idle(std::chrono::milliseconds timeout);
+
+    // DDL for one step, one statement per entry; @p from == nullptr creates the table.
+    // Not used for steps SchemaUpdate::rebuilds() (SQLite column changes)
+    static std::vector<std::string> plan(const OrmSchema* from, const OrmSchema& to, Dialect dialect);
+
+    uint64_t applied() const { return applied_.load(std::memory_order_relaxed); } // committed steps
+    uint64_t failed() const { return failed_.load(std::memory_order_relaxed); }   // rolled back steps
+    std::string last_error() const;                                                 // of the last failed step, also on stderr
+
+private:
+    bool step_(const OrmSchema* from, const OrmSchema& to);
+    void run_();
+
+    SchemaBoss& boss_;
+    PSQLConnection conn_;
+    Dialect dialect_;
+    std::chrono::milliseconds retry_interval_;
+    std::optional<OnlineMigration> online_;
+    std::mutex mx_;
+    std::condition_variable cv_;      // work or stop
+    std::condition_variable idle_cv_; // wait_idle()
+    std::deque<std::string> queue_;
+    std::set<std::string> retry_;     // failed, queued again after retry_interval
+    bool busy_ = false;
+    bool stop_ = false;
+    std::atomic<uint64_t> applied_ { 0 };
+    std::atomic<uint64_t> failed_ { 0 };
+    mutable std::mutex err_mx_; // last_error_
+    std::string last_error_;
+    std::thread thread_;
+};
@@ -1,5 +1,9 @@
 #pragma once
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <optional>
 #include <functional> // Required for std::reference_wrapper
@@ -62,13 +66,72 @@ struct OrmIndex {
 
 class DDLVisitor; // forward declaration
 
+/**
+ * BindPlan - how the rows of one JSON key shape bind to a schema
+ *  - built once per (schema, key shape) by OrmSchema::bind_plan(); rows of the same shape (same keys,
+ *    same order) then bind with a linear walk over cols: no key lookups, no allocations
+ *  - cols are the schema fields present in the shape, in JSON order, PK included (see pk_col)
+ *  - member indexes are positions in the object: value() is MemberBegin() + index
+ */
+struct BindPlan {
+    struct Col {
+        uint32_t member;     // position of the key in the JSON object
+        const OrmProp* prop; // schema field (owned by the OrmSchema)
+    };
+    uint64_t shape = 0;            // BindPlan::fingerprint() of the keys
+    std::vector<std::string> keys; // every JSON key, in order (schema fields or not)
+    std::vector<Col> cols;
+    int pk_col = -1;               // index in cols of the PK, -1 when the shape has no PK
+    const OrmProp* pk = nullptr;   // the schema PK, present in the shape or not
+
+    // true when @p obj has exactly these keys in this order
+    bool matches(const jval& obj) const;
+
+    static const jval& value(const jval& obj, const Col& c) { return (obj.MemberBegin() + c.member)->value; }
+
+    // PK present, non-null and non-zero/empty by type (an INSERT row becomes an UPSERT)
+    bool pk_valid(const jval& obj) const;
+
+    // params bound per row: cols without the PK, plus one when a generated PK is appended
+    size_t params(bool with_pk) const { return cols.size() - (pk_col >= 0 ? 1 : 0) + (with_pk ? 1 : 0); }
+
+    // hash of the key names of @p obj, in order (no allocation)
+    static uint64_t fingerprint(const jval& obj);
+};
+
+/**
+ * Per-schema cache of BindPlans, keyed by key-shape fingerprint
+ *  - thread safe: shared lock for hits, exclusive to add (bounded: cleared when full)
+ *  - a copy starts empty - plans point into the fields of the OrmSchema they were built for
+ */
+class BindPlanCache {
+public:
+    BindPlanCache() = default;
+    BindPlanCache(const BindPlanCache&) { }
+    BindPlanCache& operator=(const BindPlanCache&) {
+        clear();
+        return *this;
+    }
+
+    std::shared_ptr<const BindPlan> get(const OrmSchema& schema, const jval& obj);
+    void clear();
+    size_t size() const;
+
+    static constexpr size_t kMaxPlans = 64;
+
+private:
+    mutable std::shared_mutex mx_;
+    std::unordered_map<uint64_t, std::vector<std::shared_ptr<const BindPlan>>> plans_; // fingerprint -> plans
+    size_t count_ = 0;
+};
+
 class OrmSchema {
 public:
     int64_t id = 0; // must load the id if exists
     std::string name;
-    OrmSchema* parent; // pointer to parent
-    int version;
-    bool applied;
+    OrmSchema* parent = nullptr; // pointer to parent
+    int version = 0;
+    bool applied = false;
     std::string json;
     //unordered_map so the fields keep the order they appear in JSONSchema string
     //so the DDLVisitor will create the tables fields in this same order
@@ -78,7 +141,15 @@ public:
 
     // void accept(class DDLVisitor& visitor) const;
     const std::shared_ptr<OrmProp> idprop() const ;
+    const OrmProp* pkprop() const; // same field as idprop(), no copy; nullptr when there is none
     static bool from_json(jdoc& doc, OrmSchema& schema);
+
+    // cached BindPlan for the key shape of @p obj; fields must not change once plans are built
+    std::shared_ptr<const BindPlan> bind_plan(const jval& obj) const { return plans_.get(*this, obj); }
+    size_t bind_plans() const { return plans_.size(); }
+
+private:
+    mutable BindPlanCache plans_;
 };
 
 PropType proptype(std::string type);
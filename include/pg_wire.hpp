@@ -0,0 +1,202 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "orm.hpp"
+#include "sqlconnection.hpp"
+
+/**
+ * Postgres wire encodings shared by the libpq backend (binary parameters, COPY)
+ *  - no PGconn: testable without a server
+ */
+
+// ISO-8601 -> Postgres binary date/time: days (date) or microseconds (time, timestamp[tz])
+// since 2000-01-01. Accepts YYYY-MM-DD, HH:MM[:SS[.ffffff]] and YYYY-MM-DD[T ]HH:MM[:SS[.ffffff]]
+// with a Z/+HH[:MM] offset required for timestamptz and rejected for timestamp.
+// Returns false for anything else - the caller falls back to text format.
+namespace pgtime {
+    inline bool digits(const char*& p, const char* end, int n, int& out) {
+        if (end - p < n) return false;
+        out = 0;
+        for (int i = 0; i < n; ++i, ++p) {
+            if (*p < '0' || *p > '9') return false;
+            out = out * 10 + (*p - '0');
+        }
+        return true;
+    }
+
+    // days since 1970-01-01 (proleptic Gregorian)
+    inline int64_t days_from_civil(int y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    constexpr int64_t kPgEpochDays = 10957; // 2000-01-01 - 1970-01-01
+    constexpr int64_t kUsecPerDay = 86400000000LL;
+
+    inline bool date(const char*& p, const char* end, int64_t& days) {
+        int y, m, d;
+        if (!digits(p, end, 4, y) || p == end || *p++ != '-') return false;
+        if (!digits(p, end, 2, m) || p == end || *p++ != '-') return false;
+        if (!digits(p, end, 2, d)) return false;
+        if (m < 1 || m > 12 || d < 1 || d > 31) return false;
+        days = days_from_civil(y, m, d) - kPgEpochDays;
+        return true;
+    }
+
+    inline bool time(const char*& p, const char* end, int64_t& usec) {
+        int h, mi, sec = 0, frac = 0;
+        if (!digits(p, end, 2, h) || p == end || *p++ != ':') return false;
+        if (!digits(p, end, 2, mi)) return false;
+        if (p != end && *p == ':') {
+            ++p;
+            if (!digits(p, end, 2, sec)) return false;
+            if (p != end && *p == '.') {
+                ++p;
+                int n = 0;
+                for (; p != end && *p >= '0' && *p <= '9'; ++p, ++n) {
+                    if (n < 6) frac = frac * 10 + (*p - '0');
+                }
+                if (n == 0) return false;
+                for (; n < 6; ++n) frac *= 10;
+            }
+        }
+        if (h > 24 || mi > 59 || sec > 60) return false;
+        usec = ((h * 60LL + mi) * 60 + sec) * 1000000LL + frac;
+        return true;
+    }
+
+    // Z | +HH | +HH:MM | +HHMM -> seconds east of UTC
+    inline bool offset(const char*& p, const char* end, int64_t& sec) {
+        if (p == end) return false;
+        if (*p == 'Z' || *p == 'z') { ++p; sec = 0; return true; }
+        if (*p != '+' && *p != '-') return false;
+        const int sign = *p++ == '-' ? -1 : 1;
+        int h, m = 0;
+        if (!digits(p, end, 2, h)) return false;
+        if (p != end && *p == ':') ++p;
+        if (p != end && !digits(p, end, 2, m)) return false;
+        sec = sign * (h * 3600LL + m * 60LL);
+        return true;
+    }
+
+    inline bool parse(const char* s, size_t n, PropType type, int64_t& out) {
+        const char* p = s;
+        const char* end = s + n;
+        int64_t days = 0, usec = 0, off = 0;
+        switch (type) {
+            case PropType::Date:
+                if (!date(p, end, days)) return false;
+                out = days;
+                break;
+            case PropType::Time:
+                if (!time(p, end, usec)) return false;
+                out = usec;
+                break;
+            case PropType::Dt_Time:
+            case PropType::Tm_Stamp:
+                if (!date(p, end, days) || p == end || (*p != 'T' && *p != ' ')) return false;
+                ++p;
+                if (!time(p, end, usec)) return false;
+                if (type == PropType::Tm_Stamp && !offset(p, end, off)) return false;
+                out = days * kUsecPerDay + usec - off * 1000000LL;
+                break;
+            default:
+                return false;
+        }
+        return p == end;
+    }
+}
+
+// binary parameter / COPY field encodings: network byte order, fixed width
+namespace pgwire {
+    inline void put_be(char* out, uint64_t v, int width) {
+        for (int i = 0; i < width; ++i) out[i] = static_cast<char>((v >> (8 * (width - 1 - i))) & 0xFF);
+    }
+    inline void int4(char* out, int32_t v) { put_be(out, static_cast<uint32_t>(v), 4); }
+    inline void int8(char* out, int64_t v) { put_be(out, static_cast<uint64_t>(v), 8); }
+    inline void float8(char* out, double v) {
+        uint64_t u;
+        std::memcpy(&u, &v, sizeof u);
+        put_be(out, u, 8);
+    }
+    inline void boolean(char* out, bool v) { out[0] = v ? 1 : 0; }
+
+    // highest $n placeholder in @p sql (= parameters of the prepared statement); quoted strings,
+    // quoted identifiers, dollar-quoted bodies and comments are skipped
+    inline int param_count(std::string_view sql) {
+        auto ident = [](char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$';
+        };
+        int n = 0;
+        const size_t len = sql.size();
+        for (size_t i = 0; i < len; ++i) {
+            const char c = sql[i];
+            if (c == '\'' || c == '"') {
+                while (++i < len && sql[i] != c) { }
+            } else if (c == '-' && i + 1 < len && sql[i+1] == '-') {
+                while (i < len && sql[i] != '\n') ++i;
+            } else if (c == '/' && i + 1 < len && sql[i+1] == '*') {
+                const size_t e = sql.find("*/", i + 2);
+                i = e == std::string_view::npos ? len : e + 1;
+            } else if (c == '$' && (i == 0 || !ident(sql[i-1]))) {
+                size_t j = i + 1;
+                if (j < len && sql[j] >= '0' && sql[j] <= '9') {
+                    int v = 0;
+                    for (; j < len && sql[j] >= '0' && sql[j] <= '9'; ++j) v = v * 10 + (sql[j] - '0');
+                    if (v > n) n = v;
+                    i = j - 1;
+                    continue;
+                }
+                while (j < len && ident(sql[j]) && sql[j] != '$') ++j;
+                if (j >= len || sql[j] != '$') continue;         // not a dollar quote
+                const std::string_view tag = sql.substr(i, j - i + 1); // $tag$ or $$
+                const size_t e = sql.find(tag, j + 1);
+                i = e == std::string_view::npos ? len : e + tag.size() - 1;
+            }
+        }
+        return n;
+    }
+}
+
+/**
+ * PgCopyEncoder
+ *  - COPY ... FROM STDIN data for one load, text or binary format, encoded straight from the JSON values
+ *  - PgBulkLoad sends buffer() with PQputCopyData and clears it
+ *  - integers take the width of their column's SQL type (CopyColumn::sql_type)
+ *  - bytea (PropType::Bin) is the same in both formats: a "\\x..." hex literal, anything else raw bytes
+ */
+class PgCopyEncoder {
+public:
+    PgCopyEncoder(const std::vector<CopyColumn>& columns, CopyFormat format); // binary: writes the file header
+
+    void put(const jval& value, const PropType& type);
+    void put_null();
+    void end_row();
+    void finish(); // binary: file trailer
+
+    std::string& buffer() { return buf_; }
+    int64_t rows() const { return rows_; }
+
+private:
+    void next_field_();
+    void put_escaped_(const char* s, size_t n);
+    void put_text_(const jval& value, const PropType& type);
+    void put_binary_(const jval& value, const PropType& type);
+    void put_i16_(int16_t v);
+    void put_i32_(int32_t v);
+
+    CopyFormat format_;
+    int ncols_;
+    std::vector<int> widths_; // per column integer width in bytes; 0 = not an integer type
+    int col_ = 0;
+    int64_t rows_ = 0;
+    std::string buf_;
+};
@@ -1,7 +1,11 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <unordered_map>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <functional>
@@ -15,52 +19,143 @@
  *  - Tracks newestVersion and lastApplied
  *  - Applies forward migrations on demand (CRUD entry) via callback
  *
+ * Threading:
+ *  - read path: get() for a schema with nothing to migrate loads the name map snapshot (RCU, like
+ *    Storage::catalog()) and the schema's current version pointer - atomics only, no lock
+ *  - migration path: add(), the migrating part of get(), migrate() and the read helpers run under
+ *    the schema's own mutex, so a migration of one schema never stalls requests for another
+ *  - with an on_pending callback (MigrationWorker) get() never migrates a schema that has an applied
+ *    version: it keeps leasing that one until the background migration publishes the next
+ *
  * Notes:
  *  - applied == "DDL for this version was already applied to DB"
  *  - inactive == "not the most-recent applied version currently served to NEW users"
- *  - Old applied versions remain available for existing users until released externally.
+ *  - Old applied versions remain available for existing users until their last Lease ends, then retire:
+ *    retire listeners run once and the entry is purged on the next migration. Leases must not outlive
+ *    the SchemaBoss.
  */
 class SchemaBoss {
 public:
     struct Version {
-        std::shared_ptr<OrmSchema> schema; // stored schema (immutable content)
-        bool applied  = false;         // DDL applied to DB at some point
-        bool inactive = false;         // not the latest applied (new users should not receive)
-        int  in_use   = 0;             // reserved for future leasing (old users finish jobs)
+        std::shared_ptr<OrmSchema> schema;   // stored schema (immutable content)
+        std::atomic<bool> applied  { false }; // DDL applied to DB at some point
+        std::atomic<bool> inactive { false }; // not the latest applied (new users should not receive)
+        std::atomic<int>  in_use   { 0 };     // live Leases (old users finish jobs)
+        std::atomic<bool> retired  { false }; // inactive and unleased: resources released, entry purged
+    };
+
+    /**
+     * Lease - RAII hold on one applied version, handed out by get()
+     *  - while any Lease of a version lives, the version and everything derived from it (cached SQL,
+     *    bind plans, ...) stays: long bulk loads keep their compiled plans across an upgrade
+     *  - new get() calls move to the new version at once; the old one retires when its last Lease ends
+     *    (retire listeners run then, on the releasing thread)
+     *  - move-only; reads like a pointer to the OrmSchema
+     */
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& o) noexcept
+            : boss_(o.boss_)
+            , v_(std::move(o.v_)) { }
+        Lease& operator=(Lease&& o) noexcept {
+            if (this != &o) {
+                release();
+                boss_ = o.boss_;
+                v_ = std::move(o.v_);
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { release(); }
+
+        const std::shared_ptr<OrmSchema>& schema() const { return v_->schema; }
+        OrmSchema* operator->() const { return v_->schema.get(); }
+        OrmSchema& operator*() const { return *v_->schema; }
+        explicit operator bool() const { return v_ != nullptr; }
+        bool operator==(std::nullptr_t) const { return v_ == nullptr; }
+
+        void release(); // early end; no-op when empty
+
+    private:
+        friend class SchemaBoss;
+        Lease(SchemaBoss* boss, std::shared_ptr<Version> v)
+            : boss_(boss)
+            , v_(std::move(v)) { }
+
+        SchemaBoss* boss_ = nullptr;
+        std::shared_ptr<Version> v_;
     };
 
     struct SchemaItem {
-        std::map<int, Version> versions; // key: schema.version (ascending)
-        int newestVersion = -1;          // highest key present
-        int lastApplied   = -1;          // highest version with applied==true, -1 if none
-        std::string name = "";           // filled on load
-        std::shared_ptr<Version> current; // current version in use
+        std::mutex mx;                                    // migration path: everything below but the atomics
+        std::map<int, std::shared_ptr<Version>> versions; // key: schema.version (ascending)
+        int newestVersion = -1;                           // highest key present
+        int lastApplied   = -1;                           // highest version with applied==true, -1 if none
+        std::string name = "";                            // filled on load
+        std::atomic<std::shared_ptr<Version>> current;    // last applied version, served to new users
+        std::atomic<bool> behind { false };               // versions newer than current wait for migration
     };
 
     using MigrateFn       = std::function<bool(const OrmSchema* from, const OrmSchema& to)>;
     using PersistOnAddFn  = std::function<void(const OrmSchema& added)>;            // insert into schema_catalog / schema_versions
     using PersistOnApplyFn= std::function<void(const OrmSchema& applied, int oldV)>; // update schema_versions flags
+    using RetireFn        = std::function<void(const OrmSchema& retired)>;          // last Lease of a replaced version ended
+    using PendingFn       = std::function<void(const std::string& name)>;            // a version waits for migration
 
-    // Optional side-effects (DB integration)
+    SchemaBoss();
+
+    // Optional side-effects (DB integration); set before concurrent use
     void set_persist_on_add(PersistOnAddFn fn)   { persist_on_add_   = std::move(fn); }
     void set_persist_on_apply(PersistOnApplyFn f){ persist_on_apply_ = std::move(f); }
+    // Called after persist_on_apply, in registration order
+    void add_apply_listener(PersistOnApplyFn fn) { apply_listeners_.push_back(std::move(fn)); }
+    // Called once per replaced version, when it is no longer leased (e.g. Storage::schema_retired)
+    void add_retire_listener(RetireFn fn) { retire_listeners_.push_back(std::move(fn)); }
+    // Background migration (MigrationWorker); may be set or cleared while requests run
+    void set_on_pending(PendingFn fn);
 
     // Insert a NEW version for a schema name. Never replaces; throws if duplicate.
     // Enforces strictly increasing version numbers.
     bool add(const OrmSchema& s);
 
-    // Ensure latest-applied for 'name' (migrate as needed) and return it.
+    // Ensure latest-applied for 'name' (migrate as needed) and lease it.
     // If nothing applied yet, applies the NEWEST directly (per spec).
-    // Returns nullptr if name unknown.
-    std::shared_ptr<OrmSchema> get(const std::string& name, const MigrateFn& migrate);
+    // Returns an empty Lease if name unknown (or a migration failed).
+    Lease get(const std::string& name, const MigrateFn& migrate);
+
+    // Migrate 'name' up to its newest version now (background worker).
+    // Returns true when nothing is left to apply; on failure the applied part stays published.
+    bool migrate(const std::string& name, const MigrateFn& migrate);
 
     // Read helpers
-    bool has(const std::string& name) const { return catalog_.find(name) != catalog_.end(); }
+    bool has(const std::string& name) const { return item_(name) != nullptr; }
     std::vector<int> unapplied_versions(const std::string& name) const;
     std::shared_ptr<Version> get_newest(const std::string& name, bool onlyApplied=false);
+    size_t retiring() const;                // replaced versions still leased
+    std::vector<std::string> pending() const; // names with versions waiting for migration
 
 private:
-    std::unordered_map<std::string, SchemaItem> catalog_;
+    using ItemMap = std::unordered_map<std::string, std::shared_ptr<SchemaItem>>;
+
+    std::shared_ptr<SchemaItem> item_(const std::string& name) const; // nullptr when unknown
+    std::shared_ptr<Version> migrate_(SchemaItem& its, const MigrateFn& migrate);
+    void applied_(const OrmSchema& applied, int oldV);
+    void release_(const std::shared_ptr<Version>& v);
+    void retire_(const std::shared_ptr<Version>& v);
+
+    std::atomic<std::shared_ptr<const ItemMap>> catalog_; // RCU snapshot: copied when a NEW name is added
+    std::mutex catalog_mx_;                               // new names: one writer at a time
     PersistOnAddFn    persist_on_add_;
     PersistOnApplyFn  persist_on_apply_;
+    std::vector<PersistOnApplyFn> apply_listeners_;
+    std::vector<RetireFn> retire_listeners_;
+
+    std::mutex pending_mx_;                // on_pending_ vs add(); leaf lock
+    PendingFn on_pending_;
+    std::atomic<bool> deferred_ { false }; // on_pending_ is set: get() leaves migrations to it
+
+    mutable std::mutex retire_mx_;                   // leaf lock
+    std::vector<std::shared_ptr<Version>> retiring_; // inactive, waiting for their last Lease
 };
@@ -1,8 +1,28 @@
 #pragma once
 #include "orm.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 
+class SQLConnection;
+
+// Online type changes: shadow column / new table filled in keyset-paginated chunks
+struct OnlineMigration {
+    size_t chunk_rows = 1000;                     // rows copied per chunk (one transaction each)
+    std::chrono::milliseconds throttle { 10 };    // pause between chunks, leaves the lock to requests
+};
+
+// One unit of an online plan
+struct MigrationStep {
+    enum class Kind { Ddl, Backfill, Concurrent };
+    Kind kind = Kind::Ddl;
+    std::vector<std::string> sql; // Ddl: run together in one transaction; Backfill: one chunk;
+                                  // Concurrent: one by one, outside any transaction
+    size_t counted = 0;           // Backfill: statement whose rows affected ends the loop at 0
+};
+
 class SchemaUpdate {
 public:
     SchemaUpdate(const OrmSchema& old_schema, const OrmSchema& new_schema);
@@ -10,7 +30,32 @@ public:
     // Generates DDL migration scripts, returns as a list of SQL statements (strings)
     std::vector<std::string> plan_migration(const std::string& db_engine);
 
+    /**
+     * @brief Plan that keeps the table writable while column types change
+     *
+     * Without a type change (sqlite: without rebuilds()) this is plan_migration() as a single Ddl step. Otherwise:
+     *  - postgres: add a shadow column per changed column, kept in sync by a trigger; backfill it in
+     *    chunks; build its indexes CONCURRENTLY and validate a NOT VALID CHECK for NOT NULL; then swap
+     *    (drop old, rename shadow) and attach the prepared indexes and NOT NULL
+     *  - sqlite (no ALTER COLUMN, also for default / nullability changes): rebuild - create <table>__new, mirror writes into it by triggers,
+     *    backfill in chunks, then drop the old table and rename the new one, indexes last
+     * Chunks walk the primary key (keyset) from a cursor table, so an interrupted backfill resumes.
+     * The swap takes the exclusive lock; for the changed columns it only changes metadata (SET NOT NULL
+     * relies on the validated CHECK, PG12+). Other changes of the version run in it as plan_migration() has them.
+     */
+    std::vector<MigrationStep> plan_online(const std::string& db_engine, const OnlineMigration& opts = {});
+
+    // true when @p db_engine cannot apply the diff in place: sqlite has no ALTER COLUMN, so a type,
+    // default or nullability change of a kept column needs the plan_online() rebuild
+    bool rebuilds(const std::string& db_engine) const;
+
+    // Run @p steps on @p conn: each Ddl step and each chunk in its own transaction, chunks
+    // throttled. Returns the rows backfilled; throws on the first failure (after a rollback)
+    static int64_t run(SQLConnection& conn, const std::vector<MigrationStep>& steps, const OnlineMigration& opts = {});
+
 private:
+    std::vector<std::string> plan_(const std::string& db_engine, bool online); // online: skip type-changed columns
+
     const OrmSchema& old_schema_;
     const OrmSchema& new_schema_;
 };
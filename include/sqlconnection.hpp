@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <random>
+#include "aio.hpp"
 #include "orm.hpp"
 
 class Random {
@@ -25,8 +26,18 @@ public:
 class SQLStatement {
 public:
     virtual ~SQLStatement() = default;
+    // @p value may be referenced without a copy: keep it alive until exec() returns
     virtual void bind(int idx, const jval& value, const PropType& type) = 0;
     virtual int exec() = 0;  // return rows affected
+    // Awaitable exec(): backends with non-blocking I/O suspend on aio::EventLoop::current() while
+    // the server works; the default (and any call outside a loop) runs exec()
+    virtual aio::Task<int> co_exec() { co_return exec(); }
+    // Run a query and return the first column of its first row as an integer (SELECT count(*) ...);
+    // throws when there is no row
+    virtual int64_t query_int() {
+        THROW("query_int: not supported by this backend");
+        return 0;
+    }
     // virtual int exec_ret() = 0; // with data rosAffcted + row_field[0,0] returning ID
 protected:
     std::string name_;
@@ -47,6 +58,27 @@ protected:
 
 };
 
+// COPY wire format for bulk loads
+enum class CopyFormat { Text, Binary };
+
+// One bulk load column; sql_type is the DDL visitor's type for it and fixes the binary
+// wire width of integers (INTEGER: int4, BIGINT: int8)
+struct CopyColumn {
+    std::string name;
+    std::string sql_type;
+};
+
+// Streaming bulk load into one table (Postgres: COPY ... FROM STDIN).
+// Per row: put() every column in the declared column order, then end_row().
+class SQLBulkLoad {
+public:
+    virtual ~SQLBulkLoad() = default; // unfinished loads are aborted
+    virtual void put(const jval& value, const PropType& type) = 0;
+    virtual void put_null() = 0;
+    virtual void end_row() = 0;
+    virtual int64_t finish() = 0; // flush, end the load; returns rows loaded
+};
+
 class SQLConnection {
 public:
     virtual ~SQLConnection() = default;
@@ -57,12 +89,50 @@ public:
     // Safe to call multiple times.
     virtual void disconnect()  = 0;
 
+    // Backends keep compiled statements per connection keyed by SQL text (see StmtCache).
     virtual std::unique_ptr<SQLStatement> prepare(const std::string& sql, int numParams=-1) = 0;
 
+    // Max prepared statements cached by this connection (LRU); backends without a cache ignore it.
+    virtual void stmt_cache_size(std::size_t /*n*/) { }
+
+    // Max bound parameters of one statement on this connection; 0 = unknown (DMLVisitor::max_params())
+    virtual std::size_t max_params() { return 0; }
+
+    // Bulk load into @p table, @p columns in put() order.
+    // Returns nullptr when the backend has no bulk path (callers fall back to batched INSERT).
+    virtual std::unique_ptr<SQLBulkLoad> bulk_load(const std::string& /*table*/,
+        const std::vector<CopyColumn>& /*columns*/, CopyFormat /*format*/ = CopyFormat::Text) {
+        return nullptr;
+    }
+
+    // Pipelined execution: after pipeline_begin() returns true, SQLStatement::exec() only queues
+    // the statement and returns 0. pipeline_end() (or commit()) is the sync point: it collects every
+    // queued result, returns the rows affected by all statements queued since pipeline_begin() (also
+    // those a backend collected early to bound its unread results) and throws the first error. Backends without
+    // pipelining return false and keep executing synchronously. Nested begin/end pairs only count:
+    // the outermost pipeline_end() (or commit()) syncs.
+    virtual bool pipeline_begin() { return false; }
+    virtual int pipeline_end() { return 0; }
+
+    // Abort the statement running on this connection; callable from another thread (lease watchdog)
+    virtual void cancel() { }
+
+    // Health for the pool: healthy() is a cheap local check, ping() a server round trip
+    virtual bool healthy() { return true; }
+    virtual bool ping() { return healthy(); }
+
     virtual bool begin() = 0;
     virtual bool commit() = 0;
     virtual void rollback() = 0;
 
+    // Awaitable commit(): also collects an open pipeline and returns the rows affected by the
+    // statements still queued in it; throws the first error (the caller rolls back).
+    virtual aio::Task<int> co_commit() {
+        const int rows = pipeline_end();
+        if (!commit()) THROW("commit() failed");
+        co_return rows;
+    }
+
     virtual int64_t nextValue(std::string name) = 0;
 
     std::string stmtName(){
@@ -72,7 +142,7 @@ public:
     }
 
 protected:
-    bool tr_started_;
+    bool tr_started_ = false;
     Random random_;
     int low_ = 5678;
 };
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "sqlconnection.hpp"
+
+struct sqlite3;
+
+/**
+ * SqliteProfile
+ *  - PRAGMAs applied by SQLiteConnection::connect(), right after sqlite3_open_v2()
+ *  - Empty strings / negative numbers keep the SQLite default for that setting
+ *  - Read-only connections skip the settings that write to the file (journal_mode, wal_autocheckpoint)
+ */
+struct SqliteProfile {
+    std::string journal_mode;         // "WAL", "DELETE", ...
+    std::string synchronous;          // "OFF", "NORMAL", "FULL"
+    int64_t mmap_size = -1;           // bytes
+    int64_t cache_size = 0;           // 0 = default; > 0 pages, < 0 KiB
+    std::string temp_store;           // "DEFAULT", "FILE", "MEMORY"
+    int busy_timeout_ms = -1;         // sqlite3_busy_timeout
+    int wal_autocheckpoint = -1;      // pages; 0 disables automatic checkpoints
+
+    // > 0: Storage runs a SqliteCheckpointer with this period (WAL only)
+    std::chrono::milliseconds checkpoint_interval { 0 };
+
+    // plain sqlite3_open() behaviour: rollback journal, no busy timeout
+    static SqliteProfile defaults() { return {}; }
+
+    // WAL + synchronous=NORMAL, 256 MiB mmap, 64 MiB page cache, in-memory temp tables,
+    // 5 s busy timeout; checkpoints run in the background every second and the
+    // in-line autocheckpoint only kicks in as a backstop (~40 MiB of WAL).
+    static SqliteProfile wal_tuned() {
+        SqliteProfile p;
+        p.journal_mode = "WAL";
+        p.synchronous = "NORMAL";
+        p.mmap_size = 256LL * 1024 * 1024;
+        p.cache_size = -64 * 1024;
+        p.temp_store = "MEMORY";
+        p.busy_timeout_ms = 5000;
+        p.wal_autocheckpoint = 10000;
+        p.checkpoint_interval = std::chrono::milliseconds(1000);
+        return p;
+    }
+};
+
+PSQLConnection make_sqlite_connection(const SqliteProfile& profile, bool readonly = false);
+
+/**
+ * SqliteCheckpointer
+ *  - Background thread running PASSIVE WAL checkpoints every interval on its own connection,
+ *    so checkpoint I/O stays out of request latency
+ *  - PASSIVE never waits for readers or writers; frames still in use are picked up next time
+ *  - Stops (and joins) on destruction
+ */
+class SqliteCheckpointer {
+public:
+    SqliteCheckpointer(std::string path, std::chrono::milliseconds interval);
+    ~SqliteCheckpointer();
+
+    SqliteCheckpointer(const SqliteCheckpointer&) = delete;
+    SqliteCheckpointer& operator=(const SqliteCheckpointer&) = delete;
+
+    void stop();
+    uint64_t checkpoints() const { return checkpoints_.load(std::memory_order_relaxed); } // successful runs
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }           // WAL frames in the DB at the last run
+
+private:
+    void run_();
+
+    std::string path_;
+    std::chrono::milliseconds interval_;
+    sqlite3* db_ = nullptr;
+    std::mutex mx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::atomic<uint64_t> checkpoints_ { 0 };
+    std::atomic<uint64_t> frames_ { 0 };
+    std::thread thread_;
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * StmtCache
+ *  - Per-connection LRU of prepared statement handles keyed by SQL text
+ *  - Entries are shared: a live statement keeps its entry (and handle) alive
+ *  - Eviction never drops an entry still held by a statement; it is retried on the next put()
+ *  - The drop callback releases the backend handle (DEALLOCATE / sqlite3_finalize)
+ *
+ * Not thread-safe: a connection is used by one thread at a time (see DbPool).
+ */
+template <class Handle>
+class StmtCache {
+public:
+    struct Entry {
+        std::string sql;
+        Handle handle {};
+    };
+    using PEntry = std::shared_ptr<Entry>;
+    using DropFn = std::function<void(Entry&)>;
+
+    explicit StmtCache(std::size_t capacity = 64, DropFn drop = {})
+        : cap_(capacity)
+        , drop_(std::move(drop)) { }
+
+    StmtCache(const StmtCache&) = delete;
+    StmtCache& operator=(const StmtCache&) = delete;
+
+    ~StmtCache() { clear(); }
+
+    // Lookup by SQL text; a hit becomes the most recently used entry.
+    PEntry find(std::string_view sql) {
+        auto it = index_.find(sql);
+        if (it == index_.end()) return nullptr;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return *it->second;
+    }
+
+    // Register a freshly prepared handle; evicts least recently used idle entries over capacity.
+    PEntry put(std::string sql, Handle handle) {
+        auto e = std::make_shared<Entry>(Entry { std::move(sql), std::move(handle) });
+        lru_.push_front(e);
+        index_[e->sql] = lru_.begin(); // key views the entry's own string
+        evict_();
+        return e;
+    }
+
+    void capacity(std::size_t n) {
+        cap_ = n;
+        evict_();
+    }
+    std::size_t capacity() const { return cap_; }
+    std::size_t size() const { return lru_.size(); }
+
+    // Drop every handle (disconnect). Statements still holding an entry see an empty handle.
+    void clear() {
+        for (auto& e : lru_) {
+            if (drop_) drop_(*e);
+            e->handle = Handle {};
+        }
+        index_.clear();
+        lru_.clear();
+    }
+
+private:
+    using List = std::list<PEntry>;
+
+    void evict_() {
+        auto it = lru_.end();
+        while (lru_.size() > cap_ && it != lru_.begin()) {
+            --it;
+            if (it->use_count() > 1) continue; // still held by a statement
+            if (drop_) drop_(**it);
+            index_.erase((*it)->sql);
+            it = lru_.erase(it);
+        }
+    }
+
+    std::size_t cap_;
+    DropFn drop_;
+    List lru_; // front = most recently used
+    std::unordered_map<std::string_view, typename List::iterator> index_;
+};
@@ -1,26 +1,42 @@
 #pragma once
+#include <atomic>
+#include <istream>
 #include <memory>
 #include <optional>
+#include <source_location>
 #include <string>
 #include <unordered_map>
 #include <map>
+#include <mutex>
+#include <vector>
 #include "dbpool.hpp"
 #include "ddl_visitor.hpp"
 #include "dml_visitor.hpp"
 #include "snowflake.hpp"
 #include "sqlconnection.hpp"
+#include "sqlite_profile.hpp"
 #include "ulid.hpp"
 #include "lib.hpp"
 
-using OrmSchemaMap = std::map<std::string, std::shared_ptr<OrmSchema>>;
+// Storage catalog snapshot: never modified once published (see Storage::catalog())
+using OrmSchemaMap = std::unordered_map<std::string, std::shared_ptr<OrmSchema>>;
 
 using namespace std::literals::chrono_literals;
 // using Json = Json;
 
+// Connection layout of a Storage (see SplitDbPool)
+struct StorageOptions {
+    std::size_t writers = 10;           // max Postgres write connections (SQLite: always 1); 1 opened up front
+    std::size_t readers = 4;            // max read connections, opened on demand: SQLite read-only (WAL), Postgres per read DSN
+    std::chrono::milliseconds idle_timeout { 5 * 60 * 1000 }; // idle connections above the minimum are closed
+    std::vector<std::string> replicas;  // Postgres read replica DSNs; empty = reads go to db_path
+    SqliteProfile sqlite = SqliteProfile::defaults(); // SQLite connection PRAGMAs + background checkpoints; opt in to wal_tuned()
+};
+
 // Storage: simplified for SQLite; adapt for Postgres if needed.
 class Storage {
 public:
-    Storage(const std::string& db_path, Dialect dialect); // constructor
+    Storage(const std::string& db_path, Dialect dialect, StorageOptions options = {}); // constructor
     ~Storage() = default;
 
     /**
@@ -58,7 +74,9 @@ public:
      *
      * This method performs the following steps:
      *
-     * 1. Adds the OrmSchema to the in-memory catalog_ if not exists.
+     * 1. Adds the OrmSchema to the in-memory catalog_ if not exists; a higher version of a known
+     *    name replaces it (new requests use it, the old version's cached DML SQL is dropped once
+     *    the last snapshot or request holding it ends). Same or lower versions are ignored.
      * 2. call Storage::insert() to add to DB if @p conn is not null.
      *
      * @param schema The schema object to be added.
@@ -102,8 +120,9 @@ public:
      * @return
      */
     template <class F>
-    auto with_conn(pool::DbIntent intent, F&& fn) -> std::optional<std::invoke_result_t<F, SQLConnection&>> {
-        auto ac = dbpool_->acquire(intent, 1000ms);
+    auto with_conn(pool::DbIntent intent, F&& fn, std::source_location where = std::source_location::current())
+        -> std::optional<std::invoke_result_t<F, SQLConnection&>> {
+        auto ac = dbpool_->acquire(intent, 1000ms, where); // lease traced to our caller
         if (!ac.ok) return std::nullopt;
         // Keep the lease alive for the whole scope; it will release on destruction.
         auto& lease = ac.lease;
@@ -116,14 +135,15 @@ public:
 
     // Convenience: same as above, but return a default value when acquire fails.
     template <class F, class T = std::invoke_result_t<F, SQLConnection&>>
-    T with_conn_fb(pool::DbIntent intent, F&& fn, T fallback) {
-        auto r = with_conn(intent, std::forward<F>(fn));
+    T with_conn_fb(pool::DbIntent intent, F&& fn, T fallback, std::source_location where = std::source_location::current()) {
+        auto r = with_conn(intent, std::forward<F>(fn), where);
         return r ? *r : std::move(fallback);
     }
 
     template <class F>
-    auto with_tr(pool::DbIntent intent, F&& fn) -> std::optional<std::invoke_result_t<F, SQLConnection&>> {
-        auto ac = dbpool_->acquire(intent, 1000ms);
+    auto with_tr(pool::DbIntent intent, F&& fn, std::source_location where = std::source_location::current())
+        -> std::optional<std::invoke_result_t<F, SQLConnection&>> {
+        auto ac = dbpool_->acquire(intent, 1000ms, where);
         if (!ac.ok) return std::nullopt;
         auto& lease = ac.lease; // keep lease alive for whole TX
         SQLConnection& conn = lease.conn();
@@ -145,6 +165,9 @@ public:
     }
 
     bool execDDL(std::string sql); // executes SQL direct to DB
+    // CREATE TABLE + indexes for @p schema from the dialect's DDL visitor, one statement at a time;
+    // throws the first failing statement, false when no connection was available
+    bool createSchema(const OrmSchema& schema);
     int execDML(std::string sql, const std::vector<std::string>& params = {}); // executes SQL direct to DB
 
     /**
@@ -175,12 +198,16 @@ public:
      * 2. Do not start a transaction(TX) - must be controoled by caller
      * 3. prepare the statement
      * 4. check if data is a JSON Array or a JSON Object
-     * 5. for each JSON Object in data
-     *       5.1. if INSERT generate ID by IDKind prop of OrmField
-     *       5.2. bind the params and insert/upsert
-     *       5.3. if param track is not null  insert Track/Audit data
-     * 6. do not commit or rollback - trhow error - caller control TX
-     * 7. call notify() to notify subscribers for this Schema and this CRUD operation
+     * 5. group consecutive objects with the same keys and the same INSERT/UPSERT decision
+     *    into batches of up to batch_size() rows (multi-row VALUES, see DMLVisitor::insert_batch)
+     * 6. for each batch (arrays: queued in pipeline mode, see SQLConnection::pipeline_begin())
+     *       6.1. if INSERT generate ID by IDKind prop of OrmField (one per row)
+     *       6.2. bind the params of every row through the schema's BindPlan for the batch's key
+     *            shape (OrmSchema::bind_plan) and exec once
+     *       6.3. if param track is not null  insert Track/Audit data
+     * 7. arrays: pipeline_end() collects every result - throws the first error
+     * 8. do not commit or rollback - trhow error - caller control TX
+     * 9. call notify() to notify subscribers for this Schema and this CRUD operation
      *
      * @param conn Acquired conn ref - conn controls the Transaction state
      * @param schema the OrmSchema object used to insert data to
@@ -190,6 +217,49 @@ public:
      */
     int insert(SQLConnection& conn, OrmSchema& schema, jval& data, const std::string& trackinfo);
 
+    /**
+     * @brief Bulk load a JSON array into the @p schemaName table
+     *
+     * This method performs the following steps:
+     * 1 - find the OrmSchema by schemaName
+     * 2 - acquire a write conn from pool and begin a transaction
+     * 3 - columns come from the FIRST object: schema fields in JSON order, PK last, each with its
+     *     DDL visitor type (integer width in binary COPY)
+     * 4 - stream every object straight into SQLConnection::bulk_load() (Postgres COPY FROM STDIN)
+     *       4.1. keys missing from an object load as NULL; unknown keys are ignored
+     *       4.2. objects without a valid PK get one from create_id()
+     * 5 - finish the load and commit (rollback on error)
+     *
+     * Backends without a bulk path (SQLite) and DB-generated IDs (DBSerial/TBSerial)
+     * fall back to the batched Storage::insert().
+     *
+     * @param schemaName the schemaName to be loaded
+     * @param data a JSON array of objects (a single object is accepted)
+     * @param format COPY text (all types) or binary (integer/bool/text/json/bytea columns only);
+     *        bytea values are raw bytes or a "\\x..." hex literal in both formats
+     * @return number of rows loaded
+     */
+    int64_t bulk_insert(const std::string& schemaName, jval& data, CopyFormat format = CopyFormat::Text);
+
+    /**
+     * @brief Streaming Storage::insert() of a JSON array read from @p in
+     *
+     * This method performs the following steps:
+     * 1 - find the OrmSchema by schemaName
+     * 2 - acquire a write conn from pool and begin a transaction
+     * 3 - parse @p in with rapidjson::Reader (SAX): each top-level object is assembled in one
+     *     reusable chunk document; every batch_size() objects the chunk goes through the overloaded
+     *     Storage::insert(conn, schema, chunk, track) and its memory is rewound
+     * 4 - commit (rollback on a parse or DB error: nothing of the payload is kept)
+     *
+     * Memory stays bounded by one chunk of rows plus the read buffer, whatever the payload size.
+     * A single top-level object is accepted; non-object array elements are skipped like insert().
+     *
+     * @param in JSON text: a file, a FastCGI request body, ...
+     * @return number of rows affected; 0 when no connection was available in time
+     */
+    int64_t insert_stream(const std::string& schemaName, std::istream& in, const std::string& trackinfo);
+
     /**
      * @brief Update data into Schema table
      *
@@ -217,13 +287,14 @@ public:
      *       1.1. if ID is not present - throw an error
      *       1.2. else UPDATE
      * 2. Do not start a transaction(TX) - must be controled by caller
-     * 3. prepare the statement
-     * 4. check if data is a JSON Array or a JSON Object
+     * 3. prepare the statement (again only when the key shape changes between objects)
+     * 4. check if data is a JSON Array or a JSON Object - arrays run in pipeline mode
      * 5. for each JSON Object in data
      *       5.1. check if ID exists
      *       5.2. bind the params and update
      *       5.3. if param track is not null  insert Track/Audit data
      * 6. do not commit or rollback - throw error - caller control TX
+     *    (arrays: pipeline_end() collects the rows affected and throws the first error)
      * 7. call notify() to notify subscribers for this Schema and this CRUD operation
      *
      * @param conn Acquired conn ref - conn controls the Transaction state
@@ -234,6 +305,27 @@ public:
      */
     int update(SQLConnection& conn, OrmSchema& schema, jval& value, const std::string& trackinfo);
 
+    /**
+     * @brief Awaitable Storage::insert() / Storage::update() by @p schemaName
+     *
+     * For coroutines running on an aio::EventLoop (see aio::run):
+     * 1 - find the OrmSchema by schemaName
+     * 2 - co_await a write conn from the pool (IDbPool::co_acquire) - the thread is free meanwhile
+     * 3 - pipeline_begin(), begin(): BEGIN, every statement of the overloaded insert/update and
+     *     COMMIT are queued as one batch (Postgres pipeline mode)
+     * 4 - co_await SQLConnection::co_commit() - one round trip, the socket is awaited on the loop
+     * 5 - rollback() and rethrow on error
+     *
+     * Backends without pipelining (SQLite) run the statements synchronously, then commit.
+     *
+     * @return number of rows affected; 0 when no connection was available in time
+     */
+    aio::Task<int> co_insert(const std::string& schemaName, jval& data, const std::string& trackinfo);
+    aio::Task<int> co_update(const std::string& schemaName, jval& value, const std::string& trackinfo);
+    // steps 3 - 5 on a caller-held connection
+    aio::Task<int> co_insert(SQLConnection& conn, OrmSchema& schema, jval& data, const std::string& trackinfo);
+    aio::Task<int> co_update(SQLConnection& conn, OrmSchema& schema, jval& value, const std::string& trackinfo);
+
     /**
      * @brief Delete data from Schema table
      *
@@ -249,15 +341,72 @@ public:
      *       6.3 - if params user or context is not null  insert Track/Audit data
      * 7 - commit the Transaction
      * 8 - call notify() to notify subscribers for this Schema and this CRUD operation
+     *
+     * @return number of rows deleted; 0 when no connection was available in time
+     */
+    int del(const std::string& name, const jval& value, const std::string& user = "", const std::string& context = "");
+
+    /**
+     * @brief The last holder of a replaced version ended
+     *
+     * Run for the catalog_ entries replaced by addSchema(); also fits a SchemaBoss retire listener.
+     * Drops the SQL cached by the DMLVisitor for that schema version only: requests still on the
+     * version kept its statements until now, the new version's entries stay. Prepared statements
+     * built from that SQL are per connection (StmtCache) and age out of its LRU, as nothing
+     * generates their text any more.
+     */
+    void schema_retired(const OrmSchema& retired) { dmlVisitor_->invalidate(retired.name, retired.version); }
+
+    // entries in the DMLVisitor's SQL cache (see DMLVisitor::sql())
+    size_t cached_sql() const { return dmlVisitor_->cached_sql(); }
+
+    /**
+     * @brief Number of rows in the table of @p schemaName
+     *
+     * A read: runs on a DbIntent::Read lease, i.e. a reader connection when the pool has them
+     * (SQLite WAL read-only readers, Postgres read DSNs), so it never waits for the writer.
+     *
+     * @return the row count; -1 when no connection was available in time
+     */
+    int64_t count(const std::string& schemaName);
+
+    // true when @p name is in the in-memory catalog_
+    bool hasSchema(const std::string& name) const { return schema_(name) != nullptr; }
+
+    /**
+     * @brief Current catalog snapshot (RCU)
+     *
+     * Readers atomically load an immutable map and keep it, and the schemas in it, alive for as long
+     * as they hold the pointer; no lock is taken. addSchema() copies the map, adds to the copy and
+     * publishes it (writers serialize on a mutex), so a registration in progress never blocks or
+     * disturbs a lookup.
+     */
+    std::shared_ptr<const OrmSchemaMap> catalog() const { return catalog_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Max rows per multi-row INSERT/UPSERT statement
+     *
+     * The effective batch is also capped by the connection's parameter limit (SQLConnection::max_params(),
+     * else DMLVisitor::max_params()).
+     * 1 disables batching (one statement per row).
      */
-    void del(const std::string& name, const jval& value, const std::string& user = "", const std::string& context = "");
+    void batch_size(size_t rows) { batch_size_ = rows ? rows : 1; }
+    size_t batch_size() const { return batch_size_; }
 
 private:
     SnowflakeIdGenerator snowflake_;
-    OrmSchemaMap catalog_;
+    std::atomic<std::shared_ptr<const OrmSchemaMap>> catalog_; // RCU snapshot, see catalog()
+    std::mutex catalog_mx_;                                    // addSchema(): one writer at a time
     std::unique_ptr<pool::IDbPool> dbpool_;
+    std::unique_ptr<SqliteCheckpointer> checkpointer_; // SQLite WAL only; stopped before the pool closes
     std::unique_ptr<DDLVisitor> ddlVisitor_;
-    std::unique_ptr<DMLVisitor> dmlVisitor_;
+    std::shared_ptr<DMLVisitor> dmlVisitor_; // weakly held by catalog entries, see entry_()
+    size_t batch_size_ = 500;
     // std::unique_ptr<QRYVisitor> qryVisitor_;
-    void create_id(const std::shared_ptr<OrmProp> idprop, jdoc& doc, std::string key);
+    std::shared_ptr<OrmSchema> schema_(const std::string& name) const; // nullptr when unknown
+    std::shared_ptr<OrmSchema> entry_(const OrmSchema& schema);         // catalog_ entry: retires on last release
+    aio::Task<int> co_write_(const std::string& schemaName, jval& data, const std::string& trackinfo, bool update);
+    aio::Task<int> co_write_(SQLConnection& conn, OrmSchema& schema, jval& data, const std::string& trackinfo, bool update);
+    void create_id(const OrmProp& idprop, jdoc& doc, const std::string& key); // sets doc[key] = new_id_()
+    jval new_id_(const OrmProp& idprop, jalloc& alloc);                        // strings copied into @p alloc
 };
\ No newline at end of file
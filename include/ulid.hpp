@@ -9,6 +9,13 @@ class ULID {
 public:
     // Generate a new ULID string (Crockford's Base32, 26 chars)
     static std::string get_id() {
+        char ulid[27];
+        get_id(ulid);
+        return std::string(ulid, 26);
+    }
+
+    // Same, written into @p ulid (NUL terminated): no allocation
+    static void get_id(char (&ulid)[27]) {
         // 48 bits timestamp (ms since Unix epoch)
         auto now = std::chrono::system_clock::now();
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
@@ -43,7 +50,6 @@ public:
         // Crockford Base32 alphabet
         static const char* CROCKFORD = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
 
-        char ulid[27] = {};
         int bit = 0;
         for (int i = 0; i < 26; ++i) {
             int idx = 0;
@@ -57,6 +63,5 @@ public:
             bit += 5;
         }
         ulid[26] = '\0';
-        return std::string(ulid);
     }
 };
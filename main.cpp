@@ -1,53 +1,209 @@
-#include <iostream>
-#include "ddl_visitor.hpp"
-#include "schemaupdate.hpp"
+#include <fcgiapp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ecm_server.hpp"
+#include "storage.hpp"
+
+/**
+ * ecm FastCGI backend (see nginx_sample.conf)
+ *   orm [--socket PATH|:PORT] [--workers N] [--db PATH|DSN] [--dialect sqlite|postgres] schema.json...
+ *  - SQLite runs with SqliteProfile::wal_tuned() (WAL, synchronous=NORMAL, background checkpoints)
+ *  - the schema catalog (schema_catalog/schema_versions) is created and seeded before anything else
+ *  - every schema file is registered and its table created (IF NOT EXISTS); any failure stops startup
+ *  - N workers block in FCGX_Accept_r on the shared listen socket; each owns one FCGX_Request and one
+ *    RequestArena, reused for every request it serves
+ *  - SIGTERM/SIGINT: stop accepting, let in-flight requests finish, join the workers, exit
+ */
+
+struct ServerArgs {
+    std::string socket = "/tmp/ecm_backend.sock";
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    std::string db = "ecm.db";
+    Dialect dialect = Dialect::SQLite;
+    std::vector<std::string> schemas;
+};
 
-bool load_schema_from_file(const std::string &path, OrmSchema &schema)
-{
+static bool parse_args(int argc, char** argv, ServerArgs& args) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (a == "--socket" && has_value) {
+            args.socket = argv[++i];
+        } else if (a == "--workers" && has_value) {
+            args.workers = std::max(1, std::atoi(argv[++i]));
+        } else if (a == "--db" && has_value) {
+            args.db = argv[++i];
+        } else if (a == "--dialect" && has_value) {
+            const std::string d = argv[++i];
+            if (d == "sqlite") {
+                args.dialect = Dialect::SQLite;
+            } else if (d == "postgres") {
+                args.dialect = Dialect::Postgres;
+            } else {
+                return false;
+            }
+        } else if (a.rfind("--", 0) == 0) {
+            return false;
+        } else {
+            args.schemas.push_back(a);
+        }
+    }
+    return true;
+}
+
+static bool load_schema(Storage& storage, const std::string& path) {
     std::ifstream f(path);
-    if (!f)
+    if (!f) {
+        std::cerr << "cannot open schema " << path << std::endl;
+        return false;
+    }
+    std::stringstream ss;
+    ss << f.rdbuf();
+    jdoc doc;
+    if (!jhlp::parse_str(ss.str(), doc)) return false;
+    OrmSchema schema;
+    if (!OrmSchema::from_json(doc, schema)) {
+        std::cerr << "invalid schema " << path << std::endl;
+        return false;
+    }
+    try {
+        if (!storage.createSchema(schema)) {
+            std::cerr << "schema " << path << ": no database connection" << std::endl;
+            return false;
+        }
+        return storage.addSchema(schema);
+    } catch (const std::exception& e) {
+        std::cerr << "schema " << path << ": " << e.what() << std::endl;
         return false;
-    std::string j;
-    f >> j;
-    json::Document doc;
-    jhlp::parse_str(j, doc);
-    return OrmSchema::from_json(doc, schema);
+    }
 }
 
-int main()
-{
-    OrmSchema old_schema, new_schema;
-    if (!load_schema_from_file("../data/example-schema-old.json", old_schema))
-    {
-        std::cerr << "Failed to load old schema." << std::endl;
-        return 1;
+// bodies above this are streamed (EcmRouter::handle with an istream) instead of read whole
+constexpr long kStreamBody = 1024 * 1024;
+
+// std::istream source over FCGX_Request::in
+class FcgiInBuf : public std::streambuf {
+public:
+    explicit FcgiInBuf(FCGX_Stream* in)
+        : in_(in) { }
+
+protected:
+    int_type underflow() override {
+        const int n = FCGX_GetStr(buf_, sizeof(buf_), in_);
+        if (n <= 0) return traits_type::eof();
+        setg(buf_, buf_, buf_ + n);
+        return traits_type::to_int_type(buf_[0]);
     }
-    if (!load_schema_from_file("../data/example-schema-new.json", new_schema))
-    {
-        std::cerr << "Failed to load new schema." << std::endl;
-        return 1;
+
+private:
+    FCGX_Stream* in_;
+    char buf_[16 * 1024];
+};
+
+static long content_length(FCGX_Request& req) {
+    const char* len = FCGX_GetParam("CONTENT_LENGTH", req.envp);
+    return len ? std::atol(len) : 0;
+}
+
+static void read_body(FCGX_Request& req, long n, std::string& body) {
+    if (n <= 0) return;
+    body.resize(static_cast<std::size_t>(n));
+    std::size_t got = 0;
+    while (got < body.size()) {
+        const int r = FCGX_GetStr(body.data() + got, static_cast<int>(body.size() - got), req.in);
+        if (r <= 0) break;
+        got += static_cast<std::size_t>(r);
+    }
+    body.resize(got);
+}
+
+static void serve(int listen_fd, EcmRouter& router, const std::atomic<bool>& draining) {
+    FCGX_Request req;
+    FCGX_InitRequest(&req, listen_fd, 0);
+    RequestArena arena;
+    while (!draining.load(std::memory_order_acquire)) {
+        if (FCGX_Accept_r(&req) < 0) break; // listen socket shut down (drain) or fatal error
+        arena.reset();
+        const char* method = FCGX_GetParam("REQUEST_METHOD", req.envp);
+        const char* uri = FCGX_GetParam("REQUEST_URI", req.envp);
+        const long len = content_length(req);
+        int status;
+        if (len > kStreamBody) {
+            FcgiInBuf buf(req.in);
+            std::istream body(&buf);
+            status = router.handle(method ? method : "", uri ? uri : "", body, arena);
+        } else {
+            read_body(req, len, arena.body());
+            status = router.handle(method ? method : "", uri ? uri : "", arena);
+        }
+        FCGX_FPrintF(req.out, "Status: %d %s\r\nContent-Type: application/json\r\n\r\n", status, EcmRouter::reason(status));
+        FCGX_PutStr(arena.out().GetString(), static_cast<int>(arena.out().GetSize()), req.out);
+        FCGX_Finish_r(&req);
+    }
+    FCGX_Free(&req, 0);
+}
+
+int main(int argc, char** argv) {
+    ServerArgs args;
+    if (!parse_args(argc, argv, args)) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--socket PATH|:PORT] [--workers N] [--db PATH|DSN] [--dialect sqlite|postgres] schema.json..." << std::endl;
+        return 2;
     }
 
-    std::cout << "[*] Old Schema:" << std::endl;
-    // DDLVisitor dumper_old;
-    // old_schema.accept(dumper_old);
+    // signals are taken by one thread with sigwait(): block them before any other thread exists
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGTERM);
+    sigaddset(&sigs, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
 
-    std::cout << "\n[*] New Schema:" << std::endl;
-    // DDLVisitor dumper_new;
-    // new_schema.accept(dumper_new);
+    StorageOptions options;
+    options.sqlite = SqliteProfile::wal_tuned(); // WAL readers + background checkpoints; synchronous=NORMAL
+    Storage storage(args.db, args.dialect, options);
+    if (!storage.init_catalog()) {
+        std::cerr << "cannot initialize the schema catalog in " << args.db << std::endl;
+        return 1;
+    }
+    for (const auto& path : args.schemas) {
+        if (!load_schema(storage, path)) return 1; // never serve with a table missing
+    }
 
-    std::cout << "\n[*] Migration Plan (DDL diff):" << std::endl;
-    SchemaUpdate mgr(old_schema, new_schema);
-    auto ddls = mgr.plan_migration("postgres");
-    for (const auto &sql : ddls)
-    {
-        std::cout << sql << std::endl;
+    if (FCGX_Init() != 0) {
+        std::cerr << "FCGX_Init failed" << std::endl;
+        return 1;
+    }
+    const int listen_fd = FCGX_OpenSocket(args.socket.c_str(), 256);
+    if (listen_fd < 0) {
+        std::cerr << "cannot listen on " << args.socket << std::endl;
+        return 1;
     }
 
-    std::cout << "\n[*] PostgreSQL DDL (for new schema):" << std::endl;
-    PgDDLVisitor pg;
-    // new_schema.accept(pg);
+    EcmRouter router(storage);
+    std::atomic<bool> draining { false };
+    std::vector<std::thread> workers;
+    workers.reserve(args.workers);
+    for (unsigned i = 0; i < args.workers; ++i) workers.emplace_back(serve, listen_fd, std::ref(router), std::cref(draining));
+    std::cerr << "ecm: " << args.workers << " workers on " << args.socket << std::endl;
 
+    int sig = 0;
+    sigwait(&sigs, &sig);
+    std::cerr << "ecm: signal " << sig << ", draining" << std::endl;
+    draining.store(true, std::memory_order_release);
+    FCGX_ShutdownPending();
+    ::shutdown(listen_fd, SHUT_RDWR); // wakes workers blocked in accept(); in-flight requests finish
+    for (auto& w : workers) w.join();
     return 0;
 }
@@ -0,0 +1,144 @@
+#include "aio.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "lib.hpp"
+
+namespace aio {
+
+namespace {
+    thread_local EventLoop* current_loop = nullptr;
+
+    // current() for the duration of one loop iteration
+    struct CurrentScope {
+        EventLoop* prev;
+        explicit CurrentScope(EventLoop* l)
+            : prev(current_loop) { current_loop = l; }
+        ~CurrentScope() { current_loop = prev; }
+    };
+}
+
+EventLoop::EventLoop() {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) THROW("EventLoop: epoll_create1 failed: %s", std::strerror(errno));
+    wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakefd_ < 0) {
+        ::close(epfd_);
+        THROW("EventLoop: eventfd failed: %s", std::strerror(errno));
+    }
+    epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakefd_;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &ev);
+}
+
+EventLoop::~EventLoop() {
+    ::close(wakefd_);
+    ::close(epfd_);
+}
+
+EventLoop* EventLoop::current() { return current_loop; }
+
+void EventLoop::post(std::coroutine_handle<> h) {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        posted_.push_back(h);
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(wakefd_, &one, sizeof one);
+}
+
+void EventLoop::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        stop_ = true;
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(wakefd_, &one, sizeof one);
+}
+
+void EventLoop::run() {
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lk(mx_);
+            if (stop_) {
+                stop_ = false; // run() again after stop()
+                return;
+            }
+        }
+        run_once_(true);
+    }
+}
+
+EventLoop::Timer EventLoop::add_timer(Clock::time_point at, std::function<void()> fn) {
+    Timer t { at, ++timer_seq_ };
+    timers_.emplace(t, std::move(fn));
+    return t;
+}
+
+void EventLoop::cancel_timer(const Timer& t) { timers_.erase(t); }
+
+EventLoop::FdAwaiter EventLoop::readable(int fd) { return { *this, fd, EPOLLIN }; }
+EventLoop::FdAwaiter EventLoop::writable(int fd) { return { *this, fd, EPOLLOUT }; }
+
+void EventLoop::watch_(int fd, uint32_t events, std::coroutine_handle<> h) {
+    epoll_event ev {};
+    ev.events = events | EPOLLONESHOT;
+    ev.data.fd = fd;
+    // one-shot registrations stay in the set, disarmed: re-arm with MOD
+    const int op = fds_.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epfd_, op, fd, &ev) != 0 && !(op == EPOLL_CTL_MOD && errno == ENOENT && epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == 0))
+        THROW("EventLoop: epoll_ctl(%d) failed: %s", fd, std::strerror(errno));
+    fds_[fd] = h;
+}
+
+// one iteration: wait for I/O (until the next timer), resume ready fds, posted handles, due timers
+void EventLoop::run_once_(bool block) {
+    CurrentScope scope(this);
+
+    bool pending;
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        pending = !posted_.empty() || stop_;
+    }
+    int timeout = -1;
+    if (!block || pending) {
+        timeout = 0;
+    } else if (!timers_.empty()) {
+        const auto wait = timers_.begin()->first.first - Clock::now();
+        timeout = wait.count() <= 0 ? 0 : static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+    }
+
+    epoll_event events[64];
+    const int n = epoll_wait(epfd_, events, 64, timeout);
+    for (int i = 0; i < n; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == wakefd_) {
+            uint64_t v;
+            [[maybe_unused]] auto r = ::read(wakefd_, &v, sizeof v);
+            continue;
+        }
+        auto it = fds_.find(fd);
+        if (it == fds_.end() || !it->second) continue;
+        auto h = std::exchange(it->second, {}); // stays registered (disarmed) for the next MOD
+        h.resume();
+    }
+
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        ready.swap(posted_);
+    }
+    for (auto h : ready) h.resume();
+
+    const auto now = Clock::now();
+    while (!timers_.empty() && timers_.begin()->first.first <= now) {
+        auto fn = std::move(timers_.begin()->second);
+        timers_.erase(timers_.begin());
+        fn();
+    }
+}
+
+} // namespace aio
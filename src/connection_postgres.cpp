@@ -1,130 +1,275 @@
 // connection_postgres.cpp
-#include <format>
 #include <libpq-fe.h>
 #include <string>
 #include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <mutex>
 #include <lib.hpp>
+#include "pg_wire.hpp"
 #include "sqlconnection.hpp"
+#include "stmtcache.hpp"
+
+// server-side prepared statement; prepared lazily at first exec(), once parameter OIDs are known
+struct PgPrepared {
+    std::string name;
+    bool ready = false; // PQprepare/PQsendPrepare issued
+    int nparams = 0;    // $n placeholders: every statement sizes its parameter slots from it
+};
+
+// server-side prepared statements, by SQL text
+using PgStmtCache = StmtCache<PgPrepared>;
+
+// parameter type OIDs (pg_type.h)
+namespace pgoid {
+    constexpr Oid Unknown     = 0;    // text format, server infers the type
+    constexpr Oid Bool        = 16;
+    constexpr Oid Bytea       = 17;
+    constexpr Oid Int8        = 20;
+    constexpr Oid Float8      = 701;
+    constexpr Oid Date        = 1082;
+    constexpr Oid Time        = 1083;
+    constexpr Oid Timestamp   = 1114;
+    constexpr Oid TimestampTz = 1184;
+
+    // declared OID by schema type - fixed per column, so one prepared statement fits every row
+    inline Oid of(PropType type) {
+        switch (type) {
+            case PropType::Integer : return Int8;
+            case PropType::Number  : return Float8;
+            case PropType::Bool    : return Bool;
+            case PropType::Bin     : return Bytea;
+            case PropType::Date    : return Date;
+            case PropType::Time    : return Time;
+            case PropType::Dt_Time : return Timestamp;
+            case PropType::Tm_Stamp: return TimestampTz;
+            default                : return Unknown; // String, Json: text, server infers (json/jsonb/varchar)
+        }
+    }
+}
+
+// libpq pipeline state shared by a connection and its statements
+struct PgPipeline {
+    static constexpr int kWindow = 256; // sync every N queued statements (bounds unread results)
+    bool on = false;   // PQenterPipelineMode active
+    int queued = 0;    // statements sent since the last sync
+    int rows = 0;      // rows affected collected by window syncs, reported by the final sync
+    int prepared = 0;  // statements prepared (PQsendPrepare) since pipeline_begin()
+    int depth = 0;     // nested pipeline_begin() calls
+};
+
+// Rows affected and first error over a stream of results; add() takes ownership of @p res
+// and returns true at PGRES_PIPELINE_SYNC
+struct PgResults {
+    int rows = 0;
+    std::string err;
+
+    bool add(PGresult* res) {
+        auto st = PQresultStatus(res);
+        if (st == PGRES_PIPELINE_SYNC) { PQclear(res); return true; }
+        if (st == PGRES_COMMAND_OK) {
+            const char* t = PQcmdTuples(res);
+            rows += (t && *t) ? std::atoi(t) : 0;
+        } else if (st != PGRES_TUPLES_OK && st != PGRES_PIPELINE_ABORTED && err.empty()) {
+            err = PQresultErrorMessage(res);
+        }
+        PQclear(res);
+        return false;
+    }
+};
+
+// Sync point: send Sync and collect every queued result up to PGRES_PIPELINE_SYNC.
+// Returns rows affected; throws the first error (statements after it come back PIPELINE_ABORTED).
+static int pg_pipeline_sync(PGconn* conn, PgPipeline& pipe) {
+    if (PQpipelineSync(conn) != 1) THROW(std::string("Postgres pipeline sync failed: ") + PQerrorMessage(conn));
+    PgResults out;
+    for (;;) {
+        PGresult* res = PQgetResult(conn);
+        if (!res) {
+            if (PQstatus(conn) == CONNECTION_BAD) { out.err = PQerrorMessage(conn); break; }
+            continue; // end of one statement's results
+        }
+        if (out.add(res)) break;
+    }
+    pipe.queued = 0;
+    if (!out.err.empty()) THROW("Postgres pipeline failed: " + out.err);
+    return out.rows;
+}
+
+// libpq non-blocking mode for the duration of one awaitable operation
+// (PQexec and friends keep blocking regardless, so the rest of the connection is unaffected)
+struct PgNonblocking {
+    PGconn* conn;
+    explicit PgNonblocking(PGconn* c) : conn(c) { PQsetnonblocking(conn, 1); }
+    ~PgNonblocking() { PQsetnonblocking(conn, 0); }
+};
+
+// Suspend on @p loop until the request is flushed and PQgetResult() will not block
+static aio::Task<void> pg_co_ready(aio::EventLoop& loop, PGconn* conn) {
+    const int fd = PQsocket(conn);
+    for (;;) {
+        const int f = PQflush(conn);
+        if (f < 0) THROW(std::string("Postgres send failed: ") + PQerrorMessage(conn));
+        if (f == 0) break;
+        co_await loop.writable(fd);
+        if (PQconsumeInput(conn) != 1) THROW(std::string("Postgres read failed: ") + PQerrorMessage(conn));
+    }
+    while (PQisBusy(conn)) {
+        co_await loop.readable(fd);
+        if (PQconsumeInput(conn) != 1) THROW(std::string("Postgres read failed: ") + PQerrorMessage(conn));
+    }
+}
+
+// Results of one sent command (up to the terminating null result); rows affected, throws the error
+static aio::Task<int> pg_co_results(aio::EventLoop& loop, PGconn* conn, const char* what) {
+    PgResults out;
+    for (;;) {
+        co_await pg_co_ready(loop, conn);
+        PGresult* res = PQgetResult(conn);
+        if (!res) break;
+        out.add(res);
+    }
+    if (!out.err.empty()) THROW(std::string("Postgres ") + what + " failed: " + out.err);
+    co_return out.rows;
+}
+
+// Awaitable pg_pipeline_sync(); blocking when no loop runs on this thread
+static aio::Task<int> pg_co_pipeline_sync(PGconn* conn, PgPipeline& pipe) {
+    aio::EventLoop* loop = aio::EventLoop::current();
+    if (!loop) co_return pg_pipeline_sync(conn, pipe);
+    PgNonblocking nb(conn);
+    if (PQpipelineSync(conn) != 1) THROW(std::string("Postgres pipeline sync failed: ") + PQerrorMessage(conn));
+    PgResults out;
+    for (;;) {
+        co_await pg_co_ready(*loop, conn);
+        PGresult* res = PQgetResult(conn);
+        if (!res) {
+            if (PQstatus(conn) == CONNECTION_BAD) { out.err = PQerrorMessage(conn); break; }
+            continue;
+        }
+        if (out.add(res)) break;
+    }
+    pipe.queued = 0;
+    if (!out.err.empty()) THROW("Postgres pipeline failed: " + out.err);
+    co_return out.rows;
+}
 
 /*=============================  PgStatement  =============================*/
 class PgStatement final : public SQLStatement {
 public:
-    PgStatement(PGconn* conn, std::string sql, std::string name)
-        : conn_(conn), sql_(std::move(sql)) { name_ = name; }
+    // @p generation is the connection's statement generation; a statement made before the
+    // connection dropped its server-side statements refuses to run (its name is gone)
+    PgStatement(PGconn* conn, PgPipeline& pipe, const uint64_t& generation, PgStmtCache::PEntry prepared)
+        : conn_(conn), pipe_(pipe), connGen_(generation), gen_(generation), prepared_(std::move(prepared)) {
+        name_ = prepared_->handle.name;
+        // sized once: params_ points into scalars_/values_, so binding must never reallocate them
+        const size_t n = static_cast<size_t>(prepared_->handle.nparams);
+        params_.resize(n, nullptr);
+        lengths_.resize(n, 0);
+        formats_.resize(n, 0);
+        types_.resize(n, pgoid::Unknown);
+        scalars_.resize(n);
+        values_.resize(n);
+    }
 
     ~PgStatement() override = default;
 
-    // Bind positional parameter (1-based) with declared schema type
+    // Bind positional parameter (1-based) with declared schema type.
+    // Scalars go in binary format with the OID of the schema type; strings are sent straight from
+    // the JSON value (no copy) - @p value must stay alive until exec() returns.
     void bind(int idx, const jval& value, const PropType& type) override {
         ensure_slot_(idx);
+        types_[idx-1] = pgoid::of(type);
 
         if (value.IsNull()) { set_null(idx); return; }
 
         switch (type) {
             case PropType::String: {
-                if(value.IsString()) {str v= value.GetString(); set_text(idx, "'"+v+"'"); return;}
-                THROW("bind: expected string"); return;
-            }break;
-            case PropType::Integer:
-            case PropType::Number : {
-                if (value.IsInt    ()) {int      v = value.GetInt    (); set_text(idx, std::to_string(v)); return; }
-                if (value.IsInt64  ()) {int64_t  v = value.GetInt64  (); set_text(idx, std::to_string(v)); return; }
-                if (value.IsUint   ()) {uint     v = value.GetUint   (); set_text(idx, std::to_string(v)); return; }
-                if (value.IsUint64 ()) {uint64_t v = value.GetUint64 (); set_text(idx, std::to_string(v)); return; }
-                if (value.IsFloat  ()) {float    v = value.GetDouble (); set_text(idx, std::to_string(v)); return; }
-                if (value.IsDouble ()) {double   v = value.GetDouble (); set_text(idx, std::to_string(v)); return; }
-                THROW("bind: expected integer or number");
-            }; break;
+                if (value.IsString()) { set_ref(idx, value); return; }
+                THROW_INVALID("bind: expected string");
+            }
+            case PropType::Integer: {
+                if (value.IsInt64()) { set_int8(idx, value.GetInt64()); return; }
+                if (value.IsUint64()) THROW_INVALID("bind: integer out of int8 range");
+                if (value.IsDouble()) {
+                    double v = value.GetDouble();
+                    if (v != std::trunc(v) || v < -9.2233720368547758e18 || v >= 9.2233720368547758e18)
+                        THROW_INVALID("bind: expected integer");
+                    set_int8(idx, static_cast<int64_t>(v));
+                    return;
+                }
+                THROW_INVALID("bind: expected integer or number");
+            }
+            case PropType::Number: {
+                if (value.IsNumber()) { set_float8(idx, value.GetDouble()); return; }
+                THROW_INVALID("bind: expected integer or number");
+            }
             case PropType::Bool: {
-                if(value.IsBool()){set_bool(idx, value.GetBool() ); return;}
-                if (value.IsInt()){set_bool(idx, value.GetInt() == 1 ? true : false);return;} // 0=false 1 = true
-                THROW("bind: expected boolean");
-            }; break;
+                if (value.IsBool()) { set_bool(idx, value.GetBool()); return; }
+                if (value.IsInt()) { set_bool(idx, value.GetInt() == 1); return; } // 0=false 1 = true
+                THROW_INVALID("bind: expected boolean");
+            }
             case PropType::Date:
             case PropType::Time:
             case PropType::Dt_Time:
             case PropType::Tm_Stamp: {
-                if (!value.IsString()) {set_datetime(idx, value.GetString()); return;}
-                THROW("bind: expected ISO-8601 string for date/time");
-            };break;
+                if (!value.IsString()) THROW_INVALID("bind: expected ISO-8601 string for date/time");
+                int64_t v;
+                if (!pgtime::parse(value.GetString(), value.GetStringLength(), type, v)) {
+                    set_ref(idx, value); // other spellings: text, the server parses them
+                } else if (type == PropType::Date) {
+                    set_int4(idx, static_cast<int32_t>(v));
+                } else {
+                    set_int8(idx, v);
+                }
+                return;
+            }
             case PropType::Json: {
-                if (value.IsObject()) {set_text(idx, jhlp::dump(value)); return;}
-                if (value.IsArray() ) {set_text(idx, jhlp::dump(value)); return;}
-                if (value.IsString()) {set_text(idx, value.GetString()); return;}
-                THROW("bind: expected JSON object JSON array or string");
-            }break;
+                if (value.IsObject() || value.IsArray()) { set_text(idx, jhlp::dump(value)); return; }
+                if (value.IsString()) { set_ref(idx, value); return; }
+                THROW_INVALID("bind: expected JSON object JSON array or string");
+            }
             case PropType::Bin: {
-                if (value.IsString()) {set_encoded(idx, value.GetString()); return;}
-                THROW("bind: expected binary as yEnc string");
+                if (!value.IsString()) THROW_INVALID("bind: expected binary as yEnc string");
+                const char* p = value.GetString();
+                if (value.GetStringLength() >= 2 && p[0] == '\\' && p[1] == 'x') { // bytea hex literal
+                    set_ref(idx, value);
+                } else {
+                    set_binary(idx, p, value.GetStringLength()); // raw bytes
+                }
+                return;
             }
         }
         THROW("bind: unsupported declared type for Postgres");
-
-        // // 2) Match declared schema type (strict)
-        // if (type == PropType::String) {
-        //     if (!value.IsString()) THROW("bind: expected string");
-        //     set_text(value.GetString());
-        //     return;
-        // }
-
-        // if (type == PropType::Integer || type == PropType::Number) {
-        //     if (value.IsInt    ()) {int      v = value.GetInt    (); set_text(std::to_string(v)); return; }
-        //     if (value.IsInt64  ()) {int64_t  v = value.GetInt64  (); set_text(std::to_string(v)); return; }
-        //     if (value.IsUint   ()) {uint     v = value.GetUint   (); set_text(std::to_string(v)); return; }
-        //     if (value.IsUint64 ()) {uint64_t v = value.GetUint64 (); set_text(std::to_string(v)); return; }
-        //     if (value.IsFloat  ()) {float    v = value.GetDouble (); set_text(std::to_string(v)); return; }
-        //     if (value.IsDouble ()) {double   v = value.GetDouble (); set_text(std::to_string(v)); return; }
-        //     THROW("bind: expected integer or number");
-        // }
-
-        // if (type == PropType::Bool) {
-        //     if (value.IsBool()) {
-        //         set_text(bool_to_text( value.GetBool() ));
-        //         return;
-        //     }
-        //     if (value.IsInt()) {
-        //         set_text(bool_to_text(value.GetInt() != 0));
-        //         return;
-        //     }
-        //     THROW("bind: expected boolean");
-        // }
-
-        // Dates/times as ISO-8601 text; server casts to DATE/TIME/TIMESTAMP/TIMESTAMPTZ
-        // if (type == PropType::Date || type == PropType::Time || type == PropType::Dt_Time || type == PropType::Tm_Stamp) {
-        //     if (!value.IsString()) THROW("bind: expected ISO-8601 string for date/time");
-        //     set_text(value.GetString());
-        //     return;
-        // }
-
-        // JSON as text (server parses into json)
-        // if (type == PropType::Json) {
-        //     if (value.IsString()) set_text(value.GetString());
-        //     else set_text(value.GetString());
-        //     return;
-        // }
-
-        // BYTEA as hex text (“\x...”) so we can keep text format
-        // if (type == PropType::Bin) {
-        //     if (!value.IsString()) THROW("bind: expected binary as yEnc string");
-        //     // const std::string& raw = value.get_ref<const std::string&>();
-        //     set_text(idx, value.GetString());
-        //     return;
-        // }
-
     }
 
     // Execute and return rows affected (INSERT/UPDATE/DELETE) or row count for SELECT
+    // In pipeline mode: queue and return 0 - rows are reported by the sync point
     int exec() override {
+        check_generation_();
         const int nParams = static_cast<int>(params_.size());
-        PGresult* res = PQexecParams(
+        if (!prepared_->handle.ready) prepare_(nParams);
+        if (pipe_.on) {
+            // params are copied into libpq's output buffer, the statement can be re-bound right away
+            if (PQsendQueryPrepared(conn_, name_.c_str(), nParams,
+                    (nParams ? params_.data()  : nullptr),
+                    (nParams ? lengths_.data() : nullptr),
+                    (nParams ? formats_.data() : nullptr), 0) != 1) {
+                THROW(std::string("Postgres pipeline send failed: ") + PQerrorMessage(conn_));
+            }
+            if (++pipe_.queued >= PgPipeline::kWindow) pipe_.rows += pg_pipeline_sync(conn_, pipe_);
+            return 0;
+        }
+        PGresult* res = PQexecPrepared(
             conn_,
-            sql_.c_str(),
+            name_.c_str(),                             // parsed/planned once per connection
             nParams,
-            nullptr,                                   // let server infer types
             (nParams ? params_.data()  : nullptr),
             (nParams ? lengths_.data() : nullptr),
-            (nParams ? formats_.data() : nullptr),     // all text format
+            (nParams ? formats_.data() : nullptr),     // per param: 0 text, 1 binary
             0                                          // text results
         );
         if (!res) THROW("Postgres exec failed: no result");
@@ -141,16 +286,54 @@ public:
             const char* t = PQcmdTuples(res);
             rows = (t && *t) ? std::atoi(t) : 0;
         }
-        // else { // PGRES_TUPLES_OK
-        //     rows = PQntuples(res);
-        //     int cols = PQnfields(res);
-        //     if (!PQgetisnull(res, 0, 0)) {
-
-        //     }
-        // }
         PQclear(res);
         return rows;
     }
+    // First column of the first row (text result); not in pipeline mode, the result would come at the sync
+    int64_t query_int() override {
+        check_generation_();
+        if (pipe_.on) THROW("Postgres query_int: not available in pipeline mode");
+        const int nParams = static_cast<int>(params_.size());
+        if (!prepared_->handle.ready) prepare_(nParams);
+        PGresult* res = PQexecPrepared(conn_, name_.c_str(), nParams,
+            (nParams ? params_.data()  : nullptr),
+            (nParams ? lengths_.data() : nullptr),
+            (nParams ? formats_.data() : nullptr), 0);
+        if (!res) THROW("Postgres query failed: no result");
+        if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) < 1 || PQgetisnull(res, 0, 0)) {
+            std::string err = PQresultStatus(res) == PGRES_TUPLES_OK ? "no row" : PQerrorMessage(conn_);
+            PQclear(res);
+            THROW("Postgres query failed: " + err);
+        }
+        const int64_t v = std::strtoll(PQgetvalue(res, 0, 0), nullptr, 10);
+        PQclear(res);
+        return v;
+    }
+
+    // exec() without blocking the thread: PQsendPrepare/PQsendQueryPrepared, then the socket is
+    // awaited on the current aio::EventLoop. In pipeline mode (or outside a loop) this is exec().
+    aio::Task<int> co_exec() override {
+        aio::EventLoop* loop = aio::EventLoop::current();
+        if (pipe_.on || !loop) co_return exec();
+        check_generation_();
+        PgNonblocking nb(conn_);
+        const int nParams = static_cast<int>(params_.size());
+        if (!prepared_->handle.ready) {
+            if (PQsendPrepare(conn_, name_.c_str(), prepared_->sql.c_str(), nParams,
+                    (nParams ? types_.data() : nullptr)) != 1)
+                THROW(std::string("Postgres prepare failed: ") + PQerrorMessage(conn_));
+            co_await pg_co_results(*loop, conn_, "prepare");
+            prepared_->handle.ready = true;
+        }
+        if (PQsendQueryPrepared(conn_, name_.c_str(), nParams,
+                (nParams ? params_.data()  : nullptr),
+                (nParams ? lengths_.data() : nullptr),
+                (nParams ? formats_.data() : nullptr), 0) != 1) {
+            THROW(std::string("Postgres exec failed: ") + PQerrorMessage(conn_));
+        }
+        co_return co_await pg_co_results(*loop, conn_, "exec");
+    }
+
 protected:
     void set_null(int idx) override {
         params_[idx-1]  = nullptr;  // SQL NULL
@@ -158,33 +341,168 @@ protected:
         formats_[idx-1] = 0;        // text format
     }
 
+    // owned text (dumped JSON); the slot's string keeps its capacity across rows
     void set_text(int idx, std::string value) override {
-        if (static_cast<size_t>(idx) > values_.size()) {
-            values_.resize(idx);
-        }
-        values_[idx-1]  = value;                   // own storage
-        params_[idx-1]  = value.c_str();
-        lengths_[idx-1] = static_cast<int>(value.size());
+        values_[idx-1]  = std::move(value);
+        params_[idx-1]  = values_[idx-1].c_str();
+        lengths_[idx-1] = static_cast<int>(values_[idx-1].size());
         formats_[idx-1] = 0;
     }
+
 private:
-    void ensure_slot_(int idx) {
-        if (idx < 1) THROW("bind: index must be >= 1");
-        if (static_cast<size_t>(idx) > params_.size()) {
-            params_.resize(idx, nullptr);
-            lengths_.resize(idx, 0);
-            formats_.resize(idx, 0);
+    // text straight from the JSON value (NUL-terminated by rapidjson)
+    void set_ref(int idx, const jval& value) {
+        params_[idx-1]  = value.GetString();
+        lengths_[idx-1] = static_cast<int>(value.GetStringLength());
+        formats_[idx-1] = 0;
+    }
+
+    void set_binary(int idx, const char* data, size_t len) {
+        params_[idx-1]  = data;
+        lengths_[idx-1] = static_cast<int>(len);
+        formats_[idx-1] = 1;
+    }
+
+    // fixed-width binary values live in the slot's 8 bytes, big-endian (pgwire)
+    void set_int4(int idx, int32_t v) {
+        pgwire::int4(scalars_[idx-1].data(), v);
+        set_binary(idx, scalars_[idx-1].data(), 4);
+    }
+    void set_int8(int idx, int64_t v) {
+        pgwire::int8(scalars_[idx-1].data(), v);
+        set_binary(idx, scalars_[idx-1].data(), 8);
+    }
+    void set_float8(int idx, double v) {
+        pgwire::float8(scalars_[idx-1].data(), v);
+        set_binary(idx, scalars_[idx-1].data(), 8);
+    }
+    void set_bool(int idx, bool v) {
+        pgwire::boolean(scalars_[idx-1].data(), v);
+        set_binary(idx, scalars_[idx-1].data(), 1);
+    }
+
+    // first exec: prepare with the bound OIDs (binary params need explicit types)
+    void prepare_(int nParams) {
+        const std::string& sql = prepared_->sql;
+        const Oid* types = nParams ? types_.data() : nullptr;
+        if (pipe_.on) { // queued ahead of its executions; errors surface at the sync point
+            if (PQsendPrepare(conn_, name_.c_str(), sql.c_str(), nParams, types) != 1)
+                THROW(std::string("Postgres prepare failed: ") + PQerrorMessage(conn_));
+            ++pipe_.prepared;
+        } else {
+            PGresult* res = PQprepare(conn_, name_.c_str(), sql.c_str(), nParams, types);
+            if (!res) THROW("Postgres prepare failed: no result");
+            if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+                std::string err = PQerrorMessage(conn_);
+                PQclear(res);
+                THROW("Postgres prepare failed: " + err);
+            }
+            PQclear(res);
         }
-        if (static_cast<size_t>(idx) > values_.size())
-            values_.resize(idx);
+        prepared_->handle.ready = true;
+    }
+
+    void check_generation_() const {
+        if (gen_ != connGen_) THROW("Postgres exec: statement invalidated (failed pipeline or reconnect), prepare it again");
+    }
+
+    // slots are sized by the constructor; an index past the statement's placeholders is a caller error
+    void ensure_slot_(int idx) {
+        if (idx < 1 || static_cast<size_t>(idx) > params_.size())
+            THROW("bind: parameter index %d out of range (statement has %d)", idx, static_cast<int>(params_.size()));
     }
 
     PGconn* conn_;
-    std::string sql_;
+    PgPipeline& pipe_;
+    const uint64_t& connGen_;      // the connection's current generation
+    const uint64_t gen_;           // generation this statement was made in
+    PgStmtCache::PEntry prepared_; // keeps the server statement from being evicted while in use
     std::vector<const char*> params_;
-    std::vector<std::string> values_; // backing for params_
     std::vector<int> lengths_;
     std::vector<int> formats_;
+    std::vector<Oid> types_;
+    std::vector<std::array<char, 8>> scalars_; // backing for binary params
+    std::vector<std::string> values_;          // backing for owned text params
+};
+
+/*=============================  PgBulkLoad  =============================*/
+// COPY <table> (<cols>) FROM STDIN; rows are encoded straight from the JSON values (PgCopyEncoder)
+// into a send buffer that is flushed with PQputCopyData every kFlushBytes.
+class PgBulkLoad final : public SQLBulkLoad {
+public:
+    PgBulkLoad(PGconn* conn, const std::string& table, const std::vector<CopyColumn>& columns, CopyFormat format)
+        : conn_(conn), enc_(columns, format) {
+        std::string sql = "COPY " + table + " (";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (i) sql += ", ";
+            sql += columns[i].name;
+        }
+        sql += ") FROM STDIN";
+        if (format == CopyFormat::Binary) sql += " WITH (FORMAT binary)";
+        sql += ";";
+
+        PGresult* res = PQexec(conn_, sql.c_str());
+        if (!res) THROW("Postgres COPY failed: no result");
+        if (PQresultStatus(res) != PGRES_COPY_IN) {
+            std::string err = PQerrorMessage(conn_);
+            PQclear(res);
+            THROW("Postgres COPY failed: " + err);
+        }
+        PQclear(res);
+        active_ = true;
+        enc_.buffer().reserve(kFlushBytes + 1024);
+    }
+
+    ~PgBulkLoad() override {
+        if (!active_) return;
+        PQputCopyEnd(conn_, "bulk load aborted");
+        drain_();
+    }
+
+    void put(const jval& value, const PropType& type) override { enc_.put(value, type); }
+
+    void put_null() override { enc_.put_null(); }
+
+    void end_row() override {
+        enc_.end_row();
+        if (enc_.buffer().size() >= kFlushBytes) flush_();
+    }
+
+    int64_t finish() override {
+        if (!active_) THROW("bulk_load: already finished");
+        enc_.finish();
+        flush_();
+        active_ = false;
+        if (PQputCopyEnd(conn_, nullptr) != 1) THROW(std::string("Postgres COPY end failed: ") + PQerrorMessage(conn_));
+        std::string err = drain_();
+        if (!err.empty()) THROW("Postgres COPY failed: " + err);
+        return enc_.rows();
+    }
+
+private:
+    static constexpr size_t kFlushBytes = 256 * 1024;
+
+    void flush_() {
+        std::string& buf = enc_.buffer();
+        if (buf.empty()) return;
+        if (PQputCopyData(conn_, buf.data(), static_cast<int>(buf.size())) != 1)
+            THROW(std::string("Postgres COPY send failed: ") + PQerrorMessage(conn_));
+        buf.clear();
+    }
+
+    // collect the COPY command result(s); returns the error text, empty on success
+    std::string drain_() {
+        std::string err;
+        while (PGresult* res = PQgetResult(conn_)) {
+            if (PQresultStatus(res) != PGRES_COMMAND_OK && err.empty()) err = PQresultErrorMessage(res);
+            PQclear(res);
+        }
+        return err;
+    }
+
+    PGconn* conn_;
+    PgCopyEncoder enc_;
+    bool active_ = false;
 };
 
 /*=============================  PgConnection  =============================*/
@@ -201,19 +519,31 @@ public:
             disconnect();
             THROW("Postgres connect failed: " + err);
         }
+        std::lock_guard<std::mutex> lk(cancel_mx_);
+        cancel_ = PQgetCancel(conn_);
     }
 
     void disconnect() override {
+        pipe_ = {};     // pending pipeline results die with the connection
+        stmts_.clear(); // DEALLOCATE while the connection is still open
+        ++gen_;         // live statements hold names of the old session
+        deallocAll_ = false;
+        {
+            std::lock_guard<std::mutex> lk(cancel_mx_);
+            if (cancel_) PQfreeCancel(cancel_);
+            cancel_ = nullptr;
+        }
         if (conn_) {
             PQfinish(conn_);
             conn_ = nullptr;
         }
     }
 
+    // in pipeline mode BEGIN is queued with the statements that follow it
     bool begin() override {
         try {
             if (tr_started_) return true;
-            tr_started_ = execSQL("BEGIN;");
+            tr_started_ = pipe_.on ? queue_("BEGIN") : execSQL("BEGIN;");
             return tr_started_;
         } catch(...) {
             return false;
@@ -222,6 +552,10 @@ public:
 
     bool commit() {
         if (!tr_started_) return false;
+        if (pipe_.on) { // sync point: errors surface before COMMIT
+            pipe_.depth = 0;
+            pipeline_end();
+        }
         if (execSQL("COMMIT;")) {
             tr_started_ = false;
             return true;
@@ -229,22 +563,122 @@ public:
         return false;
     }
 
+    // COMMIT is queued behind the pipelined statements and the whole batch is collected with the
+    // socket awaited on the current aio::EventLoop: BEGIN ... COMMIT costs one round trip
+    aio::Task<int> co_commit() override {
+        if (!tr_started_) THROW("co_commit: no transaction");
+        if (!pipeline_begin()) THROW("co_commit: pipeline mode unavailable");
+        queue_("COMMIT");
+        int rows = 0;
+        try {
+            rows = co_await pg_co_pipeline_sync(conn_, pipe_);
+            rows += pipe_.rows; // window syncs along the way
+        } catch (...) {
+            leave_pipeline_(true); // still in the failed transaction: the caller rolls back
+            throw;
+        }
+        leave_pipeline_(false);
+        tr_started_ = false;
+        co_return rows;
+    }
+
     void rollback() {
         if (!tr_started_) return;
+        if (pipe_.on) {
+            try { pg_pipeline_sync(conn_, pipe_); } catch (...) { } // discard queued results
+            leave_pipeline_(true);
+        }
         if (execSQL("ROLLBACK;")) {
             tr_started_ = false;
+            deallocate_all_();
         }
     }
 
     std::unique_ptr<SQLStatement> prepare(const std::string& sql, int numParams=-1) override {
         if (!conn_) THROW("prepare: not connected");
-        return std::make_unique<PgStatement>(conn_, sql, stmtName());
+        deallocate_all_();
+        auto prepared = stmts_.find(sql);
+        // new SQL: named now, prepared on the server at first exec() with the bound param OIDs
+        if (!prepared) prepared = stmts_.put(sql, PgPrepared { stmtName(), false, numParams >= 0 ? numParams : pgwire::param_count(sql) });
+        return std::make_unique<PgStatement>(conn_, pipe_, gen_, std::move(prepared));
+    }
+
+    void stmt_cache_size(std::size_t n) override { stmts_.capacity(n); }
+
+    std::unique_ptr<SQLBulkLoad> bulk_load(const std::string& table,
+        const std::vector<CopyColumn>& columns, CopyFormat format) override {
+        if (!conn_) THROW("bulk_load: not connected");
+        if (pipe_.on) THROW("bulk_load: not allowed in pipeline mode");
+        return std::make_unique<PgBulkLoad>(conn_, table, columns, format);
+    }
+
+    // no round trip: libpq marks the connection bad after a failed read/write
+    bool healthy() override {
+        return conn_ && PQstatus(conn_) == CONNECTION_OK && !pipe_.on && PQtransactionStatus(conn_) == PQTRANS_IDLE;
+    }
+
+    // empty query: cheapest server round trip
+    bool ping() override {
+        if (!healthy()) return false;
+        PGresult* res = PQexec(conn_, "");
+        const bool ok = res && PQresultStatus(res) == PGRES_EMPTY_QUERY;
+        PQclear(res);
+        return ok && PQstatus(conn_) == CONNECTION_OK;
     }
 
+    // PQcancel: asks the server to abort the running query; the owner's exec() then fails
+    void cancel() override {
+        std::lock_guard<std::mutex> lk(cancel_mx_);
+        if (!cancel_) return;
+        char err[256];
+        PQcancel(cancel_, err, sizeof err);
+    }
+
+    bool pipeline_begin() override {
+        if (!conn_) THROW("pipeline_begin: not connected");
+        if (pipe_.on) {
+            ++pipe_.depth;
+            return true;
+        }
+        if (PQenterPipelineMode(conn_) != 1) return false;
+        pipe_ = {};
+        pipe_.on = true;
+        return true;
+    }
+
+    int pipeline_end() override {
+        if (!pipe_.on) return 0;
+        if (pipe_.depth > 0) {
+            --pipe_.depth;
+            return 0; // the outer sync point collects
+        }
+        int rows = 0;
+        try {
+            rows = pg_pipeline_sync(conn_, pipe_);
+            rows += pipe_.rows; // window syncs along the way
+        } catch (...) {
+            leave_pipeline_(true);
+            throw;
+        }
+        leave_pipeline_(false);
+        return rows;
+    }
+
+    // the sequence name is a parameter: one SQL text for every sequence, nothing per name cached
     int64_t nextValue(std::string name) override{
-        std::string sql = std::format("select nextval('%s')", name);
-        std::unique_ptr<SQLStatement> stmt = prepare(sql);
-        return 0 ;
+        if (!conn_) THROW("nextValue: not connected");
+        if (pipe_.on) THROW("nextValue: not allowed in pipeline mode");
+        const char* values[1] = { name.c_str() };
+        PGresult* res = PQexecParams(conn_, "SELECT nextval($1::regclass);", 1, nullptr, values, nullptr, nullptr, 0);
+        if (!res) THROW("Postgres nextval failed: no result");
+        if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1) {
+            std::string err = PQerrorMessage(conn_);
+            PQclear(res);
+            THROW("Postgres nextval failed: " + err);
+        }
+        const int64_t id = std::strtoll(PQgetvalue(res, 0, 0), nullptr, 10);
+        PQclear(res);
+        return id;
     }
 
     jdoc select(std::string sql)  {
@@ -254,6 +688,14 @@ public:
     }
 
 private:
+    // pipeline mode: send a parameterless command (extended protocol); its result comes at the sync
+    bool queue_(const char* sql) {
+        if (PQsendQueryParams(conn_, sql, 0, nullptr, nullptr, nullptr, nullptr, 0) != 1)
+            THROW(std::string("Postgres pipeline send failed: ") + PQerrorMessage(conn_));
+        ++pipe_.queued;
+        return true;
+    }
+
     bool execSQL(const char* sql) {
         if (!conn_) THROW("exec_simple_: not connected");
         PGresult* res = PQexec(conn_, sql);
@@ -280,7 +722,52 @@ private:
         return true;
     }
 
+    // evicted statements are released on the server; failures (e.g. aborted TX) are ignored
+    void deallocate_(PgStmtCache::Entry& e) {
+        if (!conn_ || !e.handle.ready || deallocAll_) return;
+        std::string sql = "DEALLOCATE \"" + e.handle.name + "\";";
+        if (pipe_.on) { // no simple queries inside a pipeline
+            dealloc_later_.push_back(std::move(sql));
+            return;
+        }
+        PQclear(PQexec(conn_, sql.c_str()));
+    }
+
+    // all results were collected; back to synchronous mode
+    // After a failure with queued PREPAREs the server's set of statements is unknown: the cache is
+    // dropped, live statements are invalidated (generation) and the server side is reset with
+    // DEALLOCATE ALL - right away, or after ROLLBACK when the failure aborted a transaction.
+    void leave_pipeline_(bool failed) {
+        PQexitPipelineMode(conn_);
+        const bool dropCache = failed && pipe_.prepared > 0; // a queued PREPARE may not exist server-side
+        pipe_ = {};
+        if (dropCache) {
+            dealloc_later_.clear();
+            deallocAll_ = true; // no per-entry DEALLOCATE from clear()
+            stmts_.clear();
+            ++gen_;
+            deallocate_all_();
+            return;
+        }
+        for (const auto& sql : dealloc_later_) PQclear(PQexec(conn_, sql.c_str()));
+        dealloc_later_.clear();
+    }
+
+    // pending DEALLOCATE ALL, once the connection is outside any (aborted) transaction
+    void deallocate_all_() {
+        if (!deallocAll_ || !conn_ || pipe_.on || PQtransactionStatus(conn_) != PQTRANS_IDLE) return;
+        PQclear(PQexec(conn_, "DEALLOCATE ALL;"));
+        deallocAll_ = false;
+    }
+
     PGconn* conn_ = nullptr;
+    PGcancel* cancel_ = nullptr; // used from other threads, guarded by cancel_mx_
+    std::mutex cancel_mx_;
+    PgPipeline pipe_;
+    std::vector<std::string> dealloc_later_;
+    uint64_t gen_ = 0;        // bumped whenever the statement names held by live statements go stale
+    bool deallocAll_ = false; // DEALLOCATE ALL still owed to the server
+    PgStmtCache stmts_ { 64, [this](PgStmtCache::Entry& e) { deallocate_(e); } };
 };
 
 #if HAVE_POSTGRESQL
@@ -1,46 +1,71 @@
 
 #include "sqlconnection.hpp"
+#include "stmtcache.hpp"
+#include "sqlite_profile.hpp"
 #include <sqlite3.h>
 #include <stdexcept>
+#include <mutex>
+#include <vector>
 #include <iostream>
 #include <lib.hpp>
 
+// compiled statements, by SQL text; handle = sqlite3_stmt*
+using SQLiteStmtCache = StmtCache<sqlite3_stmt*>;
+
 class SQLiteStatement final : public SQLStatement {
 public:
+    // uncached: owns the statement, finalized on destruction
     explicit SQLiteStatement(sqlite3_stmt* stmt)
-        : stmt_(stmt) { }
+        : stmt_(stmt)
+        , owned_(sqlite3_bind_parameter_count(stmt)) { }
+    // cached lease: the statement goes back to the connection cache reset and unbound
+    explicit SQLiteStatement(SQLiteStmtCache::PEntry cached)
+        : stmt_(cached->handle), cached_(std::move(cached))
+        , owned_(sqlite3_bind_parameter_count(stmt_)) { }
+
     ~SQLiteStatement() override {
-        if (stmt_) sqlite3_finalize(stmt_);
+        if (!stmt_) return;
+        if (cached_) {
+            if (cached_->handle) { // not dropped by disconnect()
+                sqlite3_reset(stmt_);
+                sqlite3_clear_bindings(stmt_);
+            }
+        } else {
+            sqlite3_finalize(stmt_);
+        }
     }
 
+    // owned text (dumped JSON): kept in the slot until exec() releases the bindings.
+    // owned_ is sized once at construction, so a later bind never moves an earlier slot.
     void set_text(int idx, str value) override {
-        //handle unicode string UTF-8
-        sqlite3_bind_text(stmt_, idx, value.c_str(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
-        //the below function can handle UTF_16
-        //sqlite3_bind_text64(stmt_, idx, s.c_str(), static_cast<int>(s.size()), SQLITE_TRANSIENT, SQLITE_UTF8);
+        if (idx < 1 || static_cast<size_t>(idx) > owned_.size()) THROW("set_text: parameter index out of range");
+        owned_[idx-1] = std::move(value);
+        sqlite3_bind_text64(stmt_, idx, owned_[idx-1].data(), owned_[idx-1].size(), SQLITE_STATIC, SQLITE_UTF8);
+    }
+
+    // zero-copy: SQLite reads the JSON string in place during step
+    void set_ref(int idx, const jval& value) {
+        sqlite3_bind_text64(stmt_, idx, value.GetString(), value.GetStringLength(), SQLITE_STATIC, SQLITE_UTF8);
+    }
+
+    void set_blob(int idx, const jval& value) {
+        sqlite3_bind_blob64(stmt_, idx, value.GetString(), value.GetStringLength(), SQLITE_STATIC);
     }
 
     void set_null(int idx) override {
         sqlite3_bind_null(stmt_, idx);
     }
 
+    // Text and blobs are bound SQLITE_STATIC straight from @p value: it must stay alive until
+    // exec() returns. exec() clears the bindings, so no pointer outlives the step.
     void bind(int idx, const jval& value, const PropType& type) override {
 
-        // // Helper to bind BLOB
-        // auto bind_blob = [&](const void* data, size_t len) {
-        //     (SQLITE_VERSION_NUMBER >= 3007015) ?
-        //         sqlite3_bind_blob64(stmt_, idx, data, static_cast<sqlite3_uint64>(len), SQLITE_TRANSIENT) :
-        //         sqlite3_bind_blob(stmt_, idx, data, static_cast<int>(len), SQLITE_TRANSIENT);
-        // };
-        /************** HELPERS FUNCTIONS ***************************/
-
-
         // Null maps to NULL for every type
         if (value.IsNull()) { set_null(idx); return; }
 
         switch (type) {
-            case PropType::String: { if(value.IsString()) {set_text(idx, value.GetString()); return;}
-                THROW("bind: expected string"); return;
+            case PropType::String: { if(value.IsString()) {set_ref(idx, value); return;}
+                THROW_INVALID("bind: expected string"); return;
             }break;
             case PropType::Integer:
             case PropType::Number : {
@@ -50,39 +75,57 @@ public:
                 if (value.IsUint64()) {sqlite3_bind_int64 (stmt_, idx, value.GetUint64()); return; }
                 if (value.IsFloat ()) {sqlite3_bind_double(stmt_, idx, value.GetDouble()); return; }
                 if (value.IsDouble()) {sqlite3_bind_double(stmt_, idx, value.GetDouble()); return; }
-                THROW("bind: expected integer or number");
+                THROW_INVALID("bind: expected integer or number");
             }; break;
             case PropType::Bool: {
                 if (value.IsBool()){set_bool(idx, value.GetBool() ); return;}
                 if (value.IsInt ()){set_bool(idx, value.GetInt() != 0);return;}
-                THROW("bind: expected boolean");
+                THROW_INVALID("bind: expected boolean");
             }; break;
             case PropType::Date:
             case PropType::Time:
             case PropType::Dt_Time:
             case PropType::Tm_Stamp: {
-                if (!value.IsString()) {str v =value.GetString(); set_datetime(idx, v); return;}
-                THROW("bind: expected ISO-8601 string for date/time");
+                if (value.IsString()) {set_ref(idx, value); return;}
+                THROW_INVALID("bind: expected ISO-8601 string for date/time");
             };break;
             case PropType::Json: {
                 if (value.IsObject()) {set_text(idx, jhlp::dump(value)); return;}
                 if (value.IsArray() ) {set_text(idx, jhlp::dump(value)); return;}
-                if (value.IsString()) {set_text(idx, value.GetString()); return;}
-                THROW("bind: expected JSON object JSON array or string");
+                if (value.IsString()) {set_ref(idx, value); return;}
+                THROW_INVALID("bind: expected JSON object JSON array or string");
             }break;
             case PropType::Bin: {
-                if (value.IsString()) {set_text(idx, value.GetString()); return;}
-                THROW("bind: expected binary as yEnc string");
+                if (value.IsString()) {set_blob(idx, value); return;}
+                THROW_INVALID("bind: expected binary as yEnc string");
             }
         }
     }
 
+    // Step once, then reset and clear the bindings (they may point into the caller's JSON)
+    // so the same statement can be re-bound for the next row.
     int exec() override {
         int rc = sqlite3_step(stmt_);
         if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
-            THROW("SQLite exec failed");
+            std::string err = sqlite3_errmsg(sqlite3_db_handle(stmt_));
+            release_();
+            THROW("SQLite exec failed: " + err);
         }
-        return sqlite3_changes(sqlite3_db_handle(stmt_));
+        int rows = sqlite3_changes(sqlite3_db_handle(stmt_));
+        release_();
+        return rows;
+    }
+
+    int64_t query_int() override {
+        int rc = sqlite3_step(stmt_);
+        if (rc != SQLITE_ROW) {
+            std::string err = rc == SQLITE_DONE ? "no row" : sqlite3_errmsg(sqlite3_db_handle(stmt_));
+            release_();
+            THROW("SQLite query failed: " + err);
+        }
+        const int64_t v = sqlite3_column_int64(stmt_, 0);
+        release_();
+        return v;
     }
 
     // execute with returning
@@ -92,27 +135,57 @@ public:
 
 
 private:
+    void release_() {
+        sqlite3_reset(stmt_);
+        sqlite3_clear_bindings(stmt_);
+    }
+
     sqlite3_stmt* stmt_;
+    SQLiteStmtCache::PEntry cached_; // null when the statement is not cached
+    std::vector<str> owned_;         // backing for set_text(), one slot per parameter; reused across rows
 };
 
 class SQLiteConnection final : public SQLConnection {
 public:
+    // readonly: SQLITE_OPEN_READONLY reader (the DB must exist; use WAL so it never blocks the writer)
+    explicit SQLiteConnection(bool readonly = false, SqliteProfile profile = SqliteProfile::defaults())
+        : readonly_(readonly)
+        , profile_(std::move(profile)) { }
     ~SQLiteConnection() override { disconnect(); }
 
     void connect(const std::string& dsn) override {
         disconnect();
-        if (sqlite3_open(dsn.c_str(), &db_) != SQLITE_OK) {
-            THROW("Failed to open SQLite DB: " + dsn);
+        const int flags = readonly_ ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+        if (sqlite3_open_v2(dsn.c_str(), &db_, flags, nullptr) != SQLITE_OK) {
+            std::string err = db_ ? sqlite3_errmsg(db_) : "out of memory";
+            disconnect();
+            THROW("Failed to open SQLite DB: " + dsn + " - " + err);
+        }
+        try {
+            apply_profile_();
+        } catch (...) {
+            disconnect();
+            throw;
         }
     }
 
     void disconnect() override {
+        stmts_.clear(); // finalize before close
         if (db_) {
+            std::lock_guard<std::mutex> lk(cancel_mx_);
             sqlite3_close(db_);
             db_ = nullptr;
         }
     }
 
+    bool healthy() override { return db_ != nullptr && sqlite3_get_autocommit(db_) != 0; }
+
+    // sqlite3_interrupt: the running step returns SQLITE_INTERRUPT
+    void cancel() override {
+        std::lock_guard<std::mutex> lk(cancel_mx_);
+        if (db_) sqlite3_interrupt(db_);
+    }
+
     // transaction control
     bool begin() override {
         try {
@@ -141,13 +214,29 @@ public:
     }
 
     std::unique_ptr<SQLStatement> prepare(const std::string& sql, int numParams/*=-1*/) override {
+        if (!db_) THROW("prepare: not connected");
+        //param numParams ignored
+        auto cached = stmts_.find(sql);
+        if (cached && cached.use_count() == 2) { // idle: held only by the cache and by us
+            return std::make_unique<SQLiteStatement>(std::move(cached));
+        }
         sqlite3_stmt* stmt = nullptr;
         // int nBytes = sql.size()+1; // (the number of chars where 1 char = 1 byte) + 1 null_terminator
-        //param numParams ignored
         if (sqlite3_prepare_v2(db_, sql.c_str(), sql.size()+1, &stmt, nullptr) != SQLITE_OK) {
-            THROW("SQLite prepare failed: " + sql);
+            THROW("SQLite prepare failed: " + sql + " - " + sqlite3_errmsg(db_));
         }
-        return std::make_unique<SQLiteStatement>(stmt);
+        // same SQL already leased on this connection: hand out a private statement
+        if (cached) return std::make_unique<SQLiteStatement>(stmt);
+        return std::make_unique<SQLiteStatement>(stmts_.put(sql, stmt));
+    }
+
+    void stmt_cache_size(std::size_t n) override { stmts_.capacity(n); }
+
+    // compile-time SQLITE_MAX_VARIABLE_NUMBER, or lower when set by sqlite3_limit()
+    std::size_t max_params() override {
+        if (!db_) return 0;
+        const int n = sqlite3_limit(db_, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+        return n > 0 ? static_cast<std::size_t>(n) : 0;
     }
 
     int64_t nextValue(std::string name) override {
@@ -156,6 +245,21 @@ public:
 
 
 private:
+    // busy_timeout first: the journal_mode switch itself may have to wait for a lock
+    void apply_profile_() {
+        const SqliteProfile& p = profile_;
+        if (p.busy_timeout_ms >= 0) sqlite3_busy_timeout(db_, p.busy_timeout_ms);
+        std::string sql;
+        if (!readonly_ && !p.journal_mode.empty()) sql += "PRAGMA journal_mode=" + p.journal_mode + ";";
+        if (!p.synchronous.empty())               sql += "PRAGMA synchronous=" + p.synchronous + ";";
+        if (p.mmap_size >= 0)                     sql += "PRAGMA mmap_size=" + std::to_string(p.mmap_size) + ";";
+        if (p.cache_size != 0)                    sql += "PRAGMA cache_size=" + std::to_string(p.cache_size) + ";";
+        if (!p.temp_store.empty())                sql += "PRAGMA temp_store=" + p.temp_store + ";";
+        if (!readonly_ && p.wal_autocheckpoint >= 0)
+            sql += "PRAGMA wal_autocheckpoint=" + std::to_string(p.wal_autocheckpoint) + ";";
+        if (!sql.empty()) execSQL(sql.c_str());
+    }
+
     bool execSQL(const char* sql) {
         char* errmsg = nullptr;
         if (sqlite3_exec(db_, sql, nullptr, nullptr, &errmsg) != SQLITE_OK) {
@@ -167,8 +271,63 @@ private:
     }
 
     sqlite3* db_ = nullptr;
+    std::mutex cancel_mx_; // cancel() vs close
+    bool readonly_;
+    SqliteProfile profile_;
+    SQLiteStmtCache stmts_ { 64, [](SQLiteStmtCache::Entry& e) { sqlite3_finalize(e.handle); } };
 };
 
 PSQLConnection make_sqlite_connection() {
     return std::make_unique<SQLiteConnection>();
-}
\ No newline at end of file
+}
+
+PSQLConnection make_sqlite_reader_connection() {
+    return std::make_unique<SQLiteConnection>(/*readonly*/ true);
+}
+PSQLConnection make_sqlite_connection(const SqliteProfile& profile, bool readonly) {
+    return std::make_unique<SQLiteConnection>(readonly, profile);
+}
+
+/*=============================  SqliteCheckpointer  =============================*/
+SqliteCheckpointer::SqliteCheckpointer(std::string path, std::chrono::milliseconds interval)
+    : path_(std::move(path))
+    , interval_(interval) {
+    if (interval_.count() <= 0) THROW("SqliteCheckpointer: interval must be > 0");
+    if (sqlite3_open_v2(path_.c_str(), &db_, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+        std::string err = db_ ? sqlite3_errmsg(db_) : "out of memory";
+        sqlite3_close(db_);
+        db_ = nullptr;
+        THROW("SqliteCheckpointer: cannot open " + path_ + " - " + err);
+    }
+    // a connection only attaches to the WAL once it has read the database
+    sqlite3_exec(db_, "SELECT count(*) FROM sqlite_master;", nullptr, nullptr, nullptr);
+    thread_ = std::thread([this] { run_(); });
+}
+
+SqliteCheckpointer::~SqliteCheckpointer() {
+    stop();
+    sqlite3_close(db_);
+}
+
+void SqliteCheckpointer::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void SqliteCheckpointer::run_() {
+    std::unique_lock<std::mutex> lk(mx_);
+    while (!cv_.wait_for(lk, interval_, [this] { return stop_; })) {
+        lk.unlock();
+        int log = 0, ckpt = 0;
+        // PASSIVE: copies what it can without waiting on readers/writers; SQLITE_BUSY just means "later"
+        if (sqlite3_wal_checkpoint_v2(db_, nullptr, SQLITE_CHECKPOINT_PASSIVE, &log, &ckpt) == SQLITE_OK) {
+            checkpoints_.fetch_add(1, std::memory_order_relaxed);
+            frames_.store(ckpt > 0 ? static_cast<uint64_t>(ckpt) : 0, std::memory_order_relaxed);
+        }
+        lk.lock();
+    }
+}
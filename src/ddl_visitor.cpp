@@ -22,11 +22,33 @@ std::string DDLVisitor::sql_default(const OrmProp& f) {
     return "";
 }
 
+std::string DDLVisitor::index_ddl(const std::string& table, const std::string& name, bool unique,
+    const std::vector<std::string>& fields) {
+    std::string cols, idx = name;
+    for (size_t j = 0; j < fields.size(); ++j) cols += (j ? ", " : "") + fields[j];
+    if (idx.empty()) { // the name Postgres would pick: <table>_<fields>_idx
+        idx = table;
+        for (const auto& f : fields) idx += "_" + f;
+        idx += "_idx";
+    }
+    return std::string("CREATE ") + (unique ? "UNIQUE " : "") + "INDEX IF NOT EXISTS " + idx + " ON " + table + " (" + cols + ");";
+}
+
+std::vector<std::string> DDLVisitor::split(const std::string& script) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    for (size_t end; (end = script.find(";\n", start)) != std::string::npos; start = end + 2) {
+        out.push_back(script.substr(start, end + 1 - start));
+    }
+    if (script.find_first_not_of(" \n", start) != std::string::npos) out.push_back(script.substr(start));
+    return out;
+}
+
 /* ---------- PostgreSQL ---------- */
 
 std::string PgDDLVisitor::sql_type(const OrmProp& f) {
     if (f.type == PropType::String   ) return "TEXT"                    ;
-    if (f.type == PropType::Integer  ) return "INTEGER"                 ;
+    if (f.type == PropType::Integer  ) return f.is_id ? "BIGINT" : "INTEGER"; // generated ids are int64
     if (f.type == PropType::Number   ) return "NUMERIC"                 ;
     if (f.type == PropType::Bool     ) return "BOOLEAN"                 ;
     if (f.type == PropType::Json     ) return "JSON"                    ;
@@ -70,31 +92,13 @@ std::string PgDDLVisitor::visit(const OrmSchema& schema) {
     // Per-field indexes
     for (const auto& kv : schema.fields) {
         const OrmProp& f = kv.second;
-        if (f.is_indexed && !f.is_id) {
-            ddl << "\nCREATE ";
-            if (f.is_unique) ddl << "UNIQUE ";
-            ddl << "INDEX ";
-            if (!f.index_name.empty()) ddl << f.index_name << " ";
-            ddl << "ON " << schema.name << " (" << f.name << ");";
-        }
+        if (f.is_indexed && !f.is_id) ddl << "\n" << index_ddl(schema.name, f.index_name, f.is_unique, { f.name });
     }
 
     // Schema-level composite indexes
-    for (const auto& idx : schema.indexes) {
-        ddl << "\nCREATE ";
-        if (idx.unique) ddl << "UNIQUE ";
-        ddl << "INDEX ";
-        if (!idx.index_name.empty()) ddl << idx.index_name << " ";
-        ddl << "ON " << schema.name << " (";
-        for (size_t j = 0; j < idx.fields.size(); ++j) {
-            ddl << idx.fields[j];
-            if (j + 1 < idx.fields.size()) ddl << ", ";
-        }
-        ddl << ");";
-    }
+    for (const auto& idx : schema.indexes) ddl << "\n" << index_ddl(schema.name, idx.index_name, idx.unique, idx.fields);
 
     ddl << std::endl;
-    std::cout << "PgDDLVisitor::visit(): " << ddl.str();
     return ddl.str();
 }
 
@@ -146,31 +150,13 @@ std::string SqliteDDLVisitor::visit(const OrmSchema& schema) {
     // Per-field indexes
     for (const auto& kv : schema.fields) {
         const OrmProp& f = kv.second;
-        if (f.is_indexed && !f.is_id) {
-            ddl << "\nCREATE ";
-            if (f.is_unique) ddl << "UNIQUE ";
-            ddl << "INDEX ";
-            if (!f.index_name.empty()) ddl << f.index_name << " ";
-            ddl << "ON " << schema.name << " (" << f.name << ");";
-        }
+        if (f.is_indexed && !f.is_id) ddl << "\n" << index_ddl(schema.name, f.index_name, f.is_unique, { f.name });
     }
 
     // Schema-level composite indexes
-    for (const auto& idx : schema.indexes) {
-        ddl << "\nCREATE ";
-        if (idx.unique) ddl << "UNIQUE ";
-        ddl << "INDEX ";
-        if (!idx.index_name.empty()) ddl << idx.index_name << " ";
-        ddl << "ON " << schema.name << " (";
-        for (size_t j = 0; j < idx.fields.size(); ++j) {
-            ddl << idx.fields[j];
-            if (j + 1 < idx.fields.size()) ddl << ", ";
-        }
-        ddl << ");";
-    }
+    for (const auto& idx : schema.indexes) ddl << "\n" << index_ddl(schema.name, idx.index_name, idx.unique, idx.fields);
 
     ddl << std::endl;
-    std::cout << "SqliteDDLVisitor::visit(): " << ddl.str();
     return ddl.str();
 }
 
@@ -1,5 +1,9 @@
 #include "dml_visitor.hpp"
+#include <cstring>
+#include <functional>
+#include <mutex>
 #include <sstream>
+#include <string_view>
 #include "lib.hpp"
 
 
@@ -13,6 +17,191 @@ namespace {
         }
         return os.str();
     }
+
+    // @p obj has exactly @p keys, in order
+    bool same_keys(const std::vector<std::string>& keys, const jval& obj) {
+        if (obj.MemberCount() != keys.size()) return false;
+        jit m = obj.MemberBegin();
+        for (const std::string& k : keys) {
+            if (m->name.GetStringLength() != k.size() || std::memcmp(m->name.GetString(), k.data(), k.size()) != 0) return false;
+            ++m;
+        }
+        return true;
+    }
+}
+
+/* ---- cached SQL ---- */
+size_t DMLVisitor::SqlKeyHash::operator()(const SqlKey& k) const {
+    size_t h = k.schema;
+    auto mix = [&h](uint64_t v) { h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+    mix(static_cast<uint64_t>(k.version));
+    mix(k.shape);
+    mix(static_cast<uint64_t>(k.op));
+    mix(k.rows);
+    return h;
+}
+
+std::shared_ptr<const DmlSql> DMLVisitor::sql(DmlOp op, OrmSchema& s, const jval& obj, size_t rows) const {
+    const bool keyed = op != DmlOp::Remove; // DELETE by PK: one statement per schema
+    const SqlKey key { std::hash<std::string_view> {}(s.name), s.version, keyed ? BindPlan::fingerprint(obj) : 0, op,
+        rows };
+    auto hit = [&](const std::vector<std::shared_ptr<const DmlSql>>& bucket) -> std::shared_ptr<const DmlSql> {
+        for (const auto& e : bucket) {
+            if (e->schema == s.name && (!keyed || same_keys(e->keys, obj))) return e;
+        }
+        return nullptr;
+    };
+    {
+        std::shared_lock lk(sql_mx_);
+        auto it = sql_.find(key);
+        if (it != sql_.end()) {
+            if (auto e = hit(it->second)) return e;
+        }
+    }
+
+    auto e = std::make_shared<DmlSql>();
+    dml_pair gen;
+    switch (op) {
+        case DmlOp::Insert:      gen = insert(s, obj); break;
+        case DmlOp::Upsert:      gen = upsert(s, obj); break;
+        case DmlOp::Update:      gen = update(s, obj); break;
+        case DmlOp::Remove:      gen = remove(s, obj); break;
+        case DmlOp::InsertBatch: gen = insert_batch(s, obj, rows); break;
+        case DmlOp::UpsertBatch: gen = upsert_batch(s, obj, rows); break;
+    }
+    e->sql = std::move(gen.first);
+    e->params = gen.second;
+    e->schema = s.name;
+    if (keyed) {
+        e->keys.reserve(obj.MemberCount());
+        for (jit m = obj.MemberBegin(); m != obj.MemberEnd(); ++m) e->keys.emplace_back(m->name.GetString(), m->name.GetStringLength());
+    }
+
+    std::unique_lock lk(sql_mx_);
+    auto& bucket = sql_[key];
+    if (auto prev = hit(bucket)) return prev; // generated meanwhile by another thread
+    if (sql_count_ >= kMaxSql) {
+        sql_.clear();
+        sql_count_ = 0;
+        sql_[key].push_back(e);
+    } else {
+        bucket.push_back(e);
+    }
+    ++sql_count_;
+    return e;
+}
+
+void DMLVisitor::invalidate(const std::string& schema) const {
+    std::unique_lock lk(sql_mx_);
+    for (auto it = sql_.begin(); it != sql_.end();) {
+        auto& bucket = it->second;
+        const size_t before = bucket.size();
+        std::erase_if(bucket, [&](const std::shared_ptr<const DmlSql>& e) { return e->schema == schema; });
+        sql_count_ -= before - bucket.size();
+        it = bucket.empty() ? sql_.erase(it) : std::next(it);
+    }
+}
+
+void DMLVisitor::invalidate(const std::string& schema, int version) const {
+    std::unique_lock lk(sql_mx_);
+    for (auto it = sql_.begin(); it != sql_.end();) {
+        auto& bucket = it->second;
+        if (it->first.version != version) {
+            ++it;
+            continue;
+        }
+        const size_t before = bucket.size();
+        std::erase_if(bucket, [&](const std::shared_ptr<const DmlSql>& e) { return e->schema == schema; });
+        sql_count_ -= before - bucket.size();
+        it = bucket.empty() ? sql_.erase(it) : std::next(it);
+    }
+}
+
+void DMLVisitor::invalidate_all() const {
+    std::unique_lock lk(sql_mx_);
+    sql_.clear();
+    sql_count_ = 0;
+}
+
+size_t DMLVisitor::cached_sql() const {
+    std::shared_lock lk(sql_mx_);
+    return sql_count_;
+}
+
+/* ---- batches (shared by both dialects, placeholders via ph()) ---- */
+size_t DMLVisitor::batch_rows(size_t cols, size_t wanted, size_t limit) const {
+    if (wanted == 0) wanted = 1;
+    if (cols == 0) return wanted;
+    size_t cap = (limit ? limit : max_params()) / cols;
+    if (cap == 0) THROW("batch: %zu columns exceed the parameter limit", cols);
+    return wanted < cap ? wanted : cap;
+}
+
+dml_pair DMLVisitor::insert_batch(const OrmSchema& s, const jval& value, size_t rows) const {
+    std::shared_ptr<OrmProp> pk = s.idprop();
+
+    const jval& obj = jhlp::first_obj(value);
+    if (rows == 0) THROW("insert_batch: no rows");
+
+    std::vector<std::string> names;
+    for (jit it = obj.MemberBegin(); it != obj.MemberEnd(); ++it) {
+        auto fit = s.fields.find(it->name.GetString());
+        if (fit == s.fields.end()) continue;             // ignore unknown keys
+        if (fit->second.name == pk->name) continue;      // PK goes last
+        names.push_back(fit->second.name);
+    }
+    names.push_back(pk->name);
+
+    const size_t cols = names.size();
+    std::ostringstream sql;
+    sql << "INSERT INTO " << s.name << " (" << join(names, ", ") << ") VALUES ";
+    size_t i = 0;
+    for (size_t r = 0; r < rows; ++r) {
+        if (r) sql << ", ";
+        sql << "(";
+        for (size_t c = 0; c < cols; ++c) {
+            if (c) sql << ", ";
+            sql << ph(++i);
+        }
+        sql << ")";
+    }
+    sql << ";";
+    return std::make_pair<str, int>(sql.str(), static_cast<int>(i));
+}
+
+dml_pair DMLVisitor::upsert_batch(const OrmSchema& s, const jval& value, size_t rows) const {
+    std::shared_ptr<OrmProp> pk = s.idprop();
+
+    const jval& obj = jhlp::first_obj(value);
+    if (rows == 0) THROW("upsert_batch: no rows");
+
+    std::vector<std::string> names, sets;
+    for (jit it = obj.MemberBegin(); it != obj.MemberEnd(); ++it) {
+        auto fit = s.fields.find(it->name.GetString());
+        if (fit == s.fields.end()) continue;
+        const auto& f = fit->second;
+        names.push_back(f.name);
+        if (f.name != pk->name) sets.push_back(f.name + std::string(" = excluded.") + f.name);
+    }
+    if (names.empty()) THROW("upsert_batch: no fields present in JSON");
+
+    const size_t cols = names.size();
+    std::ostringstream sql;
+    sql << "INSERT INTO " << s.name << " (" << join(names, ", ") << ") VALUES ";
+    size_t i = 0;
+    for (size_t r = 0; r < rows; ++r) {
+        if (r) sql << ", ";
+        sql << "(";
+        for (size_t c = 0; c < cols; ++c) {
+            if (c) sql << ", ";
+            sql << ph(++i);
+        }
+        sql << ")";
+    }
+    sql << " ON CONFLICT(" << pk->name << ")";
+    if (sets.empty()) sql << " DO NOTHING;";
+    else sql << " DO UPDATE SET " << join(sets, ", ") << ";";
+    return std::make_pair<str, int>(sql.str(), static_cast<int>(i));
 }
 
 /* ---- helpers ---- */
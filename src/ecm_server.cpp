@@ -0,0 +1,112 @@
+#include "ecm_server.hpp"
+#include <exception>
+#include <stdexcept>
+#include <iterator>
+#include "rapidjson/error/en.h"
+#include "rapidjson/writer.h"
+
+RequestArena::RequestArena(std::size_t chunk)
+    : chunk_(chunk)
+    , alloc_(chunk_.data(), chunk_.size()) {
+    doc_.emplace(&alloc_);
+}
+
+void RequestArena::reset() {
+    doc_.reset(); // values live in alloc_: drop the document before rewinding it
+    alloc_.Clear();
+    doc_.emplace(&alloc_);
+    body_.clear();
+    out_.Clear();
+}
+
+std::string_view EcmRouter::schema_of(std::string_view uri) {
+    constexpr std::string_view prefix = "/ecm/";
+    if (uri.substr(0, prefix.size()) != prefix) return {};
+    uri.remove_prefix(prefix.size());
+    return uri.substr(0, uri.find_first_of("/?"));
+}
+
+const char* EcmRouter::reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        default : return "Unknown";
+    }
+}
+
+int EcmRouter::handle(std::string_view method, std::string_view uri, RequestArena& arena) {
+    const std::string_view name = schema_of(uri);
+    if (name.empty()) return reply_(arena, 404, "error", "expected /ecm/<schema>");
+    const std::string schema(name);
+    if (!storage_.hasSchema(schema)) return reply_(arena, 404, "error", "unknown schema");
+
+    if (method == "GET") {
+        try {
+            const int64_t rows = storage_.count(schema); // reader connection
+            if (rows < 0) return reply_(arena, 500, "error", "no database connection");
+            return reply_(arena, 200, "rows", nullptr, rows);
+        } catch (const std::exception& e) {
+            return reply_(arena, 500, "error", e.what());
+        }
+    }
+    if (method != "POST" && method != "PUT" && method != "DELETE")
+        return reply_(arena, 405, "error", "method not allowed");
+
+    jdoc& doc = arena.doc();
+    doc.Parse(arena.body().data(), arena.body().size());
+    if (doc.HasParseError()) return reply_(arena, 400, "error", json::GetParseError_En(doc.GetParseError()));
+    if (!doc.IsObject() && !doc.IsArray()) return reply_(arena, 400, "error", "JSON must be an object or array of objects");
+
+    try {
+        int rows = 0;
+        if (method == "POST") {
+            rows = storage_.insert(schema, doc, "");
+        } else if (method == "PUT") {
+            rows = storage_.update(schema, doc, "");
+        } else {
+            rows = storage_.del(schema, doc);
+        }
+        return reply_(arena, 200, "rows", nullptr, rows);
+    } catch (const std::invalid_argument& e) { // the request's data, e.g. a missing id
+        return reply_(arena, 400, "error", e.what());
+    } catch (const std::exception& e) {
+        return reply_(arena, 500, "error", e.what());
+    }
+}
+
+int EcmRouter::handle(std::string_view method, std::string_view uri, std::istream& body, RequestArena& arena) {
+    if (method != "POST") {
+        arena.body().assign(std::istreambuf_iterator<char>(body), std::istreambuf_iterator<char>());
+        return handle(method, uri, arena);
+    }
+    const std::string_view name = schema_of(uri);
+    if (name.empty()) return reply_(arena, 404, "error", "expected /ecm/<schema>");
+    const std::string schema(name);
+    if (!storage_.hasSchema(schema)) return reply_(arena, 404, "error", "unknown schema");
+
+    try {
+        const int64_t rows = storage_.insert_stream(schema, body, "");
+        return reply_(arena, 200, "rows", nullptr, rows);
+    } catch (const std::invalid_argument& e) { // invalid JSON / missing id: the transaction is rolled back
+        return reply_(arena, 400, "error", e.what());
+    } catch (const std::exception& e) {
+        return reply_(arena, 500, "error", e.what());
+    }
+}
+
+int EcmRouter::reply_(RequestArena& arena, int status, const char* key, const char* error, int64_t rows) {
+    json::Writer<json::StringBuffer> w(arena.out());
+    w.StartObject();
+    w.Key(key);
+    if (error) {
+        w.String(error);
+    } else {
+        w.Int64(rows);
+    }
+    w.EndObject();
+    return status;
+}
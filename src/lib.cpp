@@ -1,12 +1,7 @@
 #include "lib.hpp"
 
-// A safe and modern C++ variadic function for throwing exceptions.
-// It now includes the file and line number of the call site.
-    void error(const std::string& msg, const char* file, int line, ...) {
-        // va_list is used to iterate through the variable arguments.
-        va_list args;
-        va_start(args, line);
-
+// Formats the printf-style message and prefixes the file and line number of the call site.
+    static std::string format_error(const std::string& msg, const char* file, int line, va_list args) {
         // We use a two-pass approach to safely determine the required buffer size.
         // The first call to vsnprintf with a null buffer and a zero size
         // will return the number of characters that *would have been written*
@@ -27,14 +22,27 @@
         // Second pass: Write the formatted string into the new buffer.
         std::vsnprintf(buffer.data(), buffer.size(), msg.c_str(), args);
 
-        // Clean up the main va_list.
-        va_end(args);
-
         // Use a stringstream to build the final error message with file and line.
         std::stringstream ss;
         ss << file << ":" << line << ": " << buffer.data();
+        return ss.str();
+    }
+
+// A safe and modern C++ variadic function for throwing exceptions.
+// It now includes the file and line number of the call site.
+    void error(const std::string& msg, const char* file, int line, ...) {
+        va_list args;
+        va_start(args, line);
+        std::string what = format_error(msg, file, line, args);
+        va_end(args);
+        throw std::runtime_error(what);
+    }
 
-        // Throw the exception with the correctly formatted message.
-        throw std::runtime_error(ss.str());
-        return;
+// Same for input the caller sent (bad request data, not a server fault): std::invalid_argument.
+    void invalid(const std::string& msg, const char* file, int line, ...) {
+        va_list args;
+        va_start(args, line);
+        std::string what = format_error(msg, file, line, args);
+        va_end(args);
+        throw std::invalid_argument(what);
     }
@@ -0,0 +1,128 @@
+#include "migration_worker.hpp"
+#include <algorithm>
+#include <iostream>
+#include "ddl_visitor.hpp"
+#include "schemaupdate.hpp"
+#include "lib.hpp"
+
+MigrationWorker::MigrationWorker(SchemaBoss& boss, PSQLConnection conn, Dialect dialect,
+    std::chrono::milliseconds retry_interval, std::optional<OnlineMigration> online)
+    : boss_(boss)
+    , conn_(std::move(conn))
+    , dialect_(dialect)
+    , retry_interval_(retry_interval)
+    , online_(online) {
+    if (!conn_) THROW("MigrationWorker: no connection");
+    if (retry_interval_.count() <= 0) THROW("MigrationWorker: retry interval must be > 0");
+    thread_ = std::thread([this] { run_(); });
+    boss_.set_on_pending([this](const std::string& name) { enqueue(name); });
+    for (const std::string& name : boss_.pending()) enqueue(name); // added before we were attached
+}
+
+MigrationWorker::~MigrationWorker() { stop(); }
+
+void MigrationWorker::stop() {
+    boss_.set_on_pending(nullptr); // get() migrates in-line again
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    idle_cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void MigrationWorker::enqueue(const std::string& name) {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        if (stop_) return;
+        retry_.erase(name);
+        if (std::find(queue_.begin(), queue_.end(), name) != queue_.end()) return;
+        queue_.push_back(name);
+    }
+    cv_.notify_one();
+}
+
+bool MigrationWorker::wait_idle(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lk(mx_);
+    return idle_cv_.wait_for(lk, timeout, [this] { return stop_ || (queue_.empty() && !busy_); });
+}
+
+std::string MigrationWorker::last_error() const {
+    std::lock_guard<std::mutex> lk(err_mx_);
+    return last_error_;
+}
+
+std::vector<std::string> MigrationWorker::plan(const OrmSchema* from, const OrmSchema& to, Dialect dialect) {
+    if (from) return SchemaUpdate(*from, to).plan_migration(dialect == Dialect::Postgres ? "postgres" : "sqlite");
+
+    // first version: the CREATE TABLE (+ indexes) script
+    PgDDLVisitor pg;
+    SqliteDDLVisitor lite;
+    DDLVisitor& ddl = dialect == Dialect::Postgres ? static_cast<DDLVisitor&>(pg) : lite;
+    return DDLVisitor::split(ddl.visit(to));
+}
+
+bool MigrationWorker::step_(const OrmSchema* from, const OrmSchema& to) {
+    const std::string engine = dialect_ == Dialect::Postgres ? "postgres" : "sqlite";
+    try {
+        // SQLite has no ALTER COLUMN: column changes always go through the rebuild, unthrottled
+        // unless online was asked for
+        if (from && (online_ || SchemaUpdate(*from, to).rebuilds(engine))) {
+            OnlineMigration opts;
+            if (online_) opts = *online_;
+            else opts.throttle = std::chrono::milliseconds(0);
+            SchemaUpdate update(*from, to);
+            SchemaUpdate::run(*conn_, update.plan_online(engine, opts), opts);
+            applied_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        const std::vector<std::string> ddl = plan(from, to, dialect_);
+        if (!conn_->begin()) THROW("begin() failed");
+        for (const std::string& sql : ddl) conn_->prepare(sql)->exec();
+        if (!conn_->commit()) THROW("commit() failed");
+        applied_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    } catch (const std::exception& e) {
+        try {
+            conn_->rollback();
+        } catch (const std::exception&) {
+        }
+        const std::string err = to.name + " v" + std::to_string(from ? from->version : -1) + " -> v" + std::to_string(to.version) +
+            ": " + e.what();
+        std::cerr << "MigrationWorker: " << err << std::endl;
+        {
+            std::lock_guard<std::mutex> lk(err_mx_);
+            last_error_ = err;
+        }
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+}
+
+void MigrationWorker::run_() {
+    const SchemaBoss::MigrateFn migrate = [this](const OrmSchema* from, const OrmSchema& to) { return step_(from, to); };
+    std::unique_lock<std::mutex> lk(mx_);
+    while (!stop_) {
+        if (queue_.empty()) {
+            if (retry_.empty()) {
+                cv_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+            } else if (!cv_.wait_for(lk, retry_interval_, [this] { return stop_ || !queue_.empty(); })) {
+                queue_.insert(queue_.end(), retry_.begin(), retry_.end());
+                retry_.clear();
+            }
+            continue;
+        }
+
+        const std::string name = queue_.front();
+        queue_.pop_front();
+        busy_ = true;
+        lk.unlock();
+        // runs under the schema's migration lock; requests keep leasing the current version meanwhile
+        const bool done = boss_.migrate(name, migrate);
+        lk.lock();
+        busy_ = false;
+        if (!done && boss_.has(name)) retry_.insert(name);
+        idle_cv_.notify_all();
+    }
+}
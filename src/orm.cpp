@@ -1,5 +1,7 @@
 #include "orm.hpp"
 #include <algorithm>
+#include <cstring>
+#include <mutex>
 #include <optional>
 #include <functional> // Required for std::reference_wrapper
 #include "lib.hpp"
@@ -109,19 +111,103 @@ bool OrmSchema::from_json( jdoc& doc, OrmSchema& schema) {
 // }
 
 
-const std::shared_ptr<OrmProp> OrmSchema::idprop() const {
+const OrmProp* OrmSchema::pkprop() const {
     for (auto& pair : fields) {
-        if (pair.second.is_id) {
-            // Return a reference to the found object
-            return std::make_shared<OrmProp>(pair.second);
+        if (pair.second.is_id || pair.second.name == "id") return &pair.second;
+    }
+    return nullptr;
+}
+
+const std::shared_ptr<OrmProp> OrmSchema::idprop() const {
+    if (const OrmProp* pk = pkprop()) return std::make_shared<OrmProp>(*pk);
+    THROW("Schema: '%s' have no ID Prop", name.c_str());
+    return nullptr;
+}
+
+uint64_t BindPlan::fingerprint(const jval& obj) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (jit m = obj.MemberBegin(); m != obj.MemberEnd(); ++m) {
+        const char* k = m->name.GetString();
+        for (json::SizeType i = 0, n = m->name.GetStringLength(); i < n; ++i) {
+            h ^= static_cast<unsigned char>(k[i]);
+            h *= 1099511628211ull;
         }
-        if (pair.second.name == "id") {
-            return std::make_shared<OrmProp>(pair.second);
+        h ^= 0xff; // key separator: {"ab"} != {"a","b"}
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool BindPlan::matches(const jval& obj) const {
+    if (obj.MemberCount() != keys.size()) return false;
+    jit m = obj.MemberBegin();
+    for (const std::string& k : keys) {
+        if (m->name.GetStringLength() != k.size() || std::memcmp(m->name.GetString(), k.data(), k.size()) != 0) return false;
+        ++m;
+    }
+    return true;
+}
+
+bool BindPlan::pk_valid(const jval& obj) const {
+    if (pk_col < 0) return false;
+    const jval& v = value(obj, cols[pk_col]);
+    if (pk->type == PropType::Integer || pk->type == PropType::Number) {
+        return v.IsNumber() && v.GetDouble() != 0.0; // 0: generated ids
+    }
+    return v.IsString() && v.GetStringLength() > 0; // strings (UUID, etc.)
+}
+
+std::shared_ptr<const BindPlan> BindPlanCache::get(const OrmSchema& schema, const jval& obj) {
+    const uint64_t shape = BindPlan::fingerprint(obj);
+    {
+        std::shared_lock lk(mx_);
+        auto it = plans_.find(shape);
+        if (it != plans_.end()) {
+            for (const auto& p : it->second) {
+                if (p->matches(obj)) return p;
+            }
         }
     }
-    // Return an empty optional if no ID property is found
-    THROW("Schema: '%s' have no ID Prop", name);
-    return nullptr;
+
+    auto plan = std::make_shared<BindPlan>();
+    plan->shape = shape;
+    plan->pk = schema.pkprop();
+    if (!plan->pk) THROW("Schema: '%s' have no ID Prop", schema.name.c_str());
+    plan->keys.reserve(obj.MemberCount());
+    uint32_t member = 0;
+    for (jit m = obj.MemberBegin(); m != obj.MemberEnd(); ++m, ++member) {
+        plan->keys.emplace_back(m->name.GetString(), m->name.GetStringLength());
+        auto fit = schema.fields.find(plan->keys.back());
+        if (fit == schema.fields.end()) continue; // not a column: never bound
+        if (&fit->second == plan->pk) plan->pk_col = static_cast<int>(plan->cols.size());
+        plan->cols.push_back({ member, &fit->second });
+    }
+
+    std::unique_lock lk(mx_);
+    auto& bucket = plans_[shape];
+    for (const auto& p : bucket) {
+        if (p->matches(obj)) return p; // built meanwhile by another thread
+    }
+    if (count_ >= kMaxPlans) { // many shapes: start over rather than grow
+        plans_.clear();
+        count_ = 0;
+        plans_[shape].push_back(plan);
+    } else {
+        bucket.push_back(plan);
+    }
+    ++count_;
+    return plan;
+}
+
+void BindPlanCache::clear() {
+    std::unique_lock lk(mx_);
+    plans_.clear();
+    count_ = 0;
+}
+
+size_t BindPlanCache::size() const {
+    std::shared_lock lk(mx_);
+    return count_;
 }
 
 
@@ -136,7 +222,7 @@ PropType proptype(std::string type) {
     if (type == "timestamp") return PropType::Tm_Stamp ;
     if (type == "binary"   ) return PropType::Bin      ;
     if (type == "json"     ) return PropType::Json     ;
-    THROW("Invalid type name: %s" , type);
+    THROW("Invalid type name: %s" , type.c_str());
     return PropType::String;
 }
 
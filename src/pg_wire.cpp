@@ -0,0 +1,212 @@
+#include "pg_wire.hpp"
+#include "jsonhlp.hpp"
+#include "lib.hpp"
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+namespace {
+    // INTEGER/int4 -> 4, BIGINT/int8 -> 8, SMALLINT/int2 -> 2; anything else 0
+    int int_width(std::string t) {
+        for (char& c : t) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        if (t == "BIGINT" || t == "INT8" || t == "BIGSERIAL") return 8;
+        if (t == "INTEGER" || t == "INT" || t == "INT4" || t == "SERIAL") return 4;
+        if (t == "SMALLINT" || t == "INT2") return 2;
+        return 0;
+    }
+
+    bool hex_literal(const jval& value) {
+        return value.GetStringLength() >= 2 && value.GetString()[0] == '\\' && value.GetString()[1] == 'x';
+    }
+
+    int hex_digit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    template <class T>
+    void put_number(std::string& buf, T v) {
+        char tmp[32];
+        auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        buf.append(tmp, r.ptr);
+    }
+}
+
+PgCopyEncoder::PgCopyEncoder(const std::vector<CopyColumn>& columns, CopyFormat format)
+    : format_(format), ncols_(static_cast<int>(columns.size())) {
+    if (columns.empty()) THROW("bulk_load: no columns");
+    widths_.reserve(columns.size());
+    for (const auto& c : columns) widths_.push_back(int_width(c.sql_type));
+    if (format_ == CopyFormat::Binary) {
+        static const char sig[] = "PGCOPY\n\377\r\n"; // 11 bytes incl. trailing \0
+        buf_.append(sig, 11);
+        put_i32_(0); // flags
+        put_i32_(0); // header extension length
+    }
+}
+
+void PgCopyEncoder::put(const jval& value, const PropType& type) {
+    if (value.IsNull()) { put_null(); return; }
+    next_field_();
+    if (format_ == CopyFormat::Binary) {
+        size_t at = buf_.size();
+        put_i32_(0); // field length, patched below
+        put_binary_(value, type);
+        uint32_t n = static_cast<uint32_t>(buf_.size() - at - 4);
+        pgwire::put_be(&buf_[at], n, 4);
+    } else {
+        put_text_(value, type);
+    }
+}
+
+void PgCopyEncoder::put_null() {
+    next_field_();
+    if (format_ == CopyFormat::Binary) put_i32_(-1);
+    else buf_ += "\\N";
+}
+
+void PgCopyEncoder::end_row() {
+    if (col_ != ncols_) THROW("bulk_load: row has %d values, expected %d", col_, ncols_);
+    if (format_ == CopyFormat::Text) buf_ += '\n';
+    col_ = 0;
+    ++rows_;
+}
+
+void PgCopyEncoder::finish() {
+    if (col_ != 0) THROW("bulk_load: unterminated row");
+    if (format_ == CopyFormat::Binary) put_i16_(-1); // file trailer
+}
+
+// row header (binary field count) or column delimiter (text)
+void PgCopyEncoder::next_field_() {
+    if (col_ >= ncols_) THROW("bulk_load: too many values in row (%d columns)", ncols_);
+    if (format_ == CopyFormat::Binary) {
+        if (col_ == 0) put_i16_(static_cast<int16_t>(ncols_));
+    } else if (col_ > 0) {
+        buf_ += '\t';
+    }
+    ++col_;
+}
+
+// text COPY: backslash escapes for the delimiter/row separator
+void PgCopyEncoder::put_escaped_(const char* s, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        char c = s[i];
+        switch (c) {
+        case '\\': buf_ += "\\\\"; break;
+        case '\t': buf_ += "\\t"; break;
+        case '\n': buf_ += "\\n"; break;
+        case '\r': buf_ += "\\r"; break;
+        default: buf_ += c;
+        }
+    }
+}
+
+void PgCopyEncoder::put_text_(const jval& value, const PropType& type) {
+    switch (type) {
+    case PropType::Integer:
+    case PropType::Number:
+        if (value.IsInt64()) { put_number(buf_, value.GetInt64()); return; }
+        if (value.IsUint64()) { put_number(buf_, value.GetUint64()); return; }
+        if (value.IsNumber()) { put_number(buf_, value.GetDouble()); return; }
+        THROW("bulk_load: expected integer or number");
+    case PropType::Bool:
+        if (value.IsBool()) { buf_ += value.GetBool() ? 't' : 'f'; return; }
+        if (value.IsInt()) { buf_ += value.GetInt() != 0 ? 't' : 'f'; return; }
+        THROW("bulk_load: expected boolean");
+    case PropType::Json:
+        if (value.IsObject() || value.IsArray()) {
+            std::string j = jhlp::dump(value);
+            put_escaped_(j.data(), j.size());
+            return;
+        }
+        break;
+    case PropType::Bin: {
+        if (!value.IsString()) THROW("bulk_load: expected string for %s", proptype(type).c_str());
+        if (hex_literal(value)) { put_escaped_(value.GetString(), value.GetStringLength()); return; }
+        static const char hex[] = "0123456789abcdef";
+        const auto* p = reinterpret_cast<const unsigned char*>(value.GetString());
+        buf_ += "\\\\x"; // raw bytes -> bytea hex input, backslash escaped for COPY
+        for (size_t i = 0, n = value.GetStringLength(); i < n; ++i) {
+            buf_ += hex[p[i] >> 4];
+            buf_ += hex[p[i] & 0x0F];
+        }
+        return;
+    }
+    default:
+        break;
+    }
+    // string, date/time (ISO-8601), JSON text
+    if (!value.IsString()) THROW("bulk_load: expected string for %s", proptype(type).c_str());
+    put_escaped_(value.GetString(), value.GetStringLength());
+}
+
+// binary COPY: only types whose wire form does not depend on server-side parsing
+void PgCopyEncoder::put_binary_(const jval& value, const PropType& type) {
+    switch (type) {
+    case PropType::Integer: {
+        if (!value.IsInt64()) THROW("bulk_load: expected integer");
+        const int64_t v = value.GetInt64();
+        char out[8];
+        switch (widths_[col_-1]) {
+        case 8:
+            pgwire::int8(out, v);
+            buf_.append(out, 8);
+            return;
+        case 4:
+            if (v < std::numeric_limits<int32_t>::min() || v > std::numeric_limits<int32_t>::max())
+                THROW("bulk_load: integer out of int4 range");
+            pgwire::int4(out, static_cast<int32_t>(v));
+            buf_.append(out, 4);
+            return;
+        case 2:
+            if (v < std::numeric_limits<int16_t>::min() || v > std::numeric_limits<int16_t>::max())
+                THROW("bulk_load: integer out of int2 range");
+            put_i16_(static_cast<int16_t>(v));
+            return;
+        default:
+            THROW("bulk_load: no integer width for column %d, binary COPY needs its SQL type", col_);
+        }
+    }
+    case PropType::Bool:
+        if (value.IsBool()) { buf_ += static_cast<char>(value.GetBool() ? 1 : 0); return; }
+        if (value.IsInt()) { buf_ += static_cast<char>(value.GetInt() != 0 ? 1 : 0); return; }
+        THROW("bulk_load: expected boolean");
+    case PropType::Json:
+        if (value.IsObject() || value.IsArray()) { buf_ += jhlp::dump(value); return; }
+        [[fallthrough]];
+    case PropType::String:
+        if (!value.IsString()) THROW("bulk_load: expected string for %s", proptype(type).c_str());
+        buf_.append(value.GetString(), value.GetStringLength());
+        return;
+    case PropType::Bin: {
+        if (!value.IsString()) THROW("bulk_load: expected string for %s", proptype(type).c_str());
+        if (!hex_literal(value)) { buf_.append(value.GetString(), value.GetStringLength()); return; }
+        const char* p = value.GetString() + 2; // "\x" hex literal -> raw bytes
+        const size_t n = value.GetStringLength() - 2;
+        if (n % 2) THROW("bulk_load: odd number of digits in bytea hex literal");
+        for (size_t i = 0; i < n; i += 2) {
+            const int hi = hex_digit(p[i]), lo = hex_digit(p[i+1]);
+            if (hi < 0 || lo < 0) THROW("bulk_load: invalid bytea hex literal");
+            buf_ += static_cast<char>((hi << 4) | lo);
+        }
+        return;
+    }
+    default:
+        THROW("bulk_load: binary COPY does not support %s columns, use CopyFormat::Text", proptype(type).c_str());
+    }
+}
+
+void PgCopyEncoder::put_i16_(int16_t v) {
+    char out[2];
+    pgwire::put_be(out, static_cast<uint16_t>(v), 2);
+    buf_.append(out, 2);
+}
+
+void PgCopyEncoder::put_i32_(int32_t v) {
+    char out[4];
+    pgwire::int4(out, v);
+    buf_.append(out, 4);
+}
@@ -1,144 +1,245 @@
 #include "schemaboss.hpp"
 #include "lib.hpp"
 
-#define ER_MSG1 "Schema: %schema Version: %d already exists !"
-#define ER_MSG2 "Schema: %schema Version: %d must be greater then the newest version: %d"
+#define ER_MSG1 "Schema: %s Version: %d already exists !"
+#define ER_MSG2 "Schema: %s Version: %d must be greater then the newest version: %d"
+
+SchemaBoss::SchemaBoss()
+    : catalog_(std::make_shared<const ItemMap>()) { }
+
+std::shared_ptr<SchemaBoss::SchemaItem> SchemaBoss::item_(const std::string& name) const {
+    const std::shared_ptr<const ItemMap> snap = catalog_.load(std::memory_order_acquire);
+    auto it = snap->find(name);
+    return it == snap->end() ? nullptr : it->second;
+}
 
 bool SchemaBoss::add(const OrmSchema& schema) {
     if (schema.name.empty()) return false;
 
-    SchemaItem& its = catalog_[schema.name];
+    std::shared_ptr<SchemaItem> item = item_(schema.name);
+    if (!item) { // first version of this name: publish a new name map (copy-on-write)
+        std::lock_guard lk(catalog_mx_);
+        std::shared_ptr<const ItemMap> cur = catalog_.load(std::memory_order_acquire);
+        auto it = cur->find(schema.name);
+        if (it != cur->end()) {
+            item = it->second; // added meanwhile
+        } else {
+            item = std::make_shared<SchemaItem>();
+            item->name = schema.name;
+            auto next = std::make_shared<ItemMap>(*cur);
+            next->emplace(schema.name, item);
+            catalog_.store(std::move(next), std::memory_order_release);
+        }
+    }
+
+    SchemaItem& its = *item;
+    std::unique_lock lk(its.mx);
 
     // must NOT exist already
-    auto it = its.versions.find(schema.version);
-    if (it != its.versions.end()) {
-        THROW(ER_MSG1, schema.name, schema.version);
+    if (its.versions.count(schema.version)) {
+        THROW(ER_MSG1, schema.name.c_str(), schema.version);
     }
 
     // Must be strictly greater than the current newest (if any)
     // the newest can be applied or not
     // obs: as versions its and ordered calling map.rbegin() to get the last item - newest version
     if (!its.versions.empty()) {
-        auto newst =  its.versions.rbegin()->second;
-        if (schema.version <= newst.schema->version) {
-            THROW(ER_MSG2, schema.name, schema.version, newst.schema->version);
+        const int newest = its.versions.rbegin()->first;
+        if (schema.version <= newest) {
+            THROW(ER_MSG2, schema.name.c_str(), schema.version, newest);
         }
     }
 
-    Version v;
-    v.schema        = std::make_shared<OrmSchema>(schema);
-    v.inactive = false;    // fresh version is candidate to become active when applied
-    v.applied  = false;    // added only; will be applied on demand via get()
+    auto v = std::make_shared<Version>();
+    v->schema = std::make_shared<OrmSchema>(schema);
+    // fresh version is candidate to become active when applied; added only, applied on demand via get()
 
-    its.versions.emplace(schema.version, std::move(v)); // add to in-memory
+    its.versions.emplace(schema.version, v); // add to in-memory
     its.newestVersion = schema.version;
+    its.behind.store(true, std::memory_order_release); // next get() migrates
 
     // Optional: persist catalog + version rows now
-    if (persist_on_add_) persist_on_add_(*its.versions.at(schema.version).schema);
+    if (persist_on_add_) persist_on_add_(*v->schema);
+    lk.unlock();
+
+    std::lock_guard plk(pending_mx_);
+    if (on_pending_) on_pending_(schema.name); // background migration starts now
 
     return true; // inserted
 }
 
-std::shared_ptr<OrmSchema> SchemaBoss::get(const std::string& name, const MigrateFn& migrate) {
-    auto ci = catalog_.find(name);
-    if (ci == catalog_.end()) return nullptr;
-    SchemaItem& its = ci->second;
+void SchemaBoss::set_on_pending(PendingFn fn) {
+    std::lock_guard lk(pending_mx_);
+    on_pending_ = std::move(fn);
+    deferred_.store(static_cast<bool>(on_pending_), std::memory_order_release);
+}
 
-    //fast check to avoid processing
-    if (its.lastApplied > 0 && its.lastApplied == its.newestVersion) {
-        if (!its.current) {
-            its.current = get_newest(its.name, true); // retrieve the newest version applied == current
-        }
-        return its.current->schema;
+SchemaBoss::Lease SchemaBoss::get(const std::string& name, const MigrateFn& migrate) {
+    std::shared_ptr<SchemaItem> item = item_(name);
+    if (!item) return {};
+
+    // fast path: already migrated (or migrating in the background) - no lock. Count the lease, then
+    // re-check: a version replaced between the load and the count is handed back and the new current
+    // is loaded instead
+    while (!item->behind.load(std::memory_order_acquire) || deferred_.load(std::memory_order_acquire)) {
+        std::shared_ptr<Version> cur = item->current.load(std::memory_order_acquire);
+        if (!cur) break;
+        cur->in_use.fetch_add(1); // seq_cst: pairs with the inactive store / in_use load in migrate_()
+        if (!cur->inactive.load()) return Lease(this, std::move(cur));
+        release_(cur);
+    }
+
+    // migration path: one migration per schema at a time; later callers find it done.
+    // inactive is only set under this lock, so the count taken here cannot race a replacement
+    std::lock_guard lk(item->mx);
+    std::shared_ptr<Version> v = migrate_(*item, migrate);
+    if (!v) return {};
+    v->in_use.fetch_add(1, std::memory_order_acq_rel);
+    return Lease(this, std::move(v));
+}
+
+bool SchemaBoss::migrate(const std::string& name, const MigrateFn& migrate) {
+    std::shared_ptr<SchemaItem> item = item_(name);
+    if (!item) return false;
+    std::lock_guard lk(item->mx);
+    return migrate_(*item, migrate) != nullptr;
+}
+
+std::shared_ptr<SchemaBoss::Version> SchemaBoss::migrate_(SchemaItem& its, const MigrateFn& migrate) {
+    // retired versions are gone for good (versions only grow): drop their entries
+    std::erase_if(its.versions, [](const auto& kv) { return kv.second->retired.load(std::memory_order_acquire); });
+
+    if (!its.behind.load(std::memory_order_acquire)) {
+        if (std::shared_ptr<Version> cur = its.current.load(std::memory_order_acquire)) return cur;
     }
+    if (its.versions.empty()) return nullptr;
 
-    // If no applied yet: apply the NEWEST one directly.
-    if (its.lastApplied <= 0) {
-        const auto& newest = get_newest(name);
-        if (newest == nullptr) return nullptr;
-        its.newestVersion = newest->schema->version;
+    bool ok = true;
+    std::vector<std::shared_ptr<Version>> replaced; // applied here or before, no longer served
+    if (its.lastApplied < 0) {
+        // If no applied yet: apply the NEWEST one directly.
+        const std::shared_ptr<Version>& newest = its.versions.rbegin()->second;
         if (!newest->applied) {
             // migrate from nullptr -> newest
             if (!migrate(nullptr, *newest->schema)) return nullptr;
             newest->applied = true;
-            // older versions (if any) remain unapplied
-            its.lastApplied = its.newestVersion;
-            its.current = newest;
             //set all, before newest, as inactive=true; as they would never be applied
-            for (auto itv: its.versions ) {
-                if (itv.second.schema->version < newest->schema->version) {
-                    itv.second.inactive = true;
-                }
+            for (auto& itv : its.versions) {
+                if (itv.first < its.newestVersion) itv.second->inactive = true;
             }
             // apply changes to DB;
-            if (persist_on_apply_) persist_on_apply_(*newest->schema, -1);
+            applied_(*newest->schema, -1);
+        }
+        // older versions (if any) remain unapplied
+        its.lastApplied = its.newestVersion;
+    } else {
+        // Advance from current lastApplied to any higher UNAPPLIED versions (ascending)
+        for (auto itv = its.versions.upper_bound(its.lastApplied); itv != its.versions.end(); ++itv) {
+            Version& tgt = *itv->second;
+            if (tgt.applied) { // already applied somehow (e.g., restored)
+                its.lastApplied = itv->first;
+                continue;
+            }
+
+            // from = last applied version (must exist in map at 'lastApplied')
+            auto prev = its.versions.find(its.lastApplied);
+            const OrmSchema* from = prev != its.versions.end() ? prev->second->schema.get() : nullptr;
+
+            if (!migrate(from, *tgt.schema)) {
+                ok = false; // serve what was applied so far; the next get() retries
+                break;
+            }
+
+            // Update flags per spec; the old one becomes inactive once the new one is published
+            if (prev != its.versions.end()) replaced.push_back(prev->second);
+            tgt.applied = true;          // new becomes applied
+            its.lastApplied = itv->first; // now the latest applied
+
+            applied_(*tgt.schema, prev == its.versions.end() ? -1 : prev->first);
         }
-        return newest->schema;
     }
 
-    // Advance from current lastApplied to any higher UNAPPLIED versions (ascending)
-    int current = its.lastApplied;
-    for (auto itv = its.versions.upper_bound(current); itv != its.versions.end(); ++itv) {
-        auto& tgt = itv->second;
-        if (tgt.applied) { // already applied somehow (e.g., restored)
-            current = itv->first;
-            its.lastApplied = current;
-            continue;
+    // publish: new requests get the last applied version from now on
+    auto applied_it = its.versions.find(its.lastApplied);
+    if (applied_it == its.versions.end()) return nullptr;
+    its.current.store(applied_it->second, std::memory_order_release);
+    if (ok) its.behind.store(its.lastApplied != its.newestVersion, std::memory_order_release);
+
+    // replaced versions: no new leases from here on; retire now or when the last lease ends
+    for (const auto& v : replaced) {
+        v->inactive.store(true);
+        if (v->in_use.load() == 0) {
+            retire_(v);
+        } else {
+            std::lock_guard lk(retire_mx_);
+            retiring_.push_back(v);
+            // the last lease may have ended between the check and the push
+            if (v->in_use.load() == 0) {
+                std::erase(retiring_, v);
+                retire_(v);
+            }
         }
+    }
+    return ok ? applied_it->second : nullptr;
+}
 
-        // from = last applied version (must exist in map at 'current')
-        OrmSchema* from = nullptr;
-        auto prev = its.versions.find(current);
-        if (prev != its.versions.end()) from = prev->second.schema.get();
+void SchemaBoss::Lease::release() {
+    if (!v_) return;
+    std::shared_ptr<Version> v = std::move(v_);
+    v_.reset();
+    boss_->release_(v);
+}
 
-        if (!migrate(from, *tgt.schema)) return nullptr;
+void SchemaBoss::release_(const std::shared_ptr<Version>& v) {
+    if (v->in_use.fetch_sub(1) != 1) return;
+    if (!v->inactive.load()) return;
+    {
+        std::lock_guard lk(retire_mx_);
+        std::erase(retiring_, v);
+    }
+    retire_(v);
+}
 
-        // Update flags per spec
-        if (prev != its.versions.end()) prev->second.inactive = true; // old becomes inactive
-        tgt.applied = true;                                           // new becomes applied
-        its.lastApplied = itv->first;                                 // now the latest applied
-        current = its.lastApplied;
+void SchemaBoss::retire_(const std::shared_ptr<Version>& v) {
+    // once only: the last lease and the migration may both see the version unleased
+    if (v->retired.exchange(true, std::memory_order_acq_rel)) return;
+    for (const auto& fn : retire_listeners_) fn(*v->schema);
+}
 
-        if (persist_on_apply_) {
-            int oldV = (prev == its.versions.end()) ? -1 : prev->first;
-            persist_on_apply_(*tgt.schema, oldV);
-        }
+std::vector<std::string> SchemaBoss::pending() const {
+    std::vector<std::string> out;
+    const std::shared_ptr<const ItemMap> snap = catalog_.load(std::memory_order_acquire);
+    for (const auto& [name, item] : *snap) {
+        if (item->behind.load(std::memory_order_acquire)) out.push_back(name);
     }
+    return out;
+}
 
-    // Deliver the last applied to the user
-    auto applied_it = its.versions.find(its.lastApplied);
-    return (applied_it == its.versions.end()) ? nullptr : applied_it->second.schema;
+size_t SchemaBoss::retiring() const {
+    std::lock_guard lk(retire_mx_);
+    return retiring_.size();
 }
 
 std::vector<int> SchemaBoss::unapplied_versions(const std::string& name) const {
     std::vector<int> out;
-    auto ci = catalog_.find(name);
-    if (ci == catalog_.end()) return out;
-    const SchemaItem& its = ci->second;
-    for (const auto& kv : its.versions) {
-        if (!kv.second.applied) out.push_back(kv.first);
+    std::shared_ptr<SchemaItem> item = item_(name);
+    if (!item) return out;
+    std::lock_guard lk(item->mx);
+    for (const auto& kv : item->versions) {
+        if (!kv.second->applied) out.push_back(kv.first);
     }
     return out;
 }
 
 std::shared_ptr<SchemaBoss::Version> SchemaBoss::get_newest(const std::string& name, bool onlyApplied/*=false*/) {
-    auto itc = catalog_.find(name);
-    std::shared_ptr<Version> resp = nullptr;
-    if (itc != catalog_.end()) {
-        SchemaItem its = itc->second;
-        if (its.versions.empty()) return itc->second.current;
-        int v = 0;
-        for (auto itv: its.versions) {
-            Version ver = itv.second;
-            if (v < ver.schema->version) {
-                if (!onlyApplied) { // newest applied or not
-                    resp = std::make_shared<Version>(ver);
-                } else if (ver.schema->applied) { // newest applied version
-                    resp = std::make_shared<Version>(ver);
-                }
-                v = ver.schema->version;
-            }
-        }
-    }
-    return resp;
+    std::shared_ptr<SchemaItem> item = item_(name);
+    if (!item) return nullptr;
+    if (onlyApplied) return item->current.load(std::memory_order_acquire); // newest applied version
+    std::lock_guard lk(item->mx);
+    return item->versions.empty() ? nullptr : item->versions.rbegin()->second; // newest applied or not
+}
+
+void SchemaBoss::applied_(const OrmSchema& applied, int oldV) {
+    if (persist_on_apply_) persist_on_apply_(applied, oldV);
+    for (const auto& fn : apply_listeners_) fn(applied, oldV);
 }
@@ -1,14 +1,58 @@
 #include "schemaupdate.hpp"
 #include "ddl_visitor.hpp"
+#include "sqlconnection.hpp"
+#include "lib.hpp"
+#include <algorithm>
+#include <thread>
 #include <unordered_map>
 #include <set>
 
+namespace {
+    std::string index_sql(const OrmIndex& idx, const std::string& table) {
+        std::string sql = "CREATE ";
+        if (idx.unique) sql += "UNIQUE ";
+        sql += "INDEX ";
+        if (!idx.index_name.empty()) sql += idx.index_name + " ";
+        sql += "ON " + table + " (";
+        for (size_t i = 0; i < idx.fields.size(); ++i) {
+            sql += idx.fields[i];
+            if (i < idx.fields.size() - 1) sql += ", ";
+        }
+        sql += ");";
+        return sql;
+    }
+
+    std::string join(const std::vector<std::string>& xs) {
+        std::string out;
+        for (size_t i = 0; i < xs.size(); ++i) out += (i ? ", " : "") + xs[i];
+        return out;
+    }
+
+    // begin; @p body; commit - or rollback and rethrow
+    template <typename F>
+    void in_tx(SQLConnection& conn, F&& body) {
+        if (!conn.begin()) THROW("begin() failed");
+        try {
+            body();
+            if (!conn.commit()) THROW("commit() failed");
+        } catch (...) {
+            conn.rollback();
+            throw;
+        }
+    }
+}
+
 SchemaUpdate::SchemaUpdate(const OrmSchema& old_schema, const OrmSchema& new_schema)
     : old_schema_(old_schema), new_schema_(new_schema) {}
 
-    std::vector<std::string> SchemaUpdate::plan_migration(const std::string& db_engine) {
+std::vector<std::string> SchemaUpdate::plan_migration(const std::string& db_engine) {
+    return plan_(db_engine, false);
+}
+
+std::vector<std::string> SchemaUpdate::plan_(const std::string& db_engine, bool online) {
 
     std::vector<std::string> ddl_statements;
+    const std::string& table = new_schema_.name;
 
     // Build maps for quick lookup
     std::unordered_map<std::string, OrmProp> old_fields, new_fields;
@@ -28,25 +72,26 @@ SchemaUpdate::SchemaUpdate(const OrmSchema& old_schema, const OrmSchema& new_sch
             if (nf.is_unique) col_sql += " UNIQUE";
             col_sql += v->sql_default(nf);
             delete v;
-            ddl_statements.push_back("ALTER TABLE users ADD COLUMN " + col_sql + ";");
+            ddl_statements.push_back("ALTER TABLE " + table + " ADD COLUMN " + col_sql + ";");
         } else {
             const auto& of = it->second;
+            if (online && nf.type != of.type) continue; // shadow column swap re-applies the rest
             // ALTER COLUMN TYPE
             if (nf.type != of.type) {
-                ddl_statements.push_back("ALTER TABLE users ALTER COLUMN " + nf.name +
+                ddl_statements.push_back("ALTER TABLE " + table + " ALTER COLUMN " + nf.name +
                     " TYPE " + proptype( nf.type ) + ";");
             }
             // ALTER COLUMN DEFAULT
             if (nf.default_value != of.default_value) {
-                ddl_statements.push_back("ALTER TABLE users ALTER COLUMN " + nf.name +
+                ddl_statements.push_back("ALTER TABLE " + table + " ALTER COLUMN " + nf.name +
                     " SET DEFAULT " + (nf.default_value.empty() ? "NULL" : nf.default_value) + ";");
             }
             // ALTER COLUMN NULLABILITY
             if (nf.required != of.required) {
                 if (nf.required)
-                    ddl_statements.push_back("ALTER TABLE users ALTER COLUMN " + nf.name + " SET NOT NULL;");
+                    ddl_statements.push_back("ALTER TABLE " + table + " ALTER COLUMN " + nf.name + " SET NOT NULL;");
                 else
-                    ddl_statements.push_back("ALTER TABLE users ALTER COLUMN " + nf.name + " DROP NOT NULL;");
+                    ddl_statements.push_back("ALTER TABLE " + table + " ALTER COLUMN " + nf.name + " DROP NOT NULL;");
             }
             // ALTER COLUMN UNIQUENESS (this is really an index operation, handle below)
         }
@@ -54,7 +99,7 @@ SchemaUpdate::SchemaUpdate(const OrmSchema& old_schema, const OrmSchema& new_sch
     // DROP columns
     for (const auto& [name, of] : old_fields) {
         if (new_fields.find(name) == new_fields.end()) {
-            ddl_statements.push_back("ALTER TABLE users DROP COLUMN " + of.name + ";");
+            ddl_statements.push_back("ALTER TABLE " + table + " DROP COLUMN " + of.name + ";");
         }
     }
 
@@ -73,17 +118,7 @@ SchemaUpdate::SchemaUpdate(const OrmSchema& old_schema, const OrmSchema& new_sch
     // Add new indexes
     for (const auto& [k, idx] : new_idx_map) {
         if (old_idx_map.find(k) == old_idx_map.end()) {
-            std::string sql = "CREATE ";
-            if (idx.unique) sql += "UNIQUE ";
-            sql += "INDEX ";
-            if (!idx.index_name.empty()) sql += idx.index_name + " ";
-            sql += "ON users (";
-            for (size_t i = 0; i < idx.fields.size(); ++i) {
-                sql += idx.fields[i];
-                if (i < idx.fields.size() - 1) sql += ", ";
-            }
-            sql += ");";
-            ddl_statements.push_back(sql);
+            ddl_statements.push_back(index_sql(idx, table));
         }
     }
     // Drop removed indexes
@@ -92,7 +127,7 @@ SchemaUpdate::SchemaUpdate(const OrmSchema& old_schema, const OrmSchema& new_sch
             // By convention, Postgres: DROP INDEX index_name;
             // In real world, you may need to store old index names
             if (!idx.index_name.empty())
-                ddl_statements.push_back("DROP INDEX " + idx.index_name + ";");
+                ddl_statements.push_back("DROP INDEX IF EXISTS " + idx.index_name + ";"); // may go with a dropped column
         }
     }
 
@@ -101,3 +136,209 @@ SchemaUpdate::SchemaUpdate(const OrmSchema& old_schema, const OrmSchema& new_sch
 
     return ddl_statements;
 }
+
+bool SchemaUpdate::rebuilds(const std::string& db_engine) const {
+    if (db_engine == "postgres") return false;
+    for (const auto& [key, nf] : new_schema_.fields) {
+        auto it = old_schema_.fields.find(key);
+        if (it == old_schema_.fields.end()) continue;
+        const OrmProp& of = it->second;
+        if (nf.type != of.type || nf.default_value != of.default_value || nf.required != of.required) return true;
+    }
+    return false;
+}
+
+std::vector<MigrationStep> SchemaUpdate::plan_online(const std::string& db_engine, const OnlineMigration& opts) {
+    const bool pg = db_engine == "postgres";
+    const std::string& t = new_schema_.name;
+    if (t.empty()) THROW("online migration: schema has no name");
+
+    // columns kept by the new version, and those whose type changes
+    std::vector<const OrmProp*> kept, changed;
+    for (const auto& [key, nf] : new_schema_.fields) {
+        auto it = old_schema_.fields.find(key);
+        if (it == old_schema_.fields.end()) continue;
+        kept.push_back(&nf);
+        if (nf.type != it->second.type) changed.push_back(&nf);
+    }
+    if (changed.empty() && !rebuilds(db_engine)) {
+        MigrationStep all;
+        all.sql = plan_(db_engine, false);
+        if (all.sql.empty()) return {};
+        return { all };
+    }
+
+    const OrmProp* pk = old_schema_.pkprop();
+    if (!pk) THROW("online migration of %s: no primary key to page by", t.c_str());
+    if (pg && new_schema_.fields.count(pk->name) && new_schema_.fields.at(pk->name).type != pk->type) {
+        THROW("online migration of %s: the primary key type cannot change in place", t.c_str());
+    }
+
+    PgDDLVisitor pgv;
+    SqliteDDLVisitor litev;
+    DDLVisitor& ddl = pg ? static_cast<DDLVisitor&>(pgv) : litev;
+    const std::string newt = t + "__new";           // sqlite: rebuilt table
+    const std::string cur = "_ecm_backfill_" + t;  // keyset cursor: lo = last key copied, hi = chunk end
+    const std::string k = t + "." + pk->name;
+    auto cast = [&](const std::string& row, const OrmProp& f) {
+        for (const OrmProp* c : changed) {
+            if (c == &f) return "CAST(" + row + "." + f.name + " AS " + ddl.sql_type(f) + ")";
+        }
+        return row + "." + f.name;
+    };
+
+    MigrationStep setup, chunk, build, check, validate, swap;
+    chunk.kind = MigrationStep::Kind::Backfill;
+    build.kind = MigrationStep::Kind::Concurrent;
+    chunk.counted = 1;
+
+    setup.sql.push_back("CREATE TABLE IF NOT EXISTS " + cur + " (lo " + ddl.sql_type(*pk) + ", hi " + ddl.sql_type(*pk) + ");");
+    setup.sql.push_back("INSERT INTO " + cur + " (lo, hi) SELECT NULL, NULL WHERE NOT EXISTS (SELECT 1 FROM " + cur + ");");
+    // chunk end: the chunk_rows-th key after lo (an index walk), or the last key when fewer are left
+    const std::string after = " FROM " + t + " WHERE " + cur + ".lo IS NULL OR " + k + " > " + cur + ".lo";
+    chunk.sql.push_back("UPDATE " + cur + " SET hi = coalesce((SELECT " + k + after + " ORDER BY " + k + " LIMIT 1 OFFSET " +
+        std::to_string(opts.chunk_rows > 1 ? opts.chunk_rows - 1 : 0) + "), (SELECT max(" + k + ")" + after + "));");
+    const std::string range = cur + ".hi IS NOT NULL AND (" + cur + ".lo IS NULL OR " + k + " > " + cur + ".lo) AND " + k +
+        " <= " + cur + ".hi";
+
+    if (pg) {
+        // shadow columns, filled by the trigger for new writes and by the chunks for existing rows
+        const std::string sync = t + "__shadow_sync";
+        std::string body, sets;
+        for (const OrmProp* c : changed) {
+            setup.sql.push_back("ALTER TABLE " + t + " ADD COLUMN IF NOT EXISTS " + c->name + "__new " + ddl.sql_type(*c) + ";");
+            body += "NEW." + c->name + "__new := " + cast("NEW", *c) + "; ";
+            sets += std::string(sets.empty() ? "" : ", ") + c->name + "__new = " + cast(t, *c);
+        }
+        setup.sql.push_back("CREATE OR REPLACE FUNCTION " + sync + "() RETURNS trigger AS $$ BEGIN " + body +
+            "RETURN NEW; END $$ LANGUAGE plpgsql;");
+        setup.sql.push_back("DROP TRIGGER IF EXISTS " + sync + " ON " + t + ";");
+        setup.sql.push_back("CREATE TRIGGER " + sync + " BEFORE INSERT OR UPDATE ON " + t + " FOR EACH ROW EXECUTE FUNCTION " +
+            sync + "();");
+        chunk.sql.push_back("UPDATE " + t + " SET " + sets + " FROM " + cur + " WHERE " + range + ";");
+
+        // indexes and NOT NULL are prepared on the shadow columns before the swap, without blocking writes:
+        // indexes are built CONCURRENTLY, NOT NULL is proven by a validated CHECK
+        auto shadowed = [&](const std::string& f) {
+            for (const OrmProp* c : changed) if (c->name == f) return f + "__new";
+            return f;
+        };
+        auto build_concurrently = [&](const std::string& name, bool unique, const std::vector<std::string>& fields) {
+            std::vector<std::string> cols;
+            for (const std::string& f : fields) cols.push_back(shadowed(f));
+            build.sql.push_back("DROP INDEX CONCURRENTLY IF EXISTS " + name + ";"); // a failed build leaves it INVALID
+            build.sql.push_back(std::string("CREATE ") + (unique ? "UNIQUE " : "") + "INDEX CONCURRENTLY " + name + " ON " + t +
+                " (" + join(cols) + ");");
+        };
+
+        swap.sql.push_back("DROP TRIGGER IF EXISTS " + sync + " ON " + t + ";");
+        swap.sql.push_back("DROP FUNCTION IF EXISTS " + sync + "();");
+        for (const OrmProp* c : changed) {
+            const std::string nn = t + "_" + c->name + "__new_nn";
+            swap.sql.push_back("ALTER TABLE " + t + " DROP COLUMN " + c->name + ";");
+            swap.sql.push_back("ALTER TABLE " + t + " RENAME COLUMN " + c->name + "__new TO " + c->name + ";");
+            const std::string def = ddl.sql_default(*c);
+            if (!def.empty()) swap.sql.push_back("ALTER TABLE " + t + " ALTER COLUMN " + c->name + " SET" + def + ";");
+            if (c->required) {
+                check.sql.push_back("ALTER TABLE " + t + " DROP CONSTRAINT IF EXISTS " + nn + ";");
+                check.sql.push_back("ALTER TABLE " + t + " ADD CONSTRAINT " + nn + " CHECK (" + c->name + "__new IS NOT NULL) NOT VALID;");
+                validate.sql.push_back("ALTER TABLE " + t + " VALIDATE CONSTRAINT " + nn + ";");
+                // PG12+: the valid CHECK proves it, so SET NOT NULL skips the table scan
+                swap.sql.push_back("ALTER TABLE " + t + " ALTER COLUMN " + c->name + " SET NOT NULL;");
+                swap.sql.push_back("ALTER TABLE " + t + " DROP CONSTRAINT " + nn + ";");
+            }
+            if (c->is_unique) {
+                const std::string key = t + "_" + c->name + "__new_key";
+                build_concurrently(key, true, { c->name });
+                swap.sql.push_back("ALTER TABLE " + t + " ADD CONSTRAINT " + t + "_" + c->name + "_key UNIQUE USING INDEX " + key + ";");
+            }
+            if (c->is_indexed && !c->is_unique) {
+                const std::string name = c->index_name.empty() ? t + "_" + c->name + "_idx" : c->index_name;
+                build_concurrently(name + "__new", false, { c->name });
+                swap.sql.push_back("ALTER INDEX " + name + "__new RENAME TO " + name + ";");
+            }
+        }
+        // indexes of both versions on a changed column went with the old column; new ones come from plan_()
+        for (const OrmIndex& idx : new_schema_.indexes) {
+            auto on_changed = [&](const std::string& f) { return shadowed(f) != f; };
+            if (std::none_of(idx.fields.begin(), idx.fields.end(), on_changed)) continue;
+            auto same = [&](const OrmIndex& o) { return o.index_name == idx.index_name && o.fields == idx.fields && o.unique == idx.unique; };
+            if (std::none_of(old_schema_.indexes.begin(), old_schema_.indexes.end(), same)) continue;
+            std::string name = idx.index_name;
+            if (name.empty()) {
+                name = t;
+                for (const std::string& f : idx.fields) name += "_" + f;
+                name += "_idx";
+            }
+            build_concurrently(name + "__new", idx.unique, idx.fields);
+            swap.sql.push_back("ALTER INDEX " + name + "__new RENAME TO " + name + ";");
+        }
+        swap.sql.push_back("DROP TABLE " + cur + ";");
+        for (std::string& sql : plan_(db_engine, true)) swap.sql.push_back(std::move(sql));
+    } else {
+        // rebuild: new table with the new columns, writes mirrored by triggers, rows copied by the chunks
+        OrmSchema next = new_schema_;
+        next.name = newt;
+        next.indexes.clear();
+        for (auto& [key, f] : next.fields) f.is_indexed = false;
+        setup.sql.push_back(DDLVisitor::split(ddl.visit(next)).front());
+
+        std::vector<std::string> cols, from_new, from_t;
+        for (const OrmProp* f : kept) {
+            cols.push_back(f->name);
+            from_new.push_back(cast("NEW", *f));
+            from_t.push_back(cast(t, *f));
+        }
+        const std::string copy_new = "INSERT OR REPLACE INTO " + newt + " (" + join(cols) + ") VALUES (" + join(from_new) + ");";
+        const std::string drop_old = "DELETE FROM " + newt + " WHERE " + pk->name + " = OLD." + pk->name + ";";
+        setup.sql.push_back("CREATE TRIGGER IF NOT EXISTS " + t + "__sync_ins AFTER INSERT ON " + t + " BEGIN " + copy_new + " END;");
+        setup.sql.push_back("CREATE TRIGGER IF NOT EXISTS " + t + "__sync_upd AFTER UPDATE ON " + t + " BEGIN " + drop_old + " " +
+            copy_new + " END;");
+        setup.sql.push_back("CREATE TRIGGER IF NOT EXISTS " + t + "__sync_del AFTER DELETE ON " + t + " BEGIN " + drop_old + " END;");
+        chunk.sql.push_back("INSERT OR REPLACE INTO " + newt + " (" + join(cols) + ") SELECT " + join(from_t) + " FROM " + t + ", " +
+            cur + " WHERE " + range + ";");
+
+        // the old table's triggers and indexes go with it; the new version's indexes are built last
+        swap.sql.push_back("DROP TABLE " + t + ";");
+        swap.sql.push_back("ALTER TABLE " + newt + " RENAME TO " + t + ";");
+        std::vector<std::string> script = DDLVisitor::split(ddl.visit(new_schema_));
+        swap.sql.insert(swap.sql.end(), script.begin() + 1, script.end());
+        swap.sql.push_back("DROP TABLE " + cur + ";");
+    }
+    chunk.sql.push_back("UPDATE " + cur + " SET lo = hi WHERE hi IS NOT NULL;");
+    std::vector<MigrationStep> steps { setup, chunk };
+    for (MigrationStep* st : { &build, &check, &validate }) {
+        if (!st->sql.empty()) steps.push_back(std::move(*st));
+    }
+    steps.push_back(std::move(swap));
+    return steps;
+}
+
+int64_t SchemaUpdate::run(SQLConnection& conn, const std::vector<MigrationStep>& steps, const OnlineMigration& opts) {
+    int64_t total = 0;
+    for (const MigrationStep& step : steps) {
+        if (step.kind == MigrationStep::Kind::Concurrent) { // not allowed in a transaction block
+            for (const std::string& sql : step.sql) conn.prepare(sql)->exec();
+            continue;
+        }
+        if (step.kind == MigrationStep::Kind::Ddl) {
+            in_tx(conn, [&] {
+                for (const std::string& sql : step.sql) conn.prepare(sql)->exec();
+            });
+            continue;
+        }
+        for (;;) { // one chunk per transaction until a chunk copies nothing
+            int rows = 0;
+            in_tx(conn, [&] {
+                for (size_t i = 0; i < step.sql.size(); ++i) {
+                    const int n = conn.prepare(step.sql[i])->exec();
+                    if (i == step.counted) rows = n;
+                }
+            });
+            if (rows == 0) break;
+            total += rows;
+            if (opts.throttle.count() > 0) std::this_thread::sleep_for(opts.throttle);
+        }
+    }
+    return total;
+}
@@ -1,8 +1,14 @@
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <cstring>
+#include <functional>
+#include <strings.h>
+#include <string_view>
+#include "rapidjson/error/en.h"
+#include "rapidjson/reader.h"
 #include "storage.hpp"
 #include "sqlconnection.hpp"
 #include "ulid.hpp"
@@ -20,26 +26,39 @@ PSQLConnection make_postgres_connection();
 
 namespace {
 
-    const OrmProp* find_pk_field(const OrmSchema& s) {
-        OrmProp p;
-        for (const auto& it : s.fields) {
-            auto p = it.second;
-            if (p.is_id || p.name == "id")
-                return &it.second;
+    /**
+     * UPSERT batch keys: open addressing over the rows' PK values, compared in place
+     *  - reset() per batch; the table is sized once for the largest batch, so no allocation per row
+     *  - numbers hash by their double value: 1 and 1.0 are the same key, as for the DB
+     */
+    class PkSet {
+    public:
+        void reset(size_t rows) {
+            size_t cap = 16;
+            while (cap < rows * 2) cap <<= 1;
+            if (slots_.size() < cap) slots_.resize(cap);
+            std::fill(slots_.begin(), slots_.end(), nullptr);
+        }
+        // false when @p v is already in the set
+        bool insert(const jval& v) {
+            const size_t mask = slots_.size() - 1;
+            for (size_t i = hash_(v) & mask;; i = (i + 1) & mask) {
+                if (!slots_[i]) {
+                    slots_[i] = &v;
+                    return true;
+                }
+                if (*slots_[i] == v) return false;
+            }
         }
-        return nullptr;
-    }
 
-    // JSON -> string param (kept simple/portable)
-    std::string to_param(const jval& v) {
-        if (v.IsString () ) return v.GetString() ;
-        if (v.IsNumber () ) return v.GetString() ;
-        if (v.IsInt    () ) return v.GetString() ;
-        if (v.IsFloat  () ) return v.GetString() ;
-        if (v.IsNull   () ) return std::string {NULL};
-        if (v.IsBool   () ) return v.GetBool()? "true" : "false";
-        return v.GetString(); // is_object() | .IsArray( -> JSON text
-    }
+    private:
+        static size_t hash_(const jval& v) {
+            if (v.IsString()) return std::hash<std::string_view> {}(std::string_view(v.GetString(), v.GetStringLength()));
+            if (v.IsNumber()) return std::hash<double> {}(v.GetDouble());
+            return 0;
+        }
+        std::vector<const jval*> slots_;
+    };
 
     // // Select the first object (array -> first elem)
     // const jval& first_obj(const jval& value) {
@@ -53,37 +72,131 @@ namespace {
     //     return value;
     // }
 
-    bool has_id(const jval& value) {
-        if (value.HasMember("id")) {
-            const jit& v = value.FindMember("id");
-            if (!v->value.IsNull()) {
-                if (v->value.IsString()) {
-                    return !std::string(v->value.GetString()).empty();
-                } else {
-                    return v->value.GetInt() > 0;
+    // in-memory databases are private to their connection: no readers
+    bool is_sqlite_memory(const std::string& path) {
+        return path.empty() || path == ":memory:" || path.find("mode=memory") != std::string::npos
+            || path.rfind("file::memory:", 0) == 0;
+    }
+
+    /**
+     * SAX handler of Storage::insert_stream()
+     *  - rows are the elements of a root array (or the root object itself); each one is assembled
+     *    bottom-up on a value stack, allocated from chunk's pool, then moved into chunk
+     *  - flush() runs whenever chunk holds `rows` objects and must leave chunk empty; it is called
+     *    between rows, when the value stack is empty, so the pool can be rewound
+     */
+    class RowAssembler : public json::BaseReaderHandler<json::UTF8<>, RowAssembler> {
+    public:
+        RowAssembler(jdoc& chunk, size_t rows, std::function<void()> flush)
+            : chunk_(chunk)
+            , rows_(rows)
+            , flush_(std::move(flush)) { }
+
+        bool Null() { return add_(jval()); }
+        bool Bool(bool b) { return add_(jval(b)); }
+        bool Int(int i) { return add_(jval(i)); }
+        bool Uint(unsigned u) { return add_(jval(u)); }
+        bool Int64(int64_t i) { return add_(jval(i)); }
+        bool Uint64(uint64_t u) { return add_(jval(u)); }
+        bool Double(double d) { return add_(jval(d)); }
+        bool String(const char* str, json::SizeType len, bool) { return add_(jval(str, len, chunk_.GetAllocator())); }
+        bool Key(const char* str, json::SizeType len, bool) {
+            stack_.emplace_back(str, len, chunk_.GetAllocator());
+            return true;
+        }
+
+        bool StartObject() {
+            if (depth_++ == 0) row_depth_ = 0; // root object: the only row
+            return true;
+        }
+        bool EndObject(json::SizeType members) {
+            --depth_;
+            jval obj(json::kObjectType);
+            obj.MemberReserve(members, chunk_.GetAllocator());
+            const size_t base = stack_.size() - 2 * static_cast<size_t>(members);
+            for (size_t i = base; i < stack_.size(); i += 2) obj.AddMember(stack_[i], stack_[i + 1], chunk_.GetAllocator());
+            stack_.resize(base);
+            return add_(std::move(obj));
+        }
+        bool StartArray() {
+            if (depth_++ == 0) row_depth_ = 1; // root array: its elements are the rows
+            return true;
+        }
+        bool EndArray(json::SizeType elements) {
+            if (--depth_ == 0 && row_depth_ == 1) return true; // end of the root array
+            jval arr(json::kArrayType);
+            arr.Reserve(elements, chunk_.GetAllocator());
+            const size_t base = stack_.size() - static_cast<size_t>(elements);
+            for (size_t i = base; i < stack_.size(); ++i) arr.PushBack(stack_[i], chunk_.GetAllocator());
+            stack_.resize(base);
+            return add_(std::move(arr));
+        }
+
+        // root was a scalar: not an object or array of objects
+        bool bad_root() const { return bad_root_; }
+
+    private:
+        bool add_(jval&& v) {
+            if (depth_ != row_depth_) { // member or element of a row
+                if (depth_ == 0) { // a scalar root
+                    bad_root_ = true;
+                    return false;
                 }
+                stack_.push_back(std::move(v));
+                return true;
             }
+            if (!v.IsObject()) return true; // like insert(): non-object elements are skipped
+            chunk_.PushBack(v, chunk_.GetAllocator());
+            if (chunk_.Size() >= rows_) flush_();
+            return true;
         }
-        return false;
-    }
+
+        jdoc& chunk_;
+        const size_t rows_;
+        std::function<void()> flush_;
+        std::vector<jval> stack_; // capacity kept across rows
+        int depth_ = 0;
+        int row_depth_ = -1;
+        bool bad_root_ = false;
+    };
 }
 
-Storage::Storage(const std::string& db_path, Dialect dialect)
-    : catalog_(OrmSchemaMap())
-    , snowflake_(SnowflakeIdGenerator(21, 7)) {
+Storage::Storage(const std::string& db_path, Dialect dialect, StorageOptions options)
+    : snowflake_(SnowflakeIdGenerator(21, 7))
+    , catalog_(std::make_shared<const OrmSchemaMap>()) {
     pool::AcquirePolicy pol;
     pol.acquire_timeout = std::chrono::milliseconds(1500);
     pol.max_lease_time = std::chrono::milliseconds(0); // no auto-expire
+    pol.idle_timeout = options.idle_timeout;
+    // writers: one connection up front (creates the SQLite file / checks the DSN), grow on demand;
+    // readers: connect on first use
+    pool::AcquirePolicy wpol = pol;
+    wpol.min_size = 1;
+
+    std::unique_ptr<pool::IDbPool> writer;
+    std::vector<std::unique_ptr<pool::IDbPool>> readers;
 
     switch (dialect) {
-    case Dialect::SQLite:
+    case Dialect::SQLite: {
         ddlVisitor_ = std::make_unique<SqliteDDLVisitor>();
         dmlVisitor_ = std::make_unique<SqliteDMLVisitor>();
         // qryVisitor_ = std::make_unique<SqliteQRYVisitor>();
         // db_path should be the SQLite filename/URI
         // std::string db_path = "/path/to/sqlite.db";
-        dbpool_ = std::make_unique<DbPool>(/*capacity*/ 1, db_path, make_sqlite_connection, pol);
+        // one writer; in WAL, read-only readers see the file without blocking it
+        const SqliteProfile& prof = options.sqlite;
+        writer = std::make_unique<DbPool>(/*capacity*/ 1, db_path,
+            [prof] { return make_sqlite_connection(prof); }, wpol);
+        const bool wal = !is_sqlite_memory(db_path) && strcasecmp(prof.journal_mode.c_str(), "WAL") == 0;
+        if (options.readers && wal) {
+            readers.push_back(std::make_unique<DbPool>(options.readers, db_path,
+                [prof] { return make_sqlite_connection(prof, /*readonly*/ true); }, pol));
+        }
+        if (wal && prof.checkpoint_interval.count() > 0) {
+            checkpointer_ = std::make_unique<SqliteCheckpointer>(db_path, prof.checkpoint_interval);
+        }
         break;
+    }
     case Dialect::Postgres:
 #if HAVE_POSTGRESQL
         ddlVisitor_ = std::make_unique<PgDDLVisitor>();
@@ -92,7 +205,15 @@ Storage::Storage(const std::string& db_path, Dialect dialect)
         // db_path should be a full PG DSN, e.g.:
         // "host=127.0.0.1 port=5432 dbname=ecm user=ecm password=ecm"
         // std::string db_path = "host=localhost port=5432 dbname=ecm user=ecm password=ecm"
-        dbpool_ = std::make_unique<DbPool>(/*capacity*/ 10, db_path, make_postgres_connection, pol);
+        writer = std::make_unique<DbPool>(options.writers ? options.writers : 1, db_path, make_postgres_connection, wpol);
+        if (options.readers) {
+            if (options.replicas.empty()) { // own connections to the primary
+                readers.push_back(std::make_unique<DbPool>(options.readers, db_path, make_postgres_connection, pol));
+            }
+            for (const auto& dsn : options.replicas) {
+                readers.push_back(std::make_unique<DbPool>(options.readers, dsn, make_postgres_connection, pol));
+            }
+        }
 #else
         THROW("PostgreSQL support not built in");
 #endif
@@ -100,6 +221,7 @@ Storage::Storage(const std::string& db_path, Dialect dialect)
     default:
         THROW("Unsupported dialect");
     }
+    dbpool_ = std::make_unique<SplitDbPool>(std::move(writer), std::move(readers));
 
     // Connect to database
     // dbpool_->connect(); perform the real connection to database
@@ -115,6 +237,17 @@ bool Storage::execDDL(std::string sql) {
     return stmt->exec();
 }
 
+bool Storage::createSchema(const OrmSchema& schema) {
+    const std::vector<std::string> script = DDLVisitor::split(ddlVisitor_->visit(schema));
+    auto ok = with_conn(pool::DbIntent::Write,
+        [&](SQLConnection& conn) {
+            for (const auto& sql : script) conn.prepare(sql)->exec(); // exec() throws on failure
+            return true;
+        }
+    );
+    return ok.value_or(false);
+}
+
 int Storage::execDML(std::string sql, const std::vector<std::string>& params) {
     pool::IDbPool::AcquireResult ac = dbpool_->acquire(pool::DbIntent::Write, std::chrono::milliseconds(1000));
     if (!ac.ok) return 0;
@@ -124,30 +257,69 @@ int Storage::execDML(std::string sql, const std::vector<std::string>& params) {
     return stmt->exec();
 }
 
+std::shared_ptr<OrmSchema> Storage::schema_(const std::string& name) const {
+    const std::shared_ptr<const OrmSchemaMap> snap = catalog_.load(std::memory_order_acquire);
+    auto it = snap->find(name);
+    return it == snap->end() ? nullptr : it->second;
+}
+
+std::shared_ptr<OrmSchema> Storage::entry_(const OrmSchema& schema) {
+    // catalog snapshots and running requests share the entry: the last one to drop it retires the
+    // version (schema_retired()). Entries may outlive the Storage, hence the weak visitor
+    std::weak_ptr<DMLVisitor> dml = dmlVisitor_;
+    return std::shared_ptr<OrmSchema>(new OrmSchema(schema), [dml](OrmSchema* s) {
+        if (std::shared_ptr<DMLVisitor> v = dml.lock()) v->invalidate(s->name, s->version);
+        delete s;
+    });
+}
+
+bool Storage::getSchema(std::string& name, OrmSchema& schema) {
+    const std::shared_ptr<OrmSchema> found = schema_(name);
+    if (!found) return false;
+    schema = *found;
+    return true;
+}
+
+int64_t Storage::count(const std::string& schemaName) {
+    const std::shared_ptr<OrmSchema> found = schema_(schemaName);
+    if (!found)
+        THROW("Schema not found: " + schemaName);
+    const std::string sql = "SELECT count(*) FROM " + found->name + ";";
+    return with_conn_fb(pool::DbIntent::Read,
+        [&](SQLConnection& conn) { return conn.prepare(sql)->query_int(); },
+        int64_t { -1 }
+    );
+}
+
 bool Storage::addSchema(OrmSchema& schema, SQLConnection* conn /*=nullptr*/) {
     if (schema.name.empty()) {
         return false; // invalid
     }
 
-    // 1) Add to in-memory catalog_ if not exists - do not return
-    if (catalog_.find(schema.name) == catalog_.end()) {
-        // move the caller's instance into the catalog_ to avoid copying a non-copyable type
-        // auto key = schema.name;                // take key before move
-        // catalog_.emplace(std::move(key), std::make_unique<OrmSchema>(std::move(schema)));
-        catalog_[schema.name] = std::make_shared<OrmSchema>(schema);
+    // 1) Add to in-memory catalog_ if not exists, or replace an older version - do not return
+    //    copy-on-write: readers keep the snapshot they loaded, new readers see the new one
+    //    the replaced version retires when its last holder lets go (see entry_())
+    {
+        std::lock_guard lk(catalog_mx_);
+        std::shared_ptr<const OrmSchemaMap> cur = catalog_.load(std::memory_order_acquire);
+        auto it = cur->find(schema.name);
+        if (it == cur->end() || it->second->version < schema.version) {
+            auto next = std::make_shared<OrmSchemaMap>(*cur);
+            (*next)[schema.name] = entry_(schema);
+            catalog_.store(std::move(next), std::memory_order_release);
+        }
     }
 
     // 2) Persist to DB via Storage::insert()
     if (!conn) return true; // in-memory done
 
     // Find meta-schemas for catalog_ and versions
-    auto itCat = catalog_.find("schema_catalog");
-    auto itVer = catalog_.find("schema_versions");
-    if (itCat == catalog_.end() || !itCat->second) return false;
-    if (itVer == catalog_.end() || !itVer->second) return false;
+    const std::shared_ptr<OrmSchema> cat = schema_("schema_catalog");
+    const std::shared_ptr<OrmSchema> ver = schema_("schema_versions");
+    if (!cat || !ver) return false;
 
-    OrmSchema& catSchema = *itCat->second; // table: schema_catalog
-    OrmSchema& verSchema = *itVer->second; // table: schema_versions
+    OrmSchema& catSchema = *cat; // table: schema_catalog
+    OrmSchema& verSchema = *ver; // table: schema_versions
 
     std::string track = "";
 
@@ -191,7 +363,7 @@ bool Storage::addSchema(OrmSchema& schema, SQLConnection* conn /*=nullptr*/) {
         "\"schema\": " + std::to_string(schema.id) + ", " +
         "\"applied\": false, " +
         "\"version\": "+ std::to_string(schema.version) + ", "+
-        "\"json\": " + schema.json + "}";
+        "\"json\": " + (schema.json.empty() ? std::string("null") : schema.json) + "}";
 
     bool ok2; std::string err2;
     jdoc doc2; doc2.Parse(json_str2.c_str());
@@ -221,25 +393,29 @@ bool Storage::init_catalog() {
         for (const auto& s : schemas) {
             OrmSchema schema = OrmSchema {};
             jdoc d; d.Parse(s.c_str());
+            if (d.HasParseError()) THROW("catalog schema: %s", json::GetParseError_En(d.GetParseError()));
             if (OrmSchema::from_json(d, schema)) {
-                // create the table
-                std::string ddl = ddlVisitor_->visit(schema);
-                auto stmt = conn.prepare(ddl);
-                if (stmt && stmt->exec() < 0) {
-                    std::stringstream s;
-                    s << "DDL Failed: " << ddl;
-                    THROW(s.str());
+                // create the table and its indexes, one statement at a time
+                for (const auto& ddl : DDLVisitor::split(ddlVisitor_->visit(schema))) {
+                    auto stmt = conn.prepare(ddl);
+                    if (stmt && stmt->exec() < 0) {
+                        std::stringstream s;
+                        s << "DDL Failed: " << ddl;
+                        THROW(s.str());
+                    }
                 }
                 // add to in-memory catalog_
                 addSchema(schema, nullptr);
             }
         }
         // after create the tables and add schemas to catalog_
-        // insert the schemas on DB
+        // insert the schemas on DB - once: later starts find their rows
         for (const auto& s : schemas) {
             OrmSchema schema = OrmSchema {};
             jdoc dc; dc.Parse(s.c_str());
             if (OrmSchema::from_json(dc, schema)) {
+                if (conn.prepare("UPDATE schema_catalog SET version = version WHERE name = '" + schema.name + "';")->exec() > 0) continue;
+                schema.json = s;
                 addSchema(schema, &conn);
             }
         }
@@ -256,10 +432,10 @@ bool Storage::init_catalog() {
 
 int Storage::insert(const std::string& schemaName, jval& doc, const std::string& trackinfo) {
     // 1 - find schema
-    auto it = catalog_.find(schemaName);
-    if (it == catalog_.end())
+    const std::shared_ptr<OrmSchema> found = schema_(schemaName); // keeps the schema alive for the call
+    if (!found)
         THROW("Schema not found: " + schemaName);
-    OrmSchema& schema = *(it->second);
+    OrmSchema& schema = *found;
     // call insert withing a trx control - aouto release connection
     auto rowsaff = with_conn(pool::DbIntent::Write,
         [&](SQLConnection& conn) {
@@ -287,112 +463,237 @@ int Storage::insert(const std::string& schemaName, jval& doc, const std::string&
 
 int Storage::insert(SQLConnection& conn, OrmSchema& schema, jval& data, const std::string& trackinfo) {
 
-    const jval& job = jhlp::first_obj(data); // object or array; first_object semantics for DML
-    const std::shared_ptr<OrmProp> pkField = schema.idprop();
+    jhlp::first_obj(data); // object or array of objects; throws otherwise
 
-    // Build both SQLs from the first object shape; we will choose per row.
-    // const std::pair<std::string, int> dmlVisitor_->insert(schema, job);
-    const dml_pair sqlInsert = dmlVisitor_->insert(schema, job);
-    const dml_pair sqlUpsert = dmlVisitor_->upsert(schema, job);
+    // rows to write: the object itself or every object of the array
+    std::vector<const jval*> rows;
+    if (data.IsArray()) {
+        rows.reserve(data.Size());
+        for (const jval& v : data.GetArray()) {
+            if (v.IsObject()) rows.push_back(&v);
+        }
+    } else if (data.IsObject()) {
+        rows.push_back(&data);
+    }
 
-    // Prepare once; reuse per row.
-    auto stmtInsert = conn.prepare(sqlInsert.first);
-    auto stmtUpsert = conn.prepare(sqlUpsert.first);
+    // arrays: queue every batch and collect the results once (no-op on backends without pipelining)
+    const bool piped = rows.size() > 1 && conn.pipeline_begin();
 
-    int rowsAffected = 0;
+    // reused by every batch: sized by the first ones, then no allocation per row
+    PkSet batchKeys;                  // UPSERT PKs of the batch
+    std::vector<jval> newids;         // INSERT generated PKs, bound in place
+    newids.reserve(std::min(rows.size(), batch_size_));
+    jalloc idpool;                    // string PKs (UUIDv7) of newids
 
-    // //called for each object
-    // auto pk_is_present = [&](const jval& obj) -> bool {
-    //     return obj.IsObject() && obj.HasMember(pkField->name.c_str());
-    // };
-
-    //called for each object
-    auto pk_is_valid = [&](const jval& obj) -> bool {
-        if (!has_id(obj)) return false;
-        if (obj.HasMember(pkField->name.c_str()) ) {
-            const jval& v = obj.FindMember(pkField->name.c_str())->value;
-            // Minimal validity: non-null and non-zero/empty by type
-            if (pkField->type == PropType::Integer || pkField->type == PropType::Number) {
-                if (!v.IsNumber() && !v.IsInt() && !v.IsFloat()) return false;
-                // treat 0 as invalid for generated ids
-                return (v.IsFloat()) ? v.GetDouble() != 0.0 : v.GetInt()!= 0;
-            } else { // strings (UUID, etc.)
-                if (!v.IsString()) return false;
-                return !std::string(v.GetString()).empty();
-            }
+    int rowsAffected = 0;
+    size_t first = 0;
+    while (first < rows.size()) {
+        // A batch is a run of consecutive rows with the same key shape and the same
+        // INSERT/UPSERT decision, bounded by batch_size_ and the connection's parameter limit.
+        const jval& head = *rows[first];
+        const std::shared_ptr<const BindPlan> plan = schema.bind_plan(head); // cached per key shape
+        const OrmProp& pkField = *plan->pk;
+        const bool isUpsert = plan->pk_valid(head);
+
+        // INSERT: generated PK is the last param of each row
+        const size_t cols = isUpsert ? plan->cols.size() : plan->params(true);
+        const size_t maxRows = dmlVisitor_->batch_rows(cols, batch_size_, conn.max_params());
+
+        // UPSERT: a PK may appear only once per statement (Postgres rejects a second hit)
+        if (isUpsert) {
+            batchKeys.reset(std::min(maxRows, rows.size() - first));
+            batchKeys.insert(plan->value(head, plan->cols[plan->pk_col]));
         }
-        return false;
-    };
 
-    //porcess foreach one object
-    auto processOne = [&](const jval& obj) {
-        // Decide per object
-        const bool hasPk = has_id(obj);
-        const bool validPk = pk_is_valid(obj);
-        const bool isUpsert = hasPk && validPk;
+        size_t last = first + 1;
+        while (last < rows.size() && last - first < maxRows) {
+            const jval& row = *rows[last];
+            if (!plan->matches(row)) break;
+            if (plan->pk_valid(row) != isUpsert) break;
+            if (isUpsert && !batchKeys.insert(plan->value(row, plan->cols[plan->pk_col]))) break;
+            ++last;
+        }
+        const size_t n = last - first;
 
-        // Choose statement
-        auto& stmt = isUpsert ? *stmtUpsert : *stmtInsert;
+        // Prepare once per batch shape (SQL text cached by the visitor, statements by the connection)
+        const auto sql = dmlVisitor_->sql(isUpsert ? DmlOp::UpsertBatch : DmlOp::InsertBatch, schema, head, n);
+        auto stmt = conn.prepare(sql->sql);
 
-        // If INSERT path:
-        //  - PK present but invalid: we may safely update the *existing* key -> preserves order
-        //  - PK absent: generate PK but DO NOT add key to obj -> we will bind it *last*
-        jdoc newid; // null by default
-        newid.SetObject();
-        if (!isUpsert) {
-            create_id( pkField, newid, "id");
-        }
+        // Generated PKs for the INSERT path; must outlive exec()
+        newids.clear();
+        newids.reserve(n); // bound in place: never reallocated within the batch
+        idpool.Clear();
 
-        // Bind in JSON key order for keys that exist in schema
+        // Bind row by row through the plan: schema fields in JSON key order
         int paramIndex = 1;
-        for (jit it = obj.MemberBegin(); it!=obj.MemberEnd(); it++) {
-            auto fit = schema.fields.find(it->name.GetString());
-            if (fit == schema.fields.end()) continue;
-            const auto& fld = fit->second;
-            if (fld.is_id) {
-                if (isUpsert) { // tem PK e PK é Valida - usar PK do Objeto
-                    stmt.bind(paramIndex++, it->value, fld.type);
-                }  // !hasPK || (hasPK && PK_Invalida) // usar PK criada
-            } else { //if isUpsert - hasID and PK_is_valid, use the obj ID
-                stmt.bind(paramIndex++, it->value, fld.type);
+        for (size_t r = first; r < last; ++r) {
+            const jval& obj = *rows[r];
+            for (size_t c = 0; c < plan->cols.size(); ++c) {
+                // INSERT: a PK present in JSON is invalid here - replaced by a generated one
+                if (!isUpsert && static_cast<int>(c) == plan->pk_col) continue;
+                stmt->bind(paramIndex++, plan->value(obj, plan->cols[c]), plan->cols[c].prop->type);
+            }
+            // if not upsert - PK is the last param of the row
+            if (!isUpsert) {
+                newids.push_back(new_id_(pkField, idpool));
+                stmt->bind(paramIndex++, newids.back(), pkField.type);
             }
-        }
-
-        // if not upsert and not have pk - PK is the last
-        if (!isUpsert) {
-            stmt.bind(paramIndex++, newid, pkField->type);
         }
 
         // exec
-        stmt.exec();
-        rowsAffected++;
+        stmt->exec();
+        rowsAffected += static_cast<int>(n);
 
         // Tracking hook (no-op for now)
         if (!trackinfo.empty()) {
             // TODO: audit insert/upsert into Track table
         }
-    };
+        first = last;
+    }
+    if (piped) conn.pipeline_end(); // sync point: throws the first failed batch
+    return rowsAffected; // caller controls transaction
+}
 
-    try {
-        if (data.IsArray()) {
-            for (jit it = data.MemberBegin(); it != data.MemberEnd(); it++) {
-                if (it->value.IsObject()) processOne(it->value);
+int64_t Storage::bulk_insert(const std::string& schemaName, jval& data, CopyFormat format) {
+    const std::shared_ptr<OrmSchema> found = schema_(schemaName); // keeps the schema alive for the call
+    if (!found)
+        THROW("Schema not found: " + schemaName);
+    OrmSchema& schema = *found;
+
+    const jval& head = jhlp::first_obj(data);
+    const std::shared_ptr<OrmProp> pkField = schema.idprop();
+
+    // column list from the first object: schema fields in JSON order, PK last
+    // (with the DDL visitor's column types: they fix the binary COPY widths)
+    std::vector<const OrmProp*> props;
+    std::vector<CopyColumn> columns;
+    for (jit m = head.MemberBegin(); m != head.MemberEnd(); m++) {
+        auto fit = schema.fields.find(m->name.GetString());
+        if (fit == schema.fields.end() || fit->second.name == pkField->name) continue;
+        props.push_back(&fit->second);
+        columns.push_back(CopyColumn { fit->second.name, ddlVisitor_->sql_type(fit->second) });
+    }
+    columns.push_back(CopyColumn { pkField->name, ddlVisitor_->sql_type(*pkField) });
+
+    auto rowsaff = with_conn(pool::DbIntent::Write,
+        [&](SQLConnection& conn) -> int64_t {
+            try {
+                conn.begin();
+
+                // DB-generated IDs need the connection between rows: not possible while COPY is open
+                const bool dbIds = pkField->id_kind == IdKind::DBSerial || pkField->id_kind == IdKind::TBSerial;
+                std::unique_ptr<SQLBulkLoad> load = dbIds ? nullptr : conn.bulk_load(schema.name, columns, format);
+
+                int64_t rows = 0;
+                if (!load) {
+                    rows = insert(conn, schema, data, "");
+                } else {
+                    jdoc newids; // generated PKs, reset every kIdChunk rows to bound memory
+                    newids.SetObject();
+                    constexpr int64_t kIdChunk = 4096;
+                    const char* pk = pkField->name.c_str();
+
+                    auto loadOne = [&](const jval& obj) {
+                        for (const OrmProp* p : props) {
+                            jit m = obj.FindMember(p->name.c_str());
+                            if (m == obj.MemberEnd()) load->put_null();
+                            else load->put(m->value, p->type);
+                        }
+                        jit id = obj.FindMember(pk);
+                        const bool validPk = id != obj.MemberEnd()
+                            && (id->value.IsString() ? id->value.GetStringLength() > 0
+                                                     : id->value.IsNumber() && id->value.GetDouble() != 0.0);
+                        if (validPk) {
+                            load->put(id->value, pkField->type);
+                        } else {
+                            create_id(*pkField, newids, "id");
+                            load->put(newids["id"], pkField->type);
+                        }
+                        load->end_row();
+                        if (++rows % kIdChunk == 0) {
+                            newids.SetObject();
+                            newids.GetAllocator().Clear();
+                        }
+                    };
+
+                    if (data.IsArray()) {
+                        for (const jval& v : data.GetArray()) {
+                            if (v.IsObject()) loadOne(v);
+                        }
+                    } else {
+                        loadOne(data);
+                    }
+                    rows = load->finish();
+                }
+
+                if (!conn.commit()) {
+                    conn.rollback();
+                    THROW("commit fail! transaction rolled back");
+                }
+                return rows;
+            } catch (...) {
+                conn.rollback();
+                throw;
             }
-        } else if (data.IsObject()) {
-            processOne(data);
         }
-        return rowsAffected;
-    } catch (...) {
-        throw; // caller controls transaction
-    }
+    );
+    return rowsaff ? *rowsaff : 0;
+}
+
+int64_t Storage::insert_stream(const std::string& schemaName, std::istream& in, const std::string& trackinfo) {
+    // 1 - find schema
+    const std::shared_ptr<OrmSchema> found = schema_(schemaName); // keeps the schema alive for the call
+    if (!found)
+        THROW("Schema not found: " + schemaName);
+    OrmSchema& schema = *found;
+
+    auto rowsaff = with_conn(pool::DbIntent::Write,
+        [&](SQLConnection& conn) -> int64_t {
+            try {
+                // 2 - begin transaction
+                conn.begin();
+
+                // 3 - one chunk of rows in memory at a time, written by the batched insert
+                int64_t rows = 0;
+                jdoc chunk;
+                chunk.SetArray();
+                auto flush = [&] {
+                    if (chunk.Empty()) return;
+                    rows += insert(conn, schema, chunk, trackinfo);
+                    chunk.SetArray();
+                    chunk.GetAllocator().Clear();
+                };
+                RowAssembler rowsax(chunk, batch_size_, flush);
+
+                char buf[64 * 1024];
+                json::IStreamWrapper is(in, buf, sizeof(buf));
+                json::Reader reader;
+                json::ParseResult ok = reader.Parse<json::kParseIterativeFlag>(is, rowsax);
+                if (rowsax.bad_root()) THROW_INVALID("JSON must be an object or array of objects");
+                if (!ok) THROW_INVALID("JSON parse error: %s at offset %zu", json::GetParseError_En(ok.Code()), ok.Offset());
+                flush();
+
+                // 4 - commit
+                if (!conn.commit()) {
+                    conn.rollback();
+                    THROW("commit fail! transaction rolled back");
+                }
+                return rows;
+            } catch (...) {
+                conn.rollback();
+                throw;
+            }
+        }
+    );
+    return rowsaff ? *rowsaff : 0;
 }
 
 int Storage::update(const std::string& schemaName, jval& value, const std::string& trackinfo) {
     // 1 - find schema
-    auto it = catalog_.find(schemaName);
-    if (it == catalog_.end())
+    const std::shared_ptr<OrmSchema> found = schema_(schemaName); // keeps the schema alive for the call
+    if (!found)
         THROW("Schema not found: " + schemaName);
-    OrmSchema& schema = *(it->second);
+    OrmSchema& schema = *found;
 
     // call update withing a trx control - auto release connection
     auto rowsaff = with_conn(pool::DbIntent::Write,
@@ -419,82 +720,114 @@ int Storage::update(const std::string& schemaName, jval& value, const std::strin
     return rowsaff ? *rowsaff: 0;
 }
 
-int Storage::update(SQLConnection& conn, OrmSchema& schema, jval& value, const std::string& trackinfo) {
+aio::Task<int> Storage::co_insert(const std::string& schemaName, jval& data, const std::string& trackinfo) {
+    co_return co_await co_write_(schemaName, data, trackinfo, false);
+}
 
-    // 1 - build SQL via DMLVisitor
-    int rowsAffected = 0;
-    const jval& obj = jhlp::first_obj(value);
-    if (!has_id(obj)) THROW("object must have an ID");
+aio::Task<int> Storage::co_update(const std::string& schemaName, jval& value, const std::string& trackinfo) {
+    co_return co_await co_write_(schemaName, value, trackinfo, true);
+}
+
+aio::Task<int> Storage::co_insert(SQLConnection& conn, OrmSchema& schema, jval& data, const std::string& trackinfo) {
+    co_return co_await co_write_(conn, schema, data, trackinfo, false);
+}
+
+aio::Task<int> Storage::co_update(SQLConnection& conn, OrmSchema& schema, jval& value, const std::string& trackinfo) {
+    co_return co_await co_write_(conn, schema, value, trackinfo, true);
+}
 
-    dml_pair sql = dmlVisitor_->update(schema, obj);
+aio::Task<int> Storage::co_write_(const std::string& schemaName, jval& data, const std::string& trackinfo, bool update) {
+    // 1 - find schema
+    const std::shared_ptr<OrmSchema> found = schema_(schemaName); // keeps the schema alive for the call
+    if (!found)
+        THROW("Schema not found: " + schemaName);
+
+    // 2 - wait for a connection without blocking the loop thread
+    auto ac = co_await dbpool_->co_acquire(pool::DbIntent::Write, 1000ms);
+    if (!ac.ok) co_return 0;
+    co_return co_await co_write_(ac.lease.conn(), *found, data, trackinfo, update);
+}
 
-    // 2 - begin (nested allowed; conn tracks state)
-    // conn.begin(); // do not begin TRX - controlled by the caller function
+aio::Task<int> Storage::co_write_(SQLConnection& conn, OrmSchema& schema, jval& data, const std::string& trackinfo, bool update) {
+    int rows = 0;
+    std::exception_ptr err;
     try {
-        // 3 - prepare - sql was build in the order of the json obj keys
-        auto stmt = conn.prepare(sql.first);
-
-        auto processOne = [&](const jval& val) {
-            // 5.1 - check ID
-            if (!has_id(val)) THROW("object must have an ID");
-
-            // 5.2 - bind params (schema fields that exist in job)
-            int paramIndex = 1; // one base index not zero based
-            //foreach key in json object, find the OrmField and if exists - bind params
-            OrmProp prop;
-            OrmProp idprop;
-            std::unordered_map<std::string, OrmProp>::iterator it;
-            jval idvalue;
-
-            for (jit it = val.MemberBegin(); it!= val.MemberEnd(); it++) {
-                auto fld = schema.fields.find(it->name.GetString());
-                if (fld != schema.fields.end()) {
-                    prop = fld->second;
-                    if (prop.is_id || prop.name == "id") { // the id is the last param => where id = 1234
-                        idvalue = value;
-                        idprop = prop;
-                    } else {
-                        stmt->bind(paramIndex++, value, prop.type);
-                    }
-                }
-            }
-            //bind last param = where id = ?$1
-            stmt->bind(paramIndex++, idvalue, idprop.type);
+        // 3 - BEGIN + statements + COMMIT in one pipeline (no-op for SQLite)
+        conn.pipeline_begin();
+        if (!conn.begin()) THROW("begin() failed");
+        rows = update ? this->update(conn, schema, data, trackinfo) : insert(conn, schema, data, trackinfo);
+
+        // 4 - the only wait on the server. insert() already counted its rows on the client; update()
+        // counts through exec()/pipeline_end(), which report nothing while this outer pipeline is open
+        const int synced = co_await conn.co_commit();
+        if (update) rows += synced;
+    } catch (...) {
+        err = std::current_exception();
+    }
+    if (err) { // 5 - no co_await inside a handler: roll back here
+        conn.rollback();
+        std::rethrow_exception(err);
+    }
+    co_return rows;
+}
 
-            // execute
-            stmt->exec();
-            rowsAffected++;
+int Storage::update(SQLConnection& conn, OrmSchema& schema, jval& value, const std::string& trackinfo) {
 
-            // 5.3 - track
-            if (!trackinfo.empty()) {
-                // TODO: insert audit record into Track table
-            }
-        }; // process_one
+    jhlp::first_obj(value); // object or array of objects; throws otherwise
 
-        // 4/5 - dispatch on array vs object
-        if (obj.IsArray()) {
-            for (jit it = obj.MemberBegin(); it!=obj.MemberEnd(); it++) {
-                if (it->value.IsObject())
-                    processOne(it->value);
-            }
-        } else if (obj.IsObject()) {
-            processOne(obj);
+    // rows to write: the object itself or every object of the array
+    std::vector<const jval*> rows;
+    if (value.IsArray()) {
+        rows.reserve(value.Size());
+        for (const jval& v : value.GetArray()) {
+            if (v.IsObject()) rows.push_back(&v);
         }
+    } else if (value.IsObject()) {
+        rows.push_back(&value);
+    }
 
-        // 6 - do not commit or rollback - caller control the Transaction(trx)
-        // if (!conn.commit()) {
-        //     conn.rollback();
-        //     THROW("commit fail - transaction rolled back");
-        // }
+    // arrays: queue every UPDATE and collect the results once (no-op on backends without pipelining)
+    const bool piped = rows.size() > 1 && conn.pipeline_begin();
 
-        // 7 - notify subscribers
-        // notify(schema.name, isUpsert ? "UPSERT" : "INSERT");
+    int rowsAffected = 0;
+    std::unique_ptr<SQLStatement> stmt;
+    std::shared_ptr<const BindPlan> plan; // key shape the current statement was built for
+    for (const jval* row : rows) {
+        const jval& obj = *row;
+
+        // 1/3 - SQL follows the JSON key order: prepare again only when the shape changes
+        if (!plan || !plan->matches(obj)) {
+            plan = schema.bind_plan(obj);
+            // 5.1 - check ID (every row of the shape has the key)
+            if (plan->pk_col < 0) THROW_INVALID("object must have an ID");
+            stmt = conn.prepare(dmlVisitor_->sql(DmlOp::Update, schema, obj)->sql);
+        }
+        const jval& pk = plan->value(obj, plan->cols[plan->pk_col]);
+        if (pk.IsNull()) THROW_INVALID("object must have an ID");
+
+        // 5.2 - bind SET params in JSON key order (schema fields only), PK last => where id = ?
+        int paramIndex = 1; // one based
+        for (size_t c = 0; c < plan->cols.size(); ++c) {
+            if (static_cast<int>(c) == plan->pk_col) continue;
+            stmt->bind(paramIndex++, plan->value(obj, plan->cols[c]), plan->cols[c].prop->type);
+        }
+        stmt->bind(paramIndex++, pk, plan->pk->type);
 
-        return rowsAffected;
-    } catch (...) {
-        // conn.rollback();  // do not rollback - caller control the TRX
-        throw;
+        // execute (pipelined: queued, counted at the sync point)
+        rowsAffected += stmt->exec();
+
+        // 5.3 - track
+        if (!trackinfo.empty()) {
+            // TODO: insert audit record into Track table
+        }
     }
+    if (piped) rowsAffected += conn.pipeline_end();
+
+    // 6 - do not commit or rollback - caller control the Transaction(trx)
+    // 7 - notify subscribers
+    // notify(schema.name, "UPDATE");
+
+    return rowsAffected;
 }
 
 
@@ -510,55 +843,105 @@ int Storage::update(SQLConnection& conn, OrmSchema& schema, jval& value, const s
  * @return The generated ID of type T.
  */
 
-inline void Storage::create_id(const std::shared_ptr<OrmProp> idprop, jdoc& doc, std::string key) {
-    const char* ck = key.c_str();
-    switch (idprop->id_kind) {
-        case IdKind::UUIDv7:{
-            if (!doc.HasMember(ck)) { jhlp::set<std::string>(doc, key, ULID::get_id()); return ;}
-            jval& val = doc.FindMember(ck)->value;
-            if (!val.IsString())
-                THROW("JSON Field must have a STRING datatype!");
-            val.SetString(ULID::get_id().c_str(), doc.GetAllocator());
-        }break;
+jval Storage::new_id_(const OrmProp& idprop, jalloc& alloc) {
+    switch (idprop.id_kind) {
+        case IdKind::UUIDv7: {
+            char ulid[27];
+            ULID::get_id(ulid);
+            return jval(ulid, 26, alloc);
+        }
         case IdKind::HighLow:
-        case IdKind::Snowflake:{
-            if (!doc.HasMember(ck)) { jhlp::set<int64_t>(doc, key, snowflake_.get_id()); return ;}
-            jval& val = doc.FindMember(ck)->value;
-            if (!val.IsInt64())
-                THROW("JSON Field must have a NUMBER/INTEGER datatype!");
-            val.SetInt64(snowflake_.get_id());
-        }break;
+        case IdKind::Snowflake:
+            return jval(static_cast<int64_t>(snowflake_.get_id()));
         case IdKind::DBSerial:
-        case IdKind::TBSerial:{
-            if (!doc.HasMember(ck)) { jhlp::set<int64_t>(doc, key, snowflake_.get_id()); }
-            jval& val = doc.FindMember(ck)->value;
-            if (!val.IsInt64())
-                THROW("JSON Field must have a NUMBER/INTEGER datatype!");
-
+        case IdKind::TBSerial: {
             //here we need the SQLconnection to get serial from DB
-            auto rowsaff = with_conn(pool::DbIntent::Write,
+            int64_t id = snowflake_.get_id();
+            with_conn(pool::DbIntent::Write,
                 [&](SQLConnection& conn)->int {
-                    int64_t id;
-                    if(idprop->id_kind == IdKind::TBSerial)
-                        id = conn.nextValue(idprop->schema_name);
+                    if(idprop.id_kind == IdKind::TBSerial)
+                        id = conn.nextValue(idprop.schema_name);
                     else
-                        id = conn.nextValue("db"); // or  conn.nextValue(idprop->schema_name); for TBSerial
-                    val.SetInt64(id);
+                        id = conn.nextValue("db"); // or  conn.nextValue(idprop.schema_name); for TBSerial
                     return 1;
                 }
             );
-        }break;
+            return jval(id);
+        }
         default:
             THROW("Unsupported ID kind.");
     }
+    return jval();
+}
+
+void Storage::create_id(const OrmProp& idprop, jdoc& doc, const std::string& key) {
+    jval id = new_id_(idprop, doc.GetAllocator());
+    jval::MemberIterator m = doc.FindMember(key.c_str());
+    if (m != doc.MemberEnd()) {
+        m->value = id;
+        return;
+    }
+    doc.AddMember(jval(key.c_str(), static_cast<json::SizeType>(key.size()), doc.GetAllocator()), id, doc.GetAllocator());
+}
+int Storage::del(const std::string& name, const jval& value, const std::string& user, const std::string& context) {
+    // 1 - find schema
+    const std::shared_ptr<OrmSchema> found = schema_(name); // keeps the schema alive for the call
+    if (!found)
+        THROW("Schema not found: " + name);
+    OrmSchema& schema = *found;
+    const OrmProp* pkField = schema.pkprop();
+    if (!pkField) THROW("Schema has no ID: " + name);
+
+    // 2 - object or array of objects
+    std::vector<const jval*> rows;
+    if (value.IsArray()) {
+        rows.reserve(value.Size());
+        for (const jval& v : value.GetArray()) {
+            if (!v.IsObject()) THROW_INVALID("array elements must be objects");
+            rows.push_back(&v);
+        }
+    } else if (value.IsObject()) {
+        rows.push_back(&value);
+    } else {
+        THROW_INVALID("JSON must be an object or array of objects");
+    }
+    if (rows.empty()) return 0;
+
+    auto rowsaff = with_conn(pool::DbIntent::Write,
+        [&](SQLConnection& conn) {
+            try {
+                // 4 - begin transaction
+                conn.begin();
+
+                // 3/5 - DELETE by ID: one statement for every row
+                auto stmt = conn.prepare(dmlVisitor_->sql(DmlOp::Remove, schema, *rows.front())->sql);
+                int deleted = 0;
+                for (const jval* row : rows) {
+                    // 6.1 - ID required
+                    jit pk = row->FindMember(pkField->name.c_str());
+                    if (pk == row->MemberEnd() || pk->value.IsNull()) THROW_INVALID("object must have an ID");
+                    // 6.2 - delete by ID
+                    stmt->bind(1, pk->value, pkField->type);
+                    deleted += stmt->exec();
+                    // 6.3 - track
+                    if (!user.empty() || !context.empty()) {
+                        // TODO: insert audit record into Track table
+                    }
+                }
+
+                // 7 - commit
+                if (!conn.commit()) {
+                    conn.rollback();
+                    THROW("commit fail! transaction rolled back");
+                }
+                return deleted;
+            } catch (...) {
+                conn.rollback();
+                throw;
+            }
+        }
+    );
+    // 8 - notify subscribers
+    // notify(schema.name, "DELETE");
+    return rowsaff ? *rowsaff : 0;
 }
-// void Storage::del(const std::string &table, const json &pk_data,
-//                   const std::string & /*user*/, const std::string & /*context*/)
-// {
-//     if (!pk_data.contains("id"))
-//         THROW("Delete requires PK field 'id'");
-//     std::string id = pk_data["id"];
-
-//     std::string sql = "DELETE FROM " + table + " WHERE id = ?;";
-//     // conn_->execDML(sql, {id});
-// }
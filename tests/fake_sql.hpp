@@ -74,10 +74,37 @@ public:
 
     CapturedStatement last; // inspect in tests: conn.last.sql, conn.last.binds, ...
 
+    // pipeline mode: off by default (backend without pipelining)
+    bool pipelining{false};
+    bool in_pipeline{false};
+    int pipeline_begins{0};
+    int pipeline_syncs{0};
+    int queued{0};      // statements queued since the last sync
+    int depth{0};       // nested pipeline_begin() calls: only the outermost pipeline_end() syncs
+    int window{0};      // > 0: sync every N queued statements (PgPipeline::kWindow)
+    int synced{0};      // rows collected by window syncs, reported by pipeline_end()
+
     std::unique_ptr<SQLStatement> prepare(const std::string& sql, int numParams) override ;
 
     void connect(const std::string&) override {}
     void disconnect() override {}
+    bool pipeline_begin() override {
+        if (!pipelining) return false;
+        if (in_pipeline) { ++depth; return true; }
+        in_pipeline = true;
+        ++pipeline_begins;
+        return true;
+    }
+    int pipeline_end() override {
+        if (!in_pipeline) return 0;
+        if (depth > 0) { --depth; return 0; } // the outer sync point collects
+        in_pipeline = false;
+        ++pipeline_syncs;
+        int rows = synced + queued;
+        queued = 0;
+        synced = 0;
+        return rows; // one row per queued statement
+    }
     bool begin() override { return true; }
     bool commit() override { return true; }
     void rollback() override {}
@@ -95,6 +122,14 @@ inline int FakeStatement::exec() {
         owner->last.binds      = binds;
         owner->last.exec_calls = exec_calls;
         owner->last.bind_calls = bind_calls;
+        if (owner->in_pipeline) { // reported by pipeline_end()
+            if (++owner->queued == owner->window) {
+                owner->synced += owner->queued;
+                owner->queued = 0;
+                ++owner->pipeline_syncs;
+            }
+            return 0;
+        }
     }
     return 1; // rows affected
 }
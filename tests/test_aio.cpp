@@ -0,0 +1,97 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+#include "catch.hpp"
+#include "aio.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+aio::Task<int> answer() { co_return 42; }
+
+aio::Task<int> add(int a) {
+    const int b = co_await answer();
+    co_return a + b;
+}
+
+aio::Task<int> fails() {
+    throw std::runtime_error("boom");
+    co_return 0;
+}
+
+aio::Task<int> sleepy(aio::EventLoop& loop, std::chrono::milliseconds d, int v) {
+    co_await loop.sleep_for(d);
+    co_return v;
+}
+
+aio::Task<std::string> read_pipe(aio::EventLoop& loop, int fd) {
+    co_await loop.readable(fd);
+    char buf[16];
+    const auto n = ::read(fd, buf, sizeof buf);
+    co_return std::string(buf, n > 0 ? static_cast<size_t>(n) : 0);
+}
+
+// resumes on @p loop from whatever thread posted it
+struct Handoff {
+    std::coroutine_handle<> h {};
+    std::atomic<bool> parked { false };
+
+    auto park() {
+        struct Awaiter {
+            Handoff* self;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> c) noexcept {
+                self->h = c;
+                self->parked = true;
+            }
+            void await_resume() const noexcept { }
+        };
+        return Awaiter { this };
+    }
+};
+}
+
+TEST_CASE("aio::Task: values, nesting and exceptions", "[aio]")
+{
+    aio::EventLoop loop;
+    CHECK(aio::run(loop, add(1)) == 43);
+    CHECK_THROWS_WITH(aio::run(loop, fails()), "boom");
+    CHECK(aio::EventLoop::current() == nullptr); // only inside the loop
+}
+
+TEST_CASE("aio::EventLoop: timers, fd readiness and cross-thread post", "[aio]")
+{
+    aio::EventLoop loop;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    CHECK(aio::run(loop, sleepy(loop, 20ms, 7)) == 7);
+    CHECK(std::chrono::steady_clock::now() - t0 >= 20ms);
+
+    int fds[2];
+    REQUIRE(::pipe(fds) == 0);
+    std::thread writer([&] {
+        std::this_thread::sleep_for(10ms);
+        [[maybe_unused]] auto n = ::write(fds[1], "ping", 4);
+    });
+    CHECK(aio::run(loop, read_pipe(loop, fds[0])) == "ping");
+    writer.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    Handoff handoff;
+    std::thread::id resumed_on;
+    auto waiter = [&]() -> aio::Task<void> {
+        co_await handoff.park();
+        resumed_on = std::this_thread::get_id();
+    };
+    std::thread poster([&] {
+        while (!handoff.parked) std::this_thread::sleep_for(1ms);
+        loop.post(handoff.h);
+    });
+    aio::run(loop, waiter());
+    poster.join();
+    CHECK(resumed_on == std::this_thread::get_id());
+}
@@ -3,6 +3,8 @@
 #include <condition_variable>
 #include <mutex>
 #include <optional>
+#include <source_location>
+#include <string>
 #include <thread>
 #include <vector>
 #include <memory>
@@ -114,7 +116,8 @@ public:
     FakePool(std::size_t readCap, std::size_t writeCap, bool writerPriority, AcquirePolicy pol)
         : read_cap_(readCap), write_cap_(writeCap), writer_priority_(writerPriority), policy_(pol) {}
 
-    AcquireResult acquire(DbIntent intent, std::chrono::milliseconds to = std::chrono::milliseconds::zero()) override
+    AcquireResult acquire(DbIntent intent, std::chrono::milliseconds to = std::chrono::milliseconds::zero(),
+                          std::source_location = std::source_location::current()) override
     {
         auto deadline = std::chrono::steady_clock::now() + (to.count() > 0 ? to : policy_.acquire_timeout);
         std::unique_lock<std::mutex> lk(mx_);
@@ -307,3 +310,523 @@ TEST_CASE("Shutdown wakes waiters (OO)", "[pool][shutdown][oo]")
     waiter.join();
     CHECK(saw_shutdown.load());
 }
+
+TEST_CASE("SplitDbPool: reads never queue behind writers", "[pool][split]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 100ms;
+    int ids = 0;
+    auto factory = [&] { return std::make_unique<FakeConn>(++ids); };
+
+    auto writer = std::make_unique<DbPool>(1, "primary", factory, pol); // conn id 1
+    std::vector<std::unique_ptr<pool::IDbPool>> readers;
+    readers.push_back(std::make_unique<DbPool>(2, "replica-1", factory, pol));
+    readers.push_back(std::make_unique<DbPool>(2, "replica-2", factory, pol));
+    SplitDbPool pool(std::move(writer), std::move(readers));
+    CHECK(pool.stats().size == 0u); // connections open on demand
+
+    auto w = pool.acquire(DbIntent::Write);
+    REQUIRE(w.ok);
+    CHECK(static_cast<FakeConn&>(w.lease.conn()).id() == 1);
+    CHECK_FALSE(pool.acquire(DbIntent::Write).ok); // the only writer is busy
+
+    // all four readers are available while the writer is held, round-robin over both replicas
+    std::vector<Lease> held;
+    for (int i = 0; i < 4; ++i) {
+        auto r = pool.acquire(DbIntent::Read);
+        REQUIRE(r.ok);
+        CHECK(static_cast<FakeConn&>(r.lease.conn()).id() != 1);
+        held.push_back(std::move(r.lease));
+    }
+    CHECK(pool.stats(DbIntent::Read).in_use == 4u);
+    CHECK(pool.stats().size == 5u);
+    CHECK(pool.stats(DbIntent::Write).in_use == 1u);
+
+    held.clear();
+    CHECK(pool.stats().in_use == 1u);
+}
+
+TEST_CASE("SplitDbPool: without readers reads share the writer", "[pool][split]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 50ms;
+    SplitDbPool pool(std::make_unique<DbPool>(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol));
+
+    auto w = pool.acquire(DbIntent::Write);
+    REQUIRE(w.ok);
+    auto r = pool.acquire(DbIntent::Read);
+    CHECK_FALSE(r.ok);
+    CHECK(r.error == PoolAcquireError::Timeout);
+}
+
+TEST_CASE("LockFreeDbPool: acquire/release, timeout and wakeup", "[pool][lockfree]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 50ms;
+    int ids = 0;
+    LockFreeDbPool pool(2, "db", [&] { return std::make_unique<FakeConn>(++ids); }, pol);
+
+    {
+        auto a = pool.acquire(DbIntent::Read);
+        auto b = pool.acquire(DbIntent::Write);
+        REQUIRE(a.ok);
+        REQUIRE(b.ok);
+        CHECK(&a.lease.conn() != &b.lease.conn());
+        CHECK(pool.stats().in_use == 2u);
+
+        auto c = pool.acquire(DbIntent::Read);
+        REQUIRE_FALSE(c.ok);
+        CHECK(c.error == PoolAcquireError::Timeout);
+
+        // a waiter is woken by the release
+        std::atomic<bool> got{false};
+        std::thread waiter([&] { got = pool.acquire(DbIntent::Read, 2000ms).ok; });
+        std::this_thread::sleep_for(30ms);
+        a.lease = Lease(nullptr, nullptr, DbIntent::Read); // release a
+        waiter.join();
+        CHECK(got.load());
+    }
+    CHECK(pool.stats().in_use == 0u);
+    CHECK(pool.stats().waiters == 0u);
+
+    pool.shutdown();
+    auto s = pool.acquire(DbIntent::Read);
+    REQUIRE_FALSE(s.ok);
+    CHECK(s.error == PoolAcquireError::Shutdown);
+}
+
+TEST_CASE("LockFreeDbPool: a connection is never leased twice under contention", "[pool][lockfree][stress]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 5s;
+    int ids = 0;
+    LockFreeDbPool pool(4, "db", [&] { return std::make_unique<FakeConn>(++ids); }, pol);
+
+    std::vector<std::atomic<int>> owners(5);
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 16; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 2000; ++i) {
+                auto r = pool.acquire(DbIntent::Write);
+                if (!r.ok) { ++failures; continue; }
+                int id = static_cast<FakeConn&>(r.lease.conn()).id();
+                if (owners[id].fetch_add(1) != 0) ++failures; // someone else holds it
+                owners[id].fetch_sub(1);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    CHECK(failures.load() == 0);
+    CHECK(pool.stats().in_use == 0u);
+}
+
+TEST_CASE("DbPool: lazy connect, waiter-driven growth up to max_size", "[pool][elastic]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 50ms;
+    pol.min_size = 1;
+    std::atomic<int> ids{0};
+    DbPool pool(3, "db", [&] { return std::make_unique<FakeConn>(++ids); }, pol);
+    CHECK(ids.load() == 1); // only min_size opened up front
+    CHECK(pool.stats().size == 1u);
+
+    auto a = pool.acquire(DbIntent::Write);
+    REQUIRE(a.ok);
+    CHECK(ids.load() == 1); // reused the idle one
+    auto b = pool.acquire(DbIntent::Write);
+    auto c = pool.acquire(DbIntent::Write);
+    REQUIRE((b.ok && c.ok));
+    CHECK(ids.load() == 3);
+    CHECK(pool.stats().size == 3u);
+
+    auto d = pool.acquire(DbIntent::Write); // at max_size: waits, then times out
+    REQUIRE_FALSE(d.ok);
+    CHECK(d.error == PoolAcquireError::Timeout);
+    CHECK(ids.load() == 3);
+}
+
+TEST_CASE("DbPool: idle connections above min_size are reaped", "[pool][elastic]")
+{
+    AcquirePolicy pol;
+    pol.min_size = 1;
+    pol.idle_timeout = 20ms;
+    std::atomic<int> ids{0};
+    DbPool pool(4, "db", [&] { return std::make_unique<FakeConn>(++ids); }, pol);
+    {
+        std::vector<Lease> held;
+        for (int i = 0; i < 4; ++i) held.push_back(std::move(pool.acquire(DbIntent::Read).lease));
+        CHECK(pool.stats().size == 4u);
+    }
+    CHECK(pool.stats().size == 4u); // idle, not yet expired
+    std::this_thread::sleep_for(40ms);
+    pool.reap();
+    CHECK(pool.stats().size == 1u);  // back to min_size
+    CHECK(pool.acquire(DbIntent::Read).ok);
+}
+
+TEST_CASE("DbPool: a failed connect is reported to the caller and frees the slot", "[pool][elastic]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 50ms;
+    pol.reconnect_backoff_min = 1ms; // the retry below waits out the backoff
+    bool fail = true;
+    DbPool pool(1, "db", [&]() -> PSQLConnection {
+        if (fail) THROW("connect refused");
+        return std::make_unique<FakeConn>(1);
+    }, pol);
+
+    REQUIRE_THROWS(pool.acquire(DbIntent::Write));
+    CHECK(pool.stats().size == 0u);
+    fail = false;
+    CHECK(pool.acquire(DbIntent::Write).ok);
+}
+
+TEST_CASE("DbPool: overdue leases are reported with their call site and cancelled", "[pool][watchdog]")
+{
+    struct CancelConn : FakeConn {
+        using FakeConn::FakeConn;
+        void cancel() override { ++cancels; }
+        std::atomic<int> cancels{0};
+    };
+    std::mutex mx;
+    std::vector<pool::LeaseInfo> reported;
+
+    AcquirePolicy pol;
+    pol.max_lease_time = 20ms;
+    pol.cancel_overdue = true;
+    pol.on_overdue = [&](const pool::LeaseInfo& li) { std::lock_guard<std::mutex> lk(mx); reported.push_back(li); };
+    DbPool pool(2, "db", [] { return std::make_unique<CancelConn>(1); }, pol);
+
+    auto quick = pool.acquire(DbIntent::Read);
+    const unsigned line = __LINE__ + 1;
+    auto stuck = pool.acquire(DbIntent::Write);
+    REQUIRE((quick.ok && stuck.ok));
+    quick.lease = Lease(nullptr, nullptr, DbIntent::Read); // released in time
+
+    auto snap = pool.leases();
+    REQUIRE(snap.size() == 1u);
+    CHECK(snap[0].intent == DbIntent::Write);
+    CHECK(snap[0].where.line() == line);
+    CHECK(std::string(snap[0].where.file_name()).find("test_dbpool.cpp") != std::string::npos);
+
+    for (int i = 0; i < 100; ++i) {
+        { std::lock_guard<std::mutex> lk(mx); if (!reported.empty()) break; }
+        std::this_thread::sleep_for(5ms);
+    }
+    std::this_thread::sleep_for(30ms); // a second sweep must not report it again
+    {
+        std::lock_guard<std::mutex> lk(mx);
+        REQUIRE(reported.size() == 1u);
+        CHECK(reported[0].id == snap[0].id);
+        CHECK(reported[0].held >= 20ms);
+    }
+    CHECK(static_cast<CancelConn&>(stuck.lease.conn()).cancels.load() == 1);
+    CHECK(pool.leases()[0].overdue);
+
+    stuck.lease = Lease(nullptr, nullptr, DbIntent::Read);
+    CHECK(pool.leases().empty());
+}
+
+namespace {
+// FakeConn whose health the test controls
+struct HealthConn : FakeConn {
+    using FakeConn::FakeConn;
+    bool healthy() override { return alive.load(); }
+    bool ping() override { ++pings; return alive.load() && answers.load(); }
+    std::atomic<bool> alive{true};
+    std::atomic<bool> answers{true};
+    std::atomic<int> pings{0};
+};
+}
+
+TEST_CASE("DbPool: broken connections are dropped and replaced", "[pool][health]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 50ms;
+    std::atomic<int> ids{0};
+    DbPool pool(1, "db", [&] { return std::make_unique<HealthConn>(++ids); }, pol);
+
+    {
+        auto a = pool.acquire(DbIntent::Write);
+        REQUIRE(a.ok);
+        static_cast<HealthConn&>(a.lease.conn()).alive = false; // backend died while leased
+    }
+    CHECK(pool.stats().size == 0u); // not put back
+
+    auto b = pool.acquire(DbIntent::Write);
+    REQUIRE(b.ok);
+    CHECK(static_cast<HealthConn&>(b.lease.conn()).id() == 2);
+}
+
+TEST_CASE("DbPool: idle connections are pinged before reuse", "[pool][health]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 50ms;
+    pol.ping_after_idle = 10ms;
+    std::atomic<int> ids{0};
+    DbPool pool(2, "db", [&] { return std::make_unique<HealthConn>(++ids); }, pol);
+
+    HealthConn* first = nullptr;
+    {
+        auto a = pool.acquire(DbIntent::Read);
+        first = &static_cast<HealthConn&>(a.lease.conn());
+    }
+    { auto again = pool.acquire(DbIntent::Read); } // fresh: no ping
+    CHECK(first->pings.load() == 0);
+
+    std::this_thread::sleep_for(20ms);
+    first->answers = false; // e.g. failover: socket still looks fine, server is gone
+    auto b = pool.acquire(DbIntent::Read);
+    REQUIRE(b.ok);
+    CHECK(static_cast<HealthConn&>(b.lease.conn()).id() == 2); // dead one replaced
+    CHECK(pool.stats().size == 1u);
+}
+
+TEST_CASE("DbPool: failed reconnects back off exponentially", "[pool][health]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 30ms;
+    pol.reconnect_backoff_min = 100ms;
+    std::atomic<int> attempts{0};
+    std::atomic<bool> down{true};
+    DbPool pool(1, "db", [&]() -> PSQLConnection {
+        ++attempts;
+        if (down) THROW("server down");
+        return std::make_unique<HealthConn>(1);
+    }, pol);
+
+    REQUIRE_THROWS(pool.acquire(DbIntent::Write));
+    CHECK(attempts.load() == 1);
+
+    // inside the backoff window: no connect storm, callers time out
+    auto r = pool.acquire(DbIntent::Write);
+    CHECK_FALSE(r.ok);
+    CHECK(r.error == PoolAcquireError::Timeout);
+    CHECK(attempts.load() == 1);
+
+    down = false;
+    std::this_thread::sleep_for(100ms);
+    CHECK(pool.acquire(DbIntent::Write).ok);
+    CHECK(attempts.load() == 2);
+}
+
+TEST_CASE("Histogram: log-linear buckets and percentiles", "[pool][metrics]")
+{
+    using L = pool::HistogramLayout;
+    for (uint64_t v : { 0ull, 1ull, 15ull, 16ull, 17ull, 100ull, 1000ull, 123456ull, (1ull << 31) + 5 }) {
+        const auto i = L::index(v);
+        CHECK(L::lower(i) <= v);
+        CHECK(v <= L::upper(i));
+        CHECK(L::upper(i) - L::lower(i) <= v / 16); // ~6% relative error
+    }
+    CHECK(L::index(1ull << 40) == L::kBuckets - 1);
+
+    pool::Histogram h;
+    for (uint64_t v = 1; v <= 1000; ++v) h.record(v);
+    h.record(5ms);
+    auto s = h.snapshot();
+    CHECK(s.count == 1001u);
+    CHECK(s.max == 5000u);
+    CHECK(s.percentile(0.5) >= 500u);
+    CHECK(s.percentile(0.5) <= 540u);
+    CHECK(s.percentile(0.99) >= 990u);
+    CHECK(s.percentile(1.0) == 5000u);
+    CHECK(pool::HistogramSnapshot {}.percentile(0.5) == 0u);
+
+    auto merged = s;
+    merged.merge(s);
+    CHECK(merged.count == 2002u);
+    CHECK(merged.percentile(0.5) == s.percentile(0.5));
+}
+
+TEST_CASE("DbPool: wait/hold histograms and acquire counters", "[pool][metrics]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 20ms;
+    int ids = 0;
+    auto factory = [&] { return std::make_unique<FakeConn>(++ids); };
+    auto writer = std::make_unique<DbPool>(1, "primary", factory, pol);
+    std::vector<std::unique_ptr<pool::IDbPool>> readers;
+    readers.push_back(std::make_unique<DbPool>(1, "replica", factory, pol));
+    SplitDbPool pool(std::move(writer), std::move(readers));
+
+    {
+        auto w = pool.acquire(DbIntent::Write);
+        REQUIRE(w.ok);
+        CHECK_FALSE(pool.acquire(DbIntent::Write).ok); // timeout
+        std::this_thread::sleep_for(10ms);
+    }
+    for (int i = 0; i < 3; ++i) REQUIRE(pool.acquire(DbIntent::Read).ok);
+
+    auto s = pool.stats();
+    CHECK(s.acquired == 4u);
+    CHECK(s.timeouts == 1u);
+    CHECK(s.shutdowns == 0u);
+    CHECK(pool.stats(DbIntent::Read).acquired == 3u);
+
+    auto l = pool.latency();
+    CHECK(l.wait_of(DbIntent::Write).count == 1u);
+    CHECK(l.wait_of(DbIntent::Read).count == 3u);
+    CHECK(l.hold_of(DbIntent::Read).count == 3u);
+    REQUIRE(l.hold_of(DbIntent::Write).count == 1u);
+    CHECK(l.hold_of(DbIntent::Write).max >= 30000u); // held across the 20 ms timeout + 10 ms sleep
+
+    pool.shutdown();
+    CHECK_FALSE(pool.acquire(DbIntent::Read).ok);
+    CHECK(pool.stats().shutdowns == 1u);
+}
+
+TEST_CASE("LockFreeDbPool: wait/hold histograms and acquire counters", "[pool][metrics][lockfree]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 10ms;
+    LockFreeDbPool pool(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol);
+    {
+        auto a = pool.acquire(DbIntent::Read);
+        REQUIRE(a.ok);
+        CHECK_FALSE(pool.acquire(DbIntent::Read).ok);
+    }
+    auto s = pool.stats();
+    CHECK(s.acquired == 1u);
+    CHECK(s.timeouts == 1u);
+    auto l = pool.latency();
+    CHECK(l.wait_of(DbIntent::Read).count == 1u);
+    CHECK(l.hold_of(DbIntent::Read).max >= 10000u);
+    CHECK(l.hold_of(DbIntent::Write).count == 0u);
+}
+
+namespace {
+// Holds the only connection of @p pool, queues one acquire per entry of @p intents (in that order),
+// then lets them through one at a time; returns the order in which they were served
+std::vector<int> served_order(DbPool& pool, const std::vector<DbIntent>& intents)
+{
+    auto first = pool.acquire(DbIntent::Write);
+    REQUIRE(first.ok);
+
+    std::mutex mx;
+    std::vector<int> order;
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < intents.size(); ++i) {
+        threads.emplace_back([&, i] {
+            auto r = pool.acquire(intents[i]);
+            REQUIRE(r.ok);
+            std::lock_guard<std::mutex> lk(mx);
+            order.push_back(static_cast<int>(i));
+        });
+        while (pool.stats().waiters != i + 1) std::this_thread::sleep_for(1ms); // queued, in order
+    }
+    first.lease = Lease { nullptr, nullptr, DbIntent::Read }; // release
+    for (auto& t : threads) t.join();
+    return order;
+}
+}
+
+TEST_CASE("DbPool: waiters are served in arrival order", "[pool][fairness]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 2s;
+    DbPool pool(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol);
+
+    auto order = served_order(pool, { DbIntent::Read, DbIntent::Write, DbIntent::Read, DbIntent::Write, DbIntent::Read });
+    CHECK(order == std::vector<int> { 0, 1, 2, 3, 4 });
+    CHECK(pool.stats().timeouts == 0u);
+}
+
+TEST_CASE("DbPool: wait_priority serves one intent first, FIFO within each", "[pool][fairness]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 2s;
+    const std::vector<DbIntent> intents { DbIntent::Read, DbIntent::Write, DbIntent::Read, DbIntent::Write };
+
+    pol.wait_priority = pool::WaitPriority::Writes;
+    DbPool writes_first(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol);
+    CHECK(served_order(writes_first, intents) == std::vector<int> { 1, 3, 0, 2 });
+
+    pol.wait_priority = pool::WaitPriority::Reads;
+    DbPool reads_first(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol);
+    CHECK(served_order(reads_first, intents) == std::vector<int> { 0, 2, 1, 3 });
+}
+
+TEST_CASE("DbPool: a newcomer does not overtake a queued waiter", "[pool][fairness]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 2s;
+    DbPool pool(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol);
+
+    auto held = pool.acquire(DbIntent::Write);
+    REQUIRE(held.ok);
+    std::atomic<bool> got { false }, done { false };
+    std::thread waiter([&] {
+        auto r = pool.acquire(DbIntent::Read);
+        got = r.ok;
+        while (!done) std::this_thread::sleep_for(1ms);
+    });
+    while (pool.stats().waiters != 1) std::this_thread::sleep_for(1ms);
+
+    held.lease = Lease { nullptr, nullptr, DbIntent::Read }; // release, then try to grab it right back
+    auto late = pool.acquire(DbIntent::Write, 30ms);
+    CHECK_FALSE(late.ok); // the queued reader is served first
+    done = true;
+    waiter.join();
+    CHECK(got.load());
+}
+
+TEST_CASE("DbPool: co_acquire parks coroutines in the same FIFO queue", "[pool][aio]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 2s;
+    DbPool pool(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol);
+    aio::EventLoop loop;
+
+    auto held = pool.acquire(DbIntent::Write);
+    REQUIRE(held.ok);
+
+    std::vector<int> order;
+    int done = 0;
+    auto worker = [&](int id, DbIntent intent) -> aio::Task<void> {
+        auto r = co_await pool.co_acquire(intent);
+        REQUIRE(r.ok);
+        order.push_back(id);
+        co_await loop.sleep_for(2ms); // hold it across a suspension
+        ++done;
+    };
+    for (int i = 0; i < 4; ++i) aio::spawn(loop, worker(i, i % 2 ? DbIntent::Write : DbIntent::Read));
+
+    // four coroutines wait on one thread; a plain thread releases the first lease
+    std::thread releaser([&] {
+        while (pool.stats().waiters != 4) std::this_thread::sleep_for(1ms);
+        held.lease = Lease { nullptr, nullptr, DbIntent::Read };
+    });
+    loop.run_until([&] { return done == 4; });
+    releaser.join();
+    CHECK(order == std::vector<int> { 0, 1, 2, 3 });
+    CHECK(pool.stats().acquired == 5u);
+}
+
+TEST_CASE("DbPool: co_acquire times out without blocking the loop", "[pool][aio]")
+{
+    AcquirePolicy pol;
+    pol.acquire_timeout = 20ms;
+    DbPool pool(1, "db", [] { return std::make_unique<FakeConn>(1); }, pol);
+    aio::EventLoop loop;
+    auto held = pool.acquire(DbIntent::Write);
+    REQUIRE(held.ok);
+
+    bool ticked = false;
+    auto ticker = [&]() -> aio::Task<void> {
+        co_await loop.sleep_for(5ms);
+        ticked = true; // the loop kept running while the acquire waited
+    };
+    aio::spawn(loop, ticker());
+    auto r = aio::run(loop, pool.co_acquire(DbIntent::Read));
+    CHECK_FALSE(r.ok);
+    CHECK(r.error == PoolAcquireError::Timeout);
+    CHECK(ticked);
+    CHECK(pool.stats().waiters == 0u);
+
+    // outside a loop it is a plain blocking acquire
+    held.lease = Lease { nullptr, nullptr, DbIntent::Read };
+    auto sync = pool.co_acquire(DbIntent::Read);
+    CHECK(aio::run(loop, std::move(sync)).ok);
+}
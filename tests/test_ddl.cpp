@@ -45,8 +45,24 @@ TEST_CASE("DDL covers all types and features", "[ddl]") {
     REQUIRE(ddl_pg.find("profile JSON") != std::string::npos);
     REQUIRE(ddl_pg.find("last_seen TIMESTAMP") != std::string::npos);
     REQUIRE(ddl_pg.find("PRIMARY KEY (id)") != std::string::npos);
-    REQUIRE(ddl_pg.find("CREATE UNIQUE INDEX idx_email ON users (email);") != std::string::npos);
-    REQUIRE(ddl_pg.find("CREATE INDEX idx_score_active ON users (score, active);") != std::string::npos);
+    REQUIRE(ddl_pg.find("CREATE UNIQUE INDEX IF NOT EXISTS idx_email ON users (email);") != std::string::npos);
+    REQUIRE(ddl_pg.find("CREATE INDEX IF NOT EXISTS idx_score_active ON users (score, active);") != std::string::npos);
+}
+
+TEST_CASE("DDL: Postgres integer ids are BIGINT", "[ddl]") {
+    OrmSchema schema = load_schema(R"({
+        "name": "events",
+        "type": "object",
+        "properties": {
+            "id":    { "type": "integer", "idprop": true, "idkind": "snowflake" },
+            "count": { "type": "integer" }
+        }
+    })");
+    PgDDLVisitor pgvis;
+    std::string ddl_pg = pgvis.generate_ddl(schema);
+    REQUIRE(ddl_pg.find("id BIGINT") != std::string::npos);    // snowflake ids are int64
+    REQUIRE(ddl_pg.find("count INTEGER") != std::string::npos);
+    REQUIRE(pgvis.sql_type(schema.fields["id"]) == "BIGINT"); // bulk_load's binary COPY width
 }
 
 TEST_CASE("DDL fails on duplicate fields", "[ddl][error]") {
@@ -1,10 +1,12 @@
 
 #include "catch.hpp"
+#include <filesystem>
 
 #include "ddl_visitor.hpp"
 #include "dml_visitor.hpp"
 #include "storage.hpp"
 #include "fake_sql.hpp"
+#include "schemaboss.hpp"
 
 // using Json = Json;
 
@@ -61,7 +63,7 @@ static Storage make_storage_for(Dialect d) {
     if (d == Dialect::Postgres){
         return Storage("host=localhost port=5432 dbname=orm user=postgres password=brlnd044", d);
     } else /*if (d == Dialect::SQLite)*/ {
-        return Storage("./database.db", d);
+        return Storage((std::filesystem::temp_directory_path() / "ecm_test_dml.db").string(), d);
     }
 }
 
@@ -241,3 +243,287 @@ TEST_CASE("Bind types: date/time/datetime/timestamp/Json/bool/num/str/bin (SQLit
     REQUIRE(conn.last.binds[8].type == PropType::String   ); // ts
     REQUIRE(conn.last.binds[9].type == PropType::Integer  ); // PK
 }
+
+// Array payload: same-shape rows go out as ONE multi-row INSERT; PK generated per row and bound last
+TEST_CASE("INSERT batch: same-shape array rows share one statement (SQLite)", "[dml][insert][batch][sqlite]") {
+    OrmSchema schema = make_user_schema();
+    jdoc doc;
+    jhlp::parse_str(R"([{"name":"Alice","age":30},{"name":"Bob","age":31},{"name":"Carol","age":32}])", doc);
+
+    Storage st = make_storage_for(Dialect::SQLite);
+    FakeSQLConnection conn;
+
+    int rows = st.insert(conn, schema, doc, "");
+    REQUIRE(rows == 3);
+    REQUIRE(conn.last.exec_calls == 1);
+    REQUIRE(conn.last.sql == "INSERT INTO users (name, age, id) VALUES (?1, ?2, ?3), (?4, ?5, ?6), (?7, ?8, ?9);");
+    REQUIRE(conn.last.binds.size() == 9);
+    REQUIRE(conn.last.binds[3].idx == 4);
+    REQUIRE(conn.last.binds[3].valuecast == "Bob");
+    REQUIRE(conn.last.binds[8].idx == 9);
+    REQUIRE(conn.last.binds[8].type == PropType::Integer); // PK of the last row
+}
+
+// Batches split on shape change, INSERT/UPSERT change and batch_size
+TEST_CASE("INSERT batch: split by shape, upsert decision and batch size (SQLite)", "[dml][insert][batch][sqlite]") {
+    OrmSchema schema = make_user_schema();
+    jdoc doc;
+    jhlp::parse_str(R"([
+        {"name":"A","age":1}, {"name":"B","age":2}, {"name":"C","age":3},
+        {"id": 7, "name":"D"}, {"id": 8, "name":"E"}
+    ])", doc);
+
+    Storage st = make_storage_for(Dialect::SQLite);
+    st.batch_size(2);
+    FakeSQLConnection conn;
+
+    int rows = st.insert(conn, schema, doc, "");
+    REQUIRE(rows == 5);
+    // last batch: the two upserts together
+    REQUIRE(conn.last.sql == "INSERT INTO users (id, name) VALUES (?1, ?2), (?3, ?4) ON CONFLICT(id) DO UPDATE SET name = excluded.name;");
+    REQUIRE(conn.last.binds.size() == 4);
+    REQUIRE(conn.last.binds[2].valuecast == "8");
+}
+
+TEST_CASE("UPSERT batch: a repeated PK starts a new statement (Postgres)", "[dml][upsert][batch][pg]") {
+    OrmSchema schema = make_user_schema();
+    PgDMLVisitor pg;
+    jdoc doc;
+    jhlp::parse_str(R"({"id": 1, "name": "x"})", doc);
+    auto sql = pg.upsert_batch(schema, doc, 2);
+    REQUIRE(sql.first == "INSERT INTO users (id, name) VALUES ($1, $2), ($3, $4) ON CONFLICT(id) DO UPDATE SET name = excluded.name;");
+    REQUIRE(sql.second == 4);
+
+    jdoc rows;
+    jhlp::parse_str(R"([{"id": 1, "name": "x"}, {"id": 1, "name": "y"}])", rows);
+    Storage st = make_storage_for(Dialect::SQLite);
+    FakeSQLConnection conn;
+    REQUIRE(st.insert(conn, schema, rows, "") == 2);
+    REQUIRE(conn.last.binds.size() == 2); // second row went alone
+    REQUIRE(conn.last.binds[1].valuecast == "y");
+
+    // keys compared in place, by value: 2 and 2.0 are the same PK
+    jdoc mixed;
+    jhlp::parse_str(R"([{"id": 2, "name": "a"}, {"id": "3", "name": "b"}, {"id": 2.0, "name": "c"}])", mixed);
+    REQUIRE(st.insert(conn, schema, mixed, "") == 3);
+    REQUIRE(conn.last.binds.size() == 2);
+    REQUIRE(conn.last.binds[1].valuecast == "c");
+}
+
+TEST_CASE("INSERT batch: generated UUIDv7 keys are bound per row", "[dml][insert][batch][sqlite]") {
+    OrmSchema schema = make_user_schema();
+    schema.fields["id"].type = PropType::String;
+    schema.fields["id"].id_kind = IdKind::UUIDv7;
+    jdoc doc;
+    jhlp::parse_str(R"([{"name":"A"},{"name":"B"},{"name":"C"}])", doc);
+
+    Storage st = make_storage_for(Dialect::SQLite);
+    st.batch_size(2);
+    FakeSQLConnection conn;
+    REQUIRE(st.insert(conn, schema, doc, "") == 3);
+    REQUIRE(conn.last.binds.size() == 2); // last batch: one row
+    REQUIRE(conn.last.binds[1].valuecast.size() == 26);
+}
+
+TEST_CASE("batch_rows caps rows by the dialect parameter limit", "[dml][batch]") {
+    SqliteDMLVisitor sq;
+    PgDMLVisitor pg;
+    REQUIRE(sq.batch_rows(3, 100) == 100);
+    REQUIRE(sq.batch_rows(10, 100000) == sq.max_params() / 10);
+    REQUIRE(pg.batch_rows(10, 100000) == pg.max_params() / 10);
+    REQUIRE(sq.batch_rows(3, 0) == 1);
+    REQUIRE(sq.batch_rows(10, 100000, 50) == 5); // the connection's limit wins
+    REQUIRE_THROWS(sq.batch_rows(10, 100, 9));
+}
+
+TEST_CASE("BindPlan: one plan per key shape, cached on the schema", "[dml][bindplan]") {
+    OrmSchema schema = make_user_schema();
+    jdoc a, b, c;
+    jhlp::parse_str(R"({"name":"A","extra":1,"id":5})", a);
+    jhlp::parse_str(R"({"name":"B","extra":2,"id":0})", b);
+    jhlp::parse_str(R"({"id":5,"name":"A"})", c);
+
+    auto pa = schema.bind_plan(a);
+    REQUIRE(pa->cols.size() == 2); // "extra" is not a column
+    REQUIRE(pa->cols[0].member == 0);
+    REQUIRE(pa->cols[1].member == 2);
+    REQUIRE(pa->pk_col == 1);
+    REQUIRE(pa->pk->name == "id");
+    REQUIRE(pa->params(true) == 2);
+    REQUIRE(pa->pk_valid(a));
+    REQUIRE_FALSE(pa->pk_valid(b)); // 0: generated
+
+    REQUIRE(schema.bind_plan(b) == pa); // same keys, same order
+    REQUIRE(schema.bind_plan(c) != pa);
+    REQUIRE_FALSE(pa->matches(c));
+    REQUIRE(schema.bind_plans() == 2);
+
+    OrmSchema copy = schema; // plans point into the source's fields
+    REQUIRE(copy.bind_plans() == 0);
+    REQUIRE(copy.bind_plan(a)->pk == copy.pkprop());
+}
+
+TEST_CASE("DML SQL cache: one entry per schema version, key shape, op and rows", "[dml][sqlcache]") {
+    OrmSchema schema = make_user_schema();
+    SqliteDMLVisitor sq;
+    jdoc a, b, c;
+    jhlp::parse_str(R"({"name":"A","age":1})", a);
+    jhlp::parse_str(R"({"name":"B","age":2})", b);
+    jhlp::parse_str(R"({"age":3,"name":"C"})", c);
+
+    auto s1 = sq.sql(DmlOp::InsertBatch, schema, a, 2);
+    REQUIRE(s1->sql == "INSERT INTO users (name, age, id) VALUES (?1, ?2, ?3), (?4, ?5, ?6);");
+    REQUIRE(s1->params == 6);
+    REQUIRE(sq.sql(DmlOp::InsertBatch, schema, b, 2) == s1);     // same shape: interned
+    REQUIRE(sq.sql(DmlOp::InsertBatch, schema, a, 3) != s1);     // rows
+    REQUIRE(sq.sql(DmlOp::InsertBatch, schema, c, 2)->sql == "INSERT INTO users (age, name, id) VALUES (?1, ?2, ?3), (?4, ?5, ?6);");
+    REQUIRE(sq.sql(DmlOp::Remove, schema, a) == sq.sql(DmlOp::Remove, schema, c));
+    REQUIRE(sq.cached_sql() == 4);
+
+    OrmSchema v2 = make_user_schema();
+    v2.version = 2;
+    REQUIRE(sq.sql(DmlOp::InsertBatch, v2, a, 2) != s1);
+
+    // a SchemaBoss retire listener drops the replaced version only, once its last lease ends
+    SchemaBoss boss;
+    auto migrate = [](const OrmSchema*, const OrmSchema&) { return true; };
+    boss.add_retire_listener([&](const OrmSchema& retired) { sq.invalidate(retired.name, retired.version); });
+    boss.add(schema);
+    auto old = boss.get("users", migrate);
+    boss.add(v2);
+    REQUIRE(boss.get("users", migrate)->version == 2);
+    REQUIRE(sq.cached_sql() == 5); // still leased
+    old.release();
+    REQUIRE(sq.cached_sql() == 1);
+    REQUIRE(s1->sql.size() > 0); // entries already handed out stay valid
+}
+
+TEST_CASE("Storage::addSchema: a newer version replaces the catalog entry and its cached SQL", "[dml][sqlcache]") {
+    Storage st = make_storage_for(Dialect::SQLite);
+    FakeSQLConnection conn;
+    OrmSchema v1 = make_user_schema(), v2 = make_user_schema(), old = make_user_schema();
+    v2.version = 2;
+    old.version = 0;
+    REQUIRE(st.addSchema(v1));
+
+    jdoc row;
+    jhlp::parse_str(R"({"name":"A","age":1})", row);
+    const size_t before = st.cached_sql();
+    REQUIRE(st.insert(conn, *st.catalog()->at("users"), row, "") == 1);
+    REQUIRE(st.cached_sql() == before + 1);
+
+    REQUIRE(st.addSchema(old)); // lower version: ignored
+    REQUIRE(st.catalog()->at("users")->version == 1);
+    REQUIRE(st.cached_sql() == before + 1);
+
+    REQUIRE(st.addSchema(v2));
+    REQUIRE(st.catalog()->at("users")->version == 2);
+    REQUIRE(st.cached_sql() == before); // version 1 entries dropped
+    REQUIRE(st.insert(conn, *st.catalog()->at("users"), row, "") == 1);
+    REQUIRE(st.cached_sql() == before + 1);
+}
+
+TEST_CASE("Storage catalog: a replaced version keeps its SQL until its last holder ends", "[dml][sqlcache]") {
+    Storage st = make_storage_for(Dialect::SQLite);
+    FakeSQLConnection conn;
+    OrmSchema v1 = make_user_schema(), v2 = make_user_schema();
+    v2.version = 2;
+    REQUIRE(st.addSchema(v1));
+
+    jdoc row;
+    jhlp::parse_str(R"({"name":"A","age":1})", row);
+    auto held = st.catalog(); // a request still on version 1
+    OrmSchema& on_v1 = *held->at("users");
+    const size_t before = st.cached_sql();
+    REQUIRE(st.insert(conn, on_v1, row, "") == 1);
+
+    REQUIRE(st.addSchema(v2));
+    REQUIRE(st.catalog()->at("users")->version == 2);
+    REQUIRE(st.insert(conn, on_v1, row, "") == 1); // still served from the cache
+    REQUIRE(st.cached_sql() == before + 1);
+    held.reset();
+    REQUIRE(st.cached_sql() == before);
+}
+
+TEST_CASE("UPDATE array: every row bound from its own values", "[dml][update][sqlite]") {
+    OrmSchema schema = make_user_schema();
+    jdoc doc;
+    jhlp::parse_str(R"([{"id": 1, "name":"A","age":10},{"id": 2, "name":"B","age":20}])", doc);
+
+    Storage st = make_storage_for(Dialect::SQLite);
+    FakeSQLConnection conn;
+
+    REQUIRE(st.update(conn, schema, doc, "") == 2);
+    REQUIRE(conn.last.sql == "UPDATE users SET name = ?1, age = ?2 WHERE id = ?3;");
+    REQUIRE(conn.last.exec_calls == 2); // one statement, re-bound per row
+    REQUIRE(conn.last.binds.size() == 6);
+    REQUIRE(conn.last.binds[3].valuecast == "B");
+    REQUIRE(conn.last.binds[4].valuecast == "20");
+    REQUIRE(conn.last.binds[5].idx == 3);
+    REQUIRE(conn.last.binds[5].valuecast == "2"); // PK last
+    REQUIRE(conn.pipeline_begins == 0);
+}
+
+TEST_CASE("Pipeline: arrays are queued and collected once at the sync point", "[dml][pipeline][pg]") {
+    OrmSchema schema = make_user_schema();
+    Storage st = make_storage_for(Dialect::SQLite);
+    st.batch_size(1); // one statement per row
+    FakeSQLConnection conn;
+    conn.pipelining = true;
+
+    jdoc ins;
+    jhlp::parse_str(R"([{"name":"A","age":1},{"name":"B","age":2},{"name":"C","age":3}])", ins);
+    REQUIRE(st.insert(conn, schema, ins, "") == 3);
+    REQUIRE(conn.pipeline_begins == 1);
+    REQUIRE(conn.pipeline_syncs == 1);
+    REQUIRE_FALSE(conn.in_pipeline);
+
+    jdoc upd;
+    jhlp::parse_str(R"([{"id": 1, "age": 5},{"id": 2, "age": 6},{"id": 3, "name": "Z"}])", upd);
+    REQUIRE(st.update(conn, schema, upd, "") == 3); // rows reported by pipeline_end()
+    REQUIRE(conn.pipeline_begins == 2);
+    REQUIRE(conn.pipeline_syncs == 2);
+    REQUIRE(conn.last.sql == "UPDATE users SET name = ?1 WHERE id = ?2;"); // shape change re-prepares
+
+    // a single object is not pipelined
+    jdoc one;
+    jhlp::parse_str(R"({"id": 1, "age": 7})", one);
+    REQUIRE(st.update(conn, schema, one, "") == 1);
+    REQUIRE(conn.pipeline_begins == 2);
+}
+
+TEST_CASE("Pipeline: rows collected by window syncs are reported at the end", "[dml][pipeline][pg]") {
+    OrmSchema schema = make_user_schema();
+    Storage st = make_storage_for(Dialect::SQLite);
+    FakeSQLConnection conn;
+    conn.pipelining = true;
+    conn.window = 256;
+
+    std::string json = "[";
+    for (int i = 1; i <= 300; ++i) json += (i > 1 ? "," : "") + std::string(R"({"id": )") + std::to_string(i) + R"(, "age": 1})";
+    json += "]";
+    jdoc upd;
+    jhlp::parse_str(json, upd);
+
+    REQUIRE(st.update(conn, schema, upd, "") == 300); // 256 at the window sync + 44 at pipeline_end()
+    REQUIRE(conn.pipeline_syncs == 2);
+    REQUIRE_FALSE(conn.in_pipeline);
+}
+
+TEST_CASE("co_insert / co_update: rows are counted once through the outer pipeline", "[dml][pipeline][aio]") {
+    OrmSchema schema = make_user_schema();
+    Storage st = make_storage_for(Dialect::SQLite);
+    st.batch_size(1); // one statement per row
+    FakeSQLConnection conn;
+    conn.pipelining = true;
+
+    jdoc ins, upd;
+    jhlp::parse_str(R"([{"name":"A","age":1},{"name":"B","age":2},{"name":"C","age":3}])", ins);
+    jhlp::parse_str(R"([{"id": 1, "age": 5},{"id": 2, "age": 6}])", upd);
+
+    aio::EventLoop loop;
+    REQUIRE(aio::run(loop, st.co_insert(conn, schema, ins, "")) == 3); // not 3 from insert() + 3 from the sync
+    REQUIRE(aio::run(loop, st.co_update(conn, schema, upd, "")) == 2); // reported by the sync only
+    REQUIRE(conn.pipeline_syncs == 2);
+    REQUIRE_FALSE(conn.in_pipeline);
+}
@@ -0,0 +1,101 @@
+#include "catch.hpp"
+#include "ecm_server.hpp"
+#include <sstream>
+#include <string>
+
+static void add_people(Storage& st) {
+    OrmSchema schema;
+    schema.name = "people";
+    schema.version = 1;
+    OrmProp id;   id.name = "id";     id.type = PropType::Integer; id.is_id = true; id.id_kind = IdKind::Snowflake;
+    OrmProp name; name.name = "name"; name.type = PropType::String;
+    schema.fields[id.name] = id;
+    schema.fields[name.name] = name;
+    REQUIRE(st.addSchema(schema));
+    st.execDDL("CREATE TABLE people(id INTEGER PRIMARY KEY, name TEXT);");
+}
+
+static int call(EcmRouter& r, RequestArena& a, const char* method, const char* uri, const char* body = "") {
+    a.reset();
+    a.body() = body;
+    return r.handle(method, uri, a);
+}
+
+TEST_CASE("EcmRouter: /ecm/<schema> maps to the schema name", "[server]") {
+    REQUIRE(EcmRouter::schema_of("/ecm/people") == "people");
+    REQUIRE(EcmRouter::schema_of("/ecm/people/7") == "people");
+    REQUIRE(EcmRouter::schema_of("/ecm/people?x=1") == "people");
+    REQUIRE(EcmRouter::schema_of("/ecm/").empty());
+    REQUIRE(EcmRouter::schema_of("/api/people").empty());
+}
+
+TEST_CASE("EcmRouter: POST/PUT/DELETE run insert/update/del", "[server][sqlite]") {
+    Storage st(":memory:", Dialect::SQLite);
+    add_people(st);
+    EcmRouter router(st);
+    RequestArena arena;
+
+    REQUIRE(call(router, arena, "POST", "/ecm/people", R"([{"id":1,"name":"a"},{"id":2,"name":"b"}])") == 200);
+    REQUIRE(std::string(arena.out().GetString()) == R"({"rows":2})");
+
+    REQUIRE(call(router, arena, "PUT", "/ecm/people", R"({"id":2,"name":"bb"})") == 200);
+    REQUIRE(st.execDML("UPDATE people SET id = id WHERE name = 'bb';") == 1);
+
+    REQUIRE(call(router, arena, "GET", "/ecm/people") == 200);
+    REQUIRE(std::string(arena.out().GetString()) == R"({"rows":2})");
+
+    REQUIRE(call(router, arena, "DELETE", "/ecm/people", R"([{"id":1},{"id":2},{"id":3}])") == 200);
+    REQUIRE(std::string(arena.out().GetString()) == R"({"rows":2})");
+    REQUIRE(st.execDML("UPDATE people SET id = id;") == 0);
+}
+
+TEST_CASE("EcmRouter: streamed bodies go through Storage::insert_stream", "[server][sqlite]") {
+    Storage st(":memory:", Dialect::SQLite);
+    add_people(st);
+    EcmRouter router(st);
+    RequestArena arena;
+
+    std::istringstream post(R"([{"name":"a"},{"name":"b"},{"name":"c"}])");
+    REQUIRE(router.handle("POST", "/ecm/people", post, arena) == 200);
+    REQUIRE(std::string(arena.out().GetString()) == R"({"rows":3})");
+
+    arena.reset();
+    std::istringstream put(R"({"id":1,"name":"a"})"); // other methods: read whole, same path as handle()
+    REQUIRE(router.handle("PUT", "/ecm/people", put, arena) == 200);
+    REQUIRE(std::string(arena.out().GetString()) == R"({"rows":0})");
+
+    arena.reset();
+    std::istringstream bad(R"([{"name":"d"},{"na)");
+    REQUIRE(router.handle("POST", "/ecm/people", bad, arena) == 400); // invalid JSON: rolled back
+    REQUIRE(st.execDML("UPDATE people SET id = id;") == 3);
+}
+
+TEST_CASE("EcmRouter: errors come back as status + {\"error\":...}", "[server][sqlite]") {
+    Storage st(":memory:", Dialect::SQLite);
+    add_people(st);
+    EcmRouter router(st);
+    RequestArena arena;
+
+    REQUIRE(call(router, arena, "POST", "/ecm/nobody", "{}") == 404);
+    REQUIRE(call(router, arena, "POST", "/other/people", "{}") == 404);
+    REQUIRE(call(router, arena, "PATCH", "/ecm/people", "{}") == 405);
+    REQUIRE(call(router, arena, "POST", "/ecm/people", "{\"id\":") == 400);
+    REQUIRE(call(router, arena, "POST", "/ecm/people", "42") == 400);
+    REQUIRE(call(router, arena, "DELETE", "/ecm/people", R"({"name":"no id"})") == 400);
+    REQUIRE(call(router, arena, "PUT", "/ecm/people", R"([{"id":1,"name":"a"},{"name":"no id"}])") == 400);
+    REQUIRE(call(router, arena, "POST", "/ecm/people", R"({"id":1,"name":7})") == 400); // bind type
+    REQUIRE(std::string(arena.out().GetString()).find("\"error\"") != std::string::npos);
+}
+
+TEST_CASE("RequestArena: reset() keeps the pool and buffers for the next request", "[server]") {
+    RequestArena arena(4096);
+    const std::size_t base = arena.pool_capacity();
+    for (int i = 0; i < 100; ++i) {
+        arena.reset();
+        arena.body() = R"({"id":1,"name":"some name","tags":["a","b","c"]})";
+        arena.doc().Parse(arena.body().c_str());
+        REQUIRE(arena.doc().IsObject());
+        REQUIRE(arena.doc()["name"] == "some name");
+    }
+    REQUIRE(arena.pool_capacity() == base);
+}
@@ -0,0 +1,100 @@
+#include "catch.hpp"
+#include "dbpool.hpp"
+#include "migration_worker.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+static OrmSchema users(int version, bool with_age) {
+    OrmSchema s;
+    s.name = "users";
+    s.version = version;
+    OrmProp id;   id.name = "id";     id.type = PropType::Integer; id.is_id = true;
+    OrmProp name; name.name = "name"; name.type = PropType::String;
+    s.fields[id.name] = id;
+    s.fields[name.name] = name;
+    if (with_age) {
+        OrmProp age; age.name = "age"; age.type = PropType::Integer;
+        s.fields[age.name] = age;
+    }
+    return s;
+}
+
+TEST_CASE("MigrationWorker: plan() splits the CREATE script and diffs later versions", "[migration]") {
+    auto create = MigrationWorker::plan(nullptr, users(1, false), Dialect::SQLite);
+    REQUIRE(create.size() == 1);
+    REQUIRE(create[0].find("CREATE TABLE IF NOT EXISTS users") == 0);
+
+    OrmSchema v1 = users(1, false), v2 = users(2, true);
+    auto alter = MigrationWorker::plan(&v1, v2, Dialect::SQLite);
+    REQUIRE(alter.size() == 1);
+    REQUIRE(alter[0].find("ADD COLUMN age") != std::string::npos);
+}
+
+TEST_CASE("MigrationWorker: requests keep the applied version until the background step commits", "[migration][sqlite]") {
+    const std::string path = "./test_migration_worker.db";
+    std::remove(path.c_str());
+    {
+        SchemaBoss boss;
+        auto inline_migrate = [](const OrmSchema*, const OrmSchema&) { return false; }; // requests never migrate
+        PSQLConnection conn = make_sqlite_connection();
+        conn->connect(path);
+        MigrationWorker worker(boss, std::move(conn), Dialect::SQLite, std::chrono::milliseconds(10));
+
+        boss.add(users(1, false));
+        REQUIRE(worker.wait_idle(std::chrono::seconds(5)));
+        REQUIRE(boss.get("users", inline_migrate)->version == 1);
+
+        // hold the write lock: the worker's step fails (SQLITE_BUSY) and is retried
+        PSQLConnection blocker = make_sqlite_connection();
+        blocker->connect(path);
+        blocker->prepare("BEGIN IMMEDIATE;")->exec();
+
+        boss.add(users(2, true));
+        const auto t0 = std::chrono::steady_clock::now();
+        REQUIRE(boss.get("users", inline_migrate)->version == 1); // served at once, no DDL in-line
+        REQUIRE(std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(100));
+        while (worker.failed() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REQUIRE(boss.get("users", inline_migrate)->version == 1);
+
+        blocker->prepare("COMMIT;")->exec();
+        for (int i = 0; i < 500 && boss.get("users", inline_migrate)->version != 2; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(boss.get("users", inline_migrate)->version == 2);
+        REQUIRE(worker.applied() == 2);
+        REQUIRE(blocker->prepare("SELECT age FROM users;")->exec() == 0); // column exists
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("MigrationWorker: SQLite column type change rebuilds the table without OnlineMigration", "[migration][sqlite]") {
+    const std::string path = "./test_migration_rebuild.db";
+    std::remove(path.c_str());
+    {
+        SchemaBoss boss;
+        auto inline_migrate = [](const OrmSchema*, const OrmSchema&) { return false; };
+        PSQLConnection conn = make_sqlite_connection();
+        conn->connect(path);
+        MigrationWorker worker(boss, std::move(conn), Dialect::SQLite, std::chrono::milliseconds(10));
+
+        boss.add(users(1, true));
+        REQUIRE(worker.wait_idle(std::chrono::seconds(5)));
+        PSQLConnection check = make_sqlite_connection();
+        check->connect(path);
+        check->prepare("INSERT INTO users (id, name, age) VALUES (1, 'a', 42);")->exec();
+
+        OrmSchema v2 = users(2, true);
+        v2.fields["age"].type = PropType::String;
+        v2.fields["age"].default_value = "'0'";
+        boss.add(v2);
+        REQUIRE(worker.wait_idle(std::chrono::seconds(5)));
+        REQUIRE(worker.failed() == 0);
+        REQUIRE(worker.last_error().empty());
+        REQUIRE(worker.applied() == 2);
+        REQUIRE(boss.get("users", inline_migrate)->version == 2);
+        REQUIRE(check->prepare("UPDATE users SET name = name WHERE typeof(age) = 'text' AND age = '42';")->exec() == 1);
+    }
+    std::remove(path.c_str());
+}
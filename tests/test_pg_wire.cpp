@@ -0,0 +1,159 @@
+#include "catch.hpp"
+#include "pg_wire.hpp"
+#include <cstring>
+#include <string>
+#include <vector>
+
+static int64_t pg_time(const char* s, PropType type) {
+    int64_t v = 0;
+    REQUIRE(pgtime::parse(s, std::strlen(s), type, v));
+    return v;
+}
+
+static bool pg_time_ok(const char* s, PropType type) {
+    int64_t v = 0;
+    return pgtime::parse(s, std::strlen(s), type, v);
+}
+
+static std::string bytes(const char* p, size_t n) { return std::string(p, n); }
+
+TEST_CASE("pgtime: dates are days since 2000-01-01", "[pgwire][pgtime]") {
+    REQUIRE(pg_time("2000-01-01", PropType::Date) == 0);
+    REQUIRE(pg_time("2000-01-02", PropType::Date) == 1);
+    REQUIRE(pg_time("1999-12-31", PropType::Date) == -1);
+    REQUIRE(pg_time("2000-03-01", PropType::Date) == 60); // leap year
+    REQUIRE(pg_time("1970-01-01", PropType::Date) == -10957);
+}
+
+TEST_CASE("pgtime: times and timestamps are microseconds", "[pgwire][pgtime]") {
+    REQUIRE(pg_time("00:00", PropType::Time) == 0);
+    REQUIRE(pg_time("01:02:03", PropType::Time) == 3723000000LL);
+    REQUIRE(pg_time("00:00:00.5", PropType::Time) == 500000);
+    REQUIRE(pg_time("00:00:00.1234567", PropType::Time) == 123456); // past 6 digits: truncated
+
+    REQUIRE(pg_time("2000-01-01T00:00:00", PropType::Dt_Time) == 0);
+    REQUIRE(pg_time("2000-01-02 00:00:01", PropType::Dt_Time) == 86400000000LL + 1000000);
+    REQUIRE(pg_time("2000-01-01T01:00:00+01:00", PropType::Tm_Stamp) == 0);
+    REQUIRE(pg_time("2000-01-01T00:00:00Z", PropType::Tm_Stamp) == 0);
+    REQUIRE(pg_time("2000-01-01T00:00:00-0130", PropType::Tm_Stamp) == 5400000000LL);
+}
+
+TEST_CASE("pgtime: other spellings are left to the server", "[pgwire][pgtime]") {
+    REQUIRE_FALSE(pg_time_ok("2000-1-01", PropType::Date));
+    REQUIRE_FALSE(pg_time_ok("2000-13-01", PropType::Date));
+    REQUIRE_FALSE(pg_time_ok("2000-01-01 ", PropType::Date));
+    REQUIRE_FALSE(pg_time_ok("25:00", PropType::Time));
+    REQUIRE_FALSE(pg_time_ok("12:00:00.", PropType::Time));
+    REQUIRE_FALSE(pg_time_ok("2000-01-01T00:00:00", PropType::Tm_Stamp));   // offset required
+    REQUIRE_FALSE(pg_time_ok("2000-01-01T00:00:00Z", PropType::Dt_Time));   // offset rejected
+    REQUIRE_FALSE(pg_time_ok("today", PropType::Date));
+    REQUIRE_FALSE(pg_time_ok("2000-01-01", PropType::String));
+}
+
+TEST_CASE("pgwire: fixed-width values are big-endian", "[pgwire]") {
+    char out[8];
+
+    pgwire::int4(out, 0x01020304);
+    REQUIRE(bytes(out, 4) == std::string("\x01\x02\x03\x04", 4));
+    pgwire::int4(out, -2);
+    REQUIRE(bytes(out, 4) == std::string("\xFF\xFF\xFF\xFE", 4));
+
+    pgwire::int8(out, 0x0102030405060708LL);
+    REQUIRE(bytes(out, 8) == std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+    pgwire::int8(out, -1);
+    REQUIRE(bytes(out, 8) == std::string(8, '\xFF'));
+
+    pgwire::float8(out, 1.0); // IEEE-754 0x3FF0000000000000
+    REQUIRE(bytes(out, 8) == std::string("\x3F\xF0\x00\x00\x00\x00\x00\x00", 8));
+    pgwire::float8(out, -2.5); // 0xC004000000000000
+    REQUIRE(bytes(out, 8) == std::string("\xC0\x04\x00\x00\x00\x00\x00\x00", 8));
+
+    pgwire::boolean(out, true);
+    REQUIRE(out[0] == 1);
+    pgwire::boolean(out, false);
+    REQUIRE(out[0] == 0);
+}
+
+TEST_CASE("pgwire: param_count finds the highest placeholder outside quotes", "[pgwire]") {
+    REQUIRE(pgwire::param_count("SELECT 1;") == 0);
+    REQUIRE(pgwire::param_count("INSERT INTO t (a, b, c) VALUES ($1, $2, $3);") == 3);
+    REQUIRE(pgwire::param_count("UPDATE t SET a = $2 WHERE id = $1;") == 2);
+    REQUIRE(pgwire::param_count("INSERT INTO t VALUES ($1, $2), ($3, $12);") == 12);
+    REQUIRE(pgwire::param_count("SELECT '$9', \"a$8\", x$7 FROM t WHERE a = $1; -- $5") == 1);
+    REQUIRE(pgwire::param_count("SELECT $f$ $4 $f$, $$ $3 $$ /* $2 */ WHERE a = $1;") == 1);
+}
+
+static jdoc parse(const char* json) {
+    jdoc d;
+    d.Parse(json);
+    REQUIRE_FALSE(d.HasParseError());
+    return d;
+}
+
+TEST_CASE("PgCopyEncoder: binary rows take integer widths from the column types", "[pgwire][copy]") {
+    const std::vector<CopyColumn> cols { { "n", "INTEGER" }, { "ok", "BOOLEAN" }, { "name", "TEXT" }, { "id", "BIGINT" } };
+    PgCopyEncoder enc(cols, CopyFormat::Binary);
+    jdoc row = parse(R"({"n": 7, "ok": true, "name": "ab", "id": 2111229828245966848})");
+    enc.put(row["n"], PropType::Integer);
+    enc.put(row["ok"], PropType::Bool);
+    enc.put_null();
+    enc.put(row["id"], PropType::Integer); // snowflake: int8, no int4 overflow
+    enc.end_row();
+    enc.finish();
+
+    std::string want("PGCOPY\n\377\r\n\0", 11);
+    want += std::string(8, '\0');                            // flags, header extension
+    want += std::string("\x00\x04", 2);                      // field count
+    want += std::string("\x00\x00\x00\x04\x00\x00\x00\x07", 8);
+    want += std::string("\x00\x00\x00\x01\x01", 5);
+    want += std::string("\xFF\xFF\xFF\xFF", 4);              // NULL
+    want += std::string("\x00\x00\x00\x08\x1D\x4C\x98\x57\xCF\xCF\x50\x00", 12);
+    want += std::string("\xFF\xFF", 2);                      // trailer
+    REQUIRE(enc.buffer() == want);
+    REQUIRE(enc.rows() == 1);
+}
+
+TEST_CASE("PgCopyEncoder: int4 columns still reject values past int4", "[pgwire][copy]") {
+    PgCopyEncoder enc({ { "n", "INTEGER" } }, CopyFormat::Binary);
+    jdoc row = parse(R"({"n": 4294967296})");
+    REQUIRE_THROWS(enc.put(row["n"], PropType::Integer));
+
+    PgCopyEncoder untyped({ { "n", "" } }, CopyFormat::Binary);
+    jdoc small = parse(R"({"n": 1})");
+    REQUIRE_THROWS(untyped.put(small["n"], PropType::Integer));
+}
+
+TEST_CASE("PgCopyEncoder: text rows escape and bytea is the same in both formats", "[pgwire][copy]") {
+    const std::vector<CopyColumn> cols { { "s", "TEXT" }, { "b", "BYTEA" }, { "h", "BYTEA" }, { "id", "BIGINT" } };
+    jdoc row = parse(R"({"s": "a\tb\\c\n", "b": "\u0001ÿ", "h": "\\x01ff", "id": 42})");
+
+    PgCopyEncoder text(cols, CopyFormat::Text);
+    text.put(row["s"], PropType::String);
+    text.put(row["b"], PropType::Bin);
+    text.put(row["h"], PropType::Bin);
+    text.put(row["id"], PropType::Integer);
+    text.end_row();
+    text.finish();
+    REQUIRE(text.buffer() == "a\\tb\\\\c\\n\t\\\\x01c3bf\t\\\\x01ff\t42\n");
+
+    // raw bytes go as they are, a hex literal is decoded: "\x01ff" and "\u0001ÿ" (UTF-8) differ
+    PgCopyEncoder bin(cols, CopyFormat::Binary);
+    bin.put(row["s"], PropType::String);
+    bin.put(row["b"], PropType::Bin);
+    bin.put(row["h"], PropType::Bin);
+    bin.put(row["id"], PropType::Integer);
+    bin.end_row();
+    const std::string& buf = bin.buffer();
+    REQUIRE(buf.find(std::string("\x00\x00\x00\x03\x01\xC3\xBF", 7)) != std::string::npos);
+    REQUIRE(buf.find(std::string("\x00\x00\x00\x02\x01\xFF", 6)) != std::string::npos);
+
+    jdoc bad = parse(R"({"h": "\\x0"})");
+    REQUIRE_THROWS(bin.put(bad["h"], PropType::Bin));
+}
+
+TEST_CASE("PgCopyEncoder: rows must have one value per column", "[pgwire][copy]") {
+    PgCopyEncoder enc({ { "a", "TEXT" }, { "b", "TEXT" } }, CopyFormat::Text);
+    enc.put_null();
+    REQUIRE_THROWS(enc.end_row());
+    REQUIRE_THROWS(enc.finish());
+}
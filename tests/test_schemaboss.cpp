@@ -0,0 +1,107 @@
+#include "catch.hpp"
+#include "schemaboss.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static OrmSchema people(int version) {
+    OrmSchema s;
+    s.name = "people";
+    s.version = version;
+    OrmProp id; id.name = "id"; id.type = PropType::Integer; id.is_id = true;
+    s.fields[id.name] = id;
+    return s;
+}
+
+TEST_CASE("SchemaBoss: get() migrates once, then serves the applied version", "[schemaboss]") {
+    SchemaBoss boss;
+    std::vector<std::pair<int, int>> steps; // from -> to
+    auto migrate = [&](const OrmSchema* from, const OrmSchema& to) {
+        steps.emplace_back(from ? from->version : -1, to.version);
+        return true;
+    };
+
+    REQUIRE(boss.get("people", migrate) == nullptr);
+    REQUIRE(boss.add(people(1)));
+    REQUIRE_THROWS(boss.add(people(1)));
+    REQUIRE(boss.unapplied_versions("people") == std::vector<int> { 1 });
+
+    REQUIRE(boss.get("people", migrate)->version == 1);
+    REQUIRE(boss.get("people", migrate)->version == 1);
+    REQUIRE(steps.size() == 1);
+
+    REQUIRE(boss.add(people(2)));
+    REQUIRE(boss.add(people(3)));
+    REQUIRE(boss.get_newest("people", true)->schema->version == 1); // not migrated yet
+    REQUIRE(boss.get("people", migrate)->version == 3);
+    REQUIRE(steps == std::vector<std::pair<int, int>> { { -1, 1 }, { 1, 2 }, { 2, 3 } });
+    REQUIRE(boss.unapplied_versions("people").empty());
+    REQUIRE(boss.get_newest("people")->inactive == false);
+}
+
+TEST_CASE("SchemaBoss: a failed step keeps serving the last applied version and retries", "[schemaboss]") {
+    SchemaBoss boss;
+    boss.add(people(1));
+    bool fail = false;
+    auto migrate = [&](const OrmSchema*, const OrmSchema&) { return !fail; };
+    REQUIRE(boss.get("people", migrate)->version == 1);
+
+    boss.add(people(2));
+    fail = true;
+    REQUIRE(boss.get("people", migrate) == nullptr);
+    REQUIRE(boss.get_newest("people", true)->schema->version == 1);
+    fail = false;
+    REQUIRE(boss.get("people", migrate)->version == 2);
+}
+
+TEST_CASE("SchemaBoss: concurrent get() runs one migration, readers never block each other", "[schemaboss]") {
+    SchemaBoss boss;
+    boss.add(people(1));
+    std::atomic<int> migrations { 0 };
+    auto migrate = [&](const OrmSchema*, const OrmSchema&) {
+        ++migrations;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return true;
+    };
+
+    std::vector<std::thread> ts;
+    std::atomic<int> wrong { 0 };
+    for (int i = 0; i < 8; ++i) {
+        ts.emplace_back([&] {
+            for (int n = 0; n < 100; ++n) {
+                auto s = boss.get("people", migrate);
+                if (!s || s->version != 1) ++wrong;
+            }
+        });
+    }
+    for (auto& t : ts) t.join();
+    REQUIRE(migrations == 1);
+    REQUIRE(wrong == 0);
+}
+
+TEST_CASE("SchemaBoss: a lease keeps its version until released, then it retires once", "[schemaboss]") {
+    SchemaBoss boss;
+    auto migrate = [](const OrmSchema*, const OrmSchema&) { return true; };
+    std::vector<int> retired;
+    boss.add_retire_listener([&](const OrmSchema& s) { retired.push_back(s.version); });
+
+    boss.add(people(1));
+    auto bulk = boss.get("people", migrate); // e.g. a long bulk load
+    REQUIRE(bulk->version == 1);
+
+    boss.add(people(2));
+    boss.add(people(3));
+    REQUIRE(boss.get("people", migrate)->version == 3); // new users move at once
+    REQUIRE(retired == std::vector<int> { 2 });        // never leased: retired right away
+    REQUIRE(boss.retiring() == 1);
+    REQUIRE(bulk->version == 1);                       // old user keeps its version
+
+    SchemaBoss::Lease moved = std::move(bulk);
+    REQUIRE(bulk == nullptr);
+    moved.release();
+    REQUIRE(retired == std::vector<int> { 2, 1 });
+    REQUIRE(boss.retiring() == 0);
+    moved.release(); // no-op
+    REQUIRE(retired.size() == 2);
+}
@@ -1,5 +1,7 @@
 
 #include "catch.hpp"
+#include "dbpool.hpp"
+#include "ddl_visitor.hpp"
 #include "schemaupdate.hpp"
 
 OrmSchema load_schema_from_json(const std::string& js) {
@@ -89,3 +91,103 @@ TEST_CASE("Default value change") {
 //     auto ddls = mgr.plan_migration("postgres");
 //     REQUIRE(ddls.empty());
 // }
+
+static OrmSchema items(PropType qty) {
+    OrmSchema s;
+    s.name = "items";
+    OrmProp id;  id.name = "id";   id.type = PropType::Integer; id.is_id = true;
+    OrmProp q;   q.name = "qty";   q.type = qty;
+    OrmProp n;   n.name = "note";  n.type = PropType::String;
+    s.fields[id.name] = id;
+    s.fields[q.name] = q;
+    s.fields[n.name] = n;
+    return s;
+}
+
+TEST_CASE("Online plan: postgres shadow column, keyset chunks, swap", "[schemaupdate][online]") {
+    OrmSchema old_schema = items(PropType::String), new_schema = items(PropType::Integer);
+    OnlineMigration opts;
+    opts.chunk_rows = 500;
+    auto steps = SchemaUpdate(old_schema, new_schema).plan_online("postgres", opts);
+    REQUIRE(steps.size() == 3);
+
+    auto has = [](const MigrationStep& st, const std::string& part) {
+        for (const auto& sql : st.sql)
+            if (sql.find(part) != std::string::npos) return true;
+        return false;
+    };
+    REQUIRE(has(steps[0], "ALTER TABLE items ADD COLUMN IF NOT EXISTS qty__new INTEGER"));
+    REQUIRE(has(steps[0], "CREATE TRIGGER items__shadow_sync BEFORE INSERT OR UPDATE ON items"));
+    REQUIRE(steps[1].kind == MigrationStep::Kind::Backfill);
+    REQUIRE(has(steps[1], "OFFSET 499"));
+    REQUIRE(steps[1].sql[steps[1].counted].find("SET qty__new = CAST(items.qty AS INTEGER)") != std::string::npos);
+    REQUIRE(has(steps[2], "ALTER TABLE items RENAME COLUMN qty__new TO qty;"));
+    REQUIRE_FALSE(has(steps[2], "TYPE"));
+
+    // no type change: plan_migration() as one step - here nothing at all
+    auto same = SchemaUpdate(old_schema, old_schema).plan_online("postgres");
+    REQUIRE(same.empty());
+}
+
+TEST_CASE("Online plan: postgres builds indexes and NOT NULL before the swap", "[schemaupdate][online]") {
+    OrmSchema old_schema = items(PropType::String), new_schema = items(PropType::Integer);
+    OrmProp& qty = new_schema.fields["qty"];
+    qty.required = true;
+    qty.is_unique = true;
+    OrmIndex by_note;
+    by_note.index_name = "items_qty_note";
+    by_note.fields = { "qty", "note" };
+    old_schema.indexes = { by_note };
+    new_schema.indexes = { by_note };
+    auto steps = SchemaUpdate(old_schema, new_schema).plan_online("postgres");
+    REQUIRE(steps.size() == 6); // setup, backfill, build, check, validate, swap
+
+    auto has = [](const MigrationStep& st, const std::string& part) {
+        for (const auto& sql : st.sql)
+            if (sql.find(part) != std::string::npos) return true;
+        return false;
+    };
+    REQUIRE(steps[2].kind == MigrationStep::Kind::Concurrent);
+    REQUIRE(has(steps[2], "CREATE UNIQUE INDEX CONCURRENTLY items_qty__new_key ON items (qty__new);"));
+    REQUIRE(has(steps[2], "CREATE INDEX CONCURRENTLY items_qty_note__new ON items (qty__new, note);"));
+    REQUIRE(has(steps[3], "CHECK (qty__new IS NOT NULL) NOT VALID;"));
+    REQUIRE(has(steps[4], "VALIDATE CONSTRAINT items_qty__new_nn;"));
+
+    const MigrationStep& swap = steps[5];
+    REQUIRE(has(swap, "ALTER COLUMN qty SET NOT NULL;"));
+    REQUIRE(has(swap, "ADD CONSTRAINT items_qty_key UNIQUE USING INDEX items_qty__new_key;"));
+    REQUIRE(has(swap, "ALTER INDEX items_qty_note__new RENAME TO items_qty_note;"));
+    REQUIRE_FALSE(has(swap, "CREATE"));
+    REQUIRE_FALSE(has(swap, "ADD UNIQUE"));
+}
+
+TEST_CASE("Online plan: sqlite rebuild copies in chunks and mirrors writes meanwhile", "[schemaupdate][online][sqlite]") {
+    OrmSchema old_schema = items(PropType::String), new_schema = items(PropType::Integer);
+    PSQLConnection conn = make_sqlite_connection();
+    conn->connect(":memory:");
+    SqliteDDLVisitor ddl;
+    for (const auto& sql : DDLVisitor::split(ddl.visit(old_schema))) conn->prepare(sql)->exec();
+    for (int i = 1; i <= 25; ++i) {
+        conn->prepare("INSERT INTO items (id, qty, note) VALUES (" + std::to_string(i) + ", '" + std::to_string(i) + "', 'n');")->exec();
+    }
+
+    OnlineMigration opts;
+    opts.chunk_rows = 10;
+    opts.throttle = std::chrono::milliseconds(0);
+    auto steps = SchemaUpdate(old_schema, new_schema).plan_online("sqlite", opts);
+    REQUIRE(steps.size() == 3);
+
+    REQUIRE(SchemaUpdate::run(*conn, { steps[0] }, opts) == 0);
+    // writes during the backfill land in the new table through the triggers
+    conn->prepare("INSERT INTO items (id, qty, note) VALUES (26, '26', 'late');")->exec();
+    conn->prepare("UPDATE items SET qty = '100' WHERE id = 3;")->exec();
+    conn->prepare("DELETE FROM items WHERE id = 4;")->exec();
+    REQUIRE(SchemaUpdate::run(*conn, { steps[1] }, opts) == 25); // 3 chunks: 10 + 10 + 5
+    REQUIRE(SchemaUpdate::run(*conn, { steps[2] }, opts) == 0);
+
+    REQUIRE(conn->prepare("UPDATE items SET note = note WHERE typeof(qty) = 'integer';")->exec() == 25);
+    REQUIRE(conn->prepare("UPDATE items SET note = note WHERE id = 3 AND qty = 100;")->exec() == 1);
+    REQUIRE(conn->prepare("UPDATE items SET note = note WHERE id = 4;")->exec() == 0);
+    REQUIRE_THROWS(conn->prepare("SELECT * FROM items__new;"));
+    REQUIRE_THROWS(conn->prepare("SELECT * FROM _ecm_backfill_items;"));
+}
@@ -0,0 +1,349 @@
+#include "catch.hpp"
+#include "dbpool.hpp"
+#include "sqlconnection.hpp"
+#include "sqlite_profile.hpp"
+#include "storage.hpp"
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Real SQLite, in-memory: exercises statement reuse through the per-connection cache.
+static PSQLConnection open_memory_db() {
+    PSQLConnection conn = make_sqlite_connection();
+    conn->connect(":memory:");
+    REQUIRE(conn->prepare("CREATE TABLE users(id INTEGER PRIMARY KEY, name TEXT);")->exec() == 0);
+    return conn;
+}
+
+TEST_CASE("SQLite: one statement is re-bound and executed for many rows", "[sqlite][stmtcache]") {
+    auto conn = open_memory_db();
+    auto stmt = conn->prepare("INSERT INTO users (id, name) VALUES (?1, ?2);");
+
+    jdoc doc;
+    jhlp::parse_str(R"([{"id": 1, "name": "Alice"}, {"id": 2, "name": "Bob"}, {"id": 3, "name": "Carol"}])", doc);
+    for (const auto& row : doc.GetArray()) {
+        stmt->bind(1, row["id"], PropType::Integer);
+        stmt->bind(2, row["name"], PropType::String);
+        REQUIRE(stmt->exec() == 1);
+    }
+    REQUIRE(conn->prepare("UPDATE users SET name = name;")->exec() == 3);
+}
+
+TEST_CASE("SQLite: cached statements come back reset with cleared bindings", "[sqlite][stmtcache]") {
+    auto conn = open_memory_db();
+    const std::string sql = "INSERT INTO users (id, name) VALUES (?1, ?2);";
+
+    jdoc doc;
+    jhlp::parse_str(R"({"id": 7, "name": "Dave"})", doc);
+    {
+        auto stmt = conn->prepare(sql);
+        stmt->bind(1, doc["id"], PropType::Integer);
+        stmt->bind(2, doc["name"], PropType::String);
+        REQUIRE(stmt->exec() == 1);
+    } // lease returns to the cache
+
+    // Same SQL again: bindings were cleared, so id is NULL -> rowid assigned, name NULL
+    auto again = conn->prepare(sql);
+    REQUIRE(again->exec() == 1);
+    REQUIRE(conn->prepare("UPDATE users SET name = 'x' WHERE name IS NULL;")->exec() == 1);
+}
+
+TEST_CASE("SQLite: same SQL leased twice gets independent statements", "[sqlite][stmtcache]") {
+    auto conn = open_memory_db();
+    const std::string sql = "INSERT INTO users (id, name) VALUES (?1, ?2);";
+
+    jdoc doc;
+    jhlp::parse_str(R"([{"id": 10, "name": "A"}, {"id": 11, "name": "B"}])", doc);
+    auto s1 = conn->prepare(sql);
+    auto s2 = conn->prepare(sql);
+    s1->bind(1, doc[0]["id"], PropType::Integer);
+    s1->bind(2, doc[0]["name"], PropType::String);
+    s2->bind(1, doc[1]["id"], PropType::Integer);
+    s2->bind(2, doc[1]["name"], PropType::String);
+    REQUIRE(s1->exec() == 1);
+    REQUIRE(s2->exec() == 1);
+    REQUIRE(conn->prepare("UPDATE users SET name = name WHERE id >= 10;")->exec() == 2);
+}
+
+TEST_CASE("SQLite: the connection reports its compiled parameter limit", "[sqlite][batch]") {
+    PSQLConnection conn = make_sqlite_connection();
+    REQUIRE(conn->max_params() == 0); // not connected: unknown
+    conn->connect(":memory:");
+    REQUIRE(conn->max_params() >= 999);
+}
+
+TEST_CASE("Storage::bulk_insert falls back to batched INSERT on SQLite", "[sqlite][bulk]") {
+    Storage st(":memory:", Dialect::SQLite); // pool of 1: the in-memory DB lives as long as st
+    st.batch_size(2);
+
+    OrmSchema schema;
+    schema.name = "people";
+    schema.version = 1;
+    OrmProp id;   id.name = "id";     id.type = PropType::Integer; id.is_id = true; id.id_kind = IdKind::Snowflake;
+    OrmProp name; name.name = "name"; name.type = PropType::String;
+    OrmProp age;  age.name = "age";   age.type = PropType::Integer;
+    schema.fields[id.name] = id;
+    schema.fields[name.name] = name;
+    schema.fields[age.name] = age;
+    REQUIRE(st.addSchema(schema));
+    st.execDDL("CREATE TABLE people(id INTEGER PRIMARY KEY, name TEXT, age INTEGER);");
+
+    jdoc doc;
+    jhlp::parse_str(R"([{"name":"a","age":1},{"name":"b","age":2},{"name":"c","age":3},{"id": 5, "name":"d","age":4}])", doc);
+    REQUIRE(st.bulk_insert("people", doc) == 4);
+    REQUIRE(st.execDML("UPDATE people SET age = age;") == 4);
+    REQUIRE(st.execDML("UPDATE people SET age = age WHERE id = 5;") == 1);
+}
+
+TEST_CASE("SQLite: text binds in place, Bin binds as a blob, exec releases bindings", "[sqlite][bind]") {
+    PSQLConnection conn = make_sqlite_connection();
+    conn->connect(":memory:");
+    conn->prepare("CREATE TABLE files(id INTEGER PRIMARY KEY, name TEXT, data BLOB, at DATE);")->exec();
+
+    auto stmt = conn->prepare("INSERT INTO files (id, name, data, at) VALUES (?1, ?2, ?3, ?4);");
+    {
+        jdoc doc; // dies right after exec(): nothing may keep pointing into it
+        jhlp::parse_str(R"({"id": 1, "name": "a.txt", "data": "raw\u0000bytes", "at": "2024-05-01"})", doc);
+        stmt->bind(1, doc["id"], PropType::Integer);
+        stmt->bind(2, doc["name"], PropType::String);
+        stmt->bind(3, doc["data"], PropType::Bin);
+        stmt->bind(4, doc["at"], PropType::Date);
+        REQUIRE(stmt->exec() == 1);
+    }
+    REQUIRE(conn->prepare("UPDATE files SET id = id WHERE typeof(data) = 'blob' AND length(data) = 9;")->exec() == 1);
+    REQUIRE(conn->prepare("UPDATE files SET id = id WHERE name = 'a.txt' AND at = '2024-05-01';")->exec() == 1);
+
+    // bindings were cleared by exec(): unbound params are NULL
+    REQUIRE(stmt->exec() == 1);
+    REQUIRE(conn->prepare("UPDATE files SET id = id WHERE name IS NULL AND data IS NULL;")->exec() == 1);
+}
+
+TEST_CASE("SQLite: dumped JSON params keep their slots when a later index is bound", "[sqlite][bind]") {
+    PSQLConnection conn = make_sqlite_connection();
+    conn->connect(":memory:");
+    conn->prepare("CREATE TABLE docs(a TEXT, b INTEGER, c INTEGER, d TEXT);")->exec();
+
+    auto stmt = conn->prepare("INSERT INTO docs (a, b, c, d) VALUES (?1, ?2, ?3, ?4);");
+    jdoc doc;
+    jhlp::parse_str(R"({"a": {"x":1}, "b": 2, "c": 3, "d": [1,2]})", doc);
+    for (int round = 0; round < 2; ++round) { // second round reuses the slots
+        stmt->bind(1, doc["a"], PropType::Json); // short: stored inline in the std::string
+        stmt->bind(2, doc["b"], PropType::Integer);
+        stmt->bind(3, doc["c"], PropType::Integer);
+        stmt->bind(4, doc["d"], PropType::Json);
+        REQUIRE(stmt->exec() == 1);
+    }
+    REQUIRE(conn->prepare(R"(UPDATE docs SET b = b WHERE a = '{"x":1}' AND d = '[1,2]';)")->exec() == 2);
+}
+
+TEST_CASE("SQLite: read-only readers see committed writes through WAL", "[sqlite][split]") {
+    const std::string path = "./test_split_pool.db";
+    std::remove(path.c_str());
+    {
+        StorageOptions options;
+        options.readers = 2;
+        options.sqlite = SqliteProfile::wal_tuned();
+        Storage st(path, Dialect::SQLite, options);
+        st.execDDL("CREATE TABLE IF NOT EXISTS notes(id INTEGER PRIMARY KEY, body TEXT);");
+        REQUIRE(st.execDML("INSERT INTO notes (id, body) VALUES (1, 'x');") == 1);
+
+        PSQLConnection reader = make_sqlite_reader_connection();
+        reader->connect(path);
+        REQUIRE_THROWS(reader->prepare("INSERT INTO notes (id, body) VALUES (2, 'y');")->exec());
+        REQUIRE(reader->prepare("SELECT body FROM notes WHERE id = 1;")->exec() == 0);
+        REQUIRE(reader->prepare("SELECT count(*) FROM notes;")->query_int() == 1);
+
+        OrmSchema notes;
+        notes.name = "notes";
+        notes.version = 1;
+        REQUIRE(st.addSchema(notes));
+        // count() is a read: it gets a reader while the only writer is held by an open transaction,
+        // and sees the last committed state
+        st.with_tr(pool::DbIntent::Write, [&](SQLConnection& writer) {
+            REQUIRE(writer.prepare("INSERT INTO notes (id, body) VALUES (2, 'y');")->exec() == 1);
+            REQUIRE(st.count("notes") == 1);
+            return 0;
+        });
+        REQUIRE(st.count("notes") == 2);
+    }
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+}
+
+TEST_CASE("SQLite: connection profile PRAGMAs are applied at connect", "[sqlite][profile]") {
+    const std::string path = "./test_profile.db";
+    std::remove(path.c_str());
+    {
+        SqliteProfile prof = SqliteProfile::wal_tuned();
+        prof.busy_timeout_ms = 1234;
+        prof.cache_size = -2048;
+        PSQLConnection conn = make_sqlite_connection(prof);
+        conn->connect(path);
+        conn->prepare("CREATE TABLE t(x INTEGER);")->exec();
+        conn->prepare("INSERT INTO t VALUES (1);")->exec();
+        // table-valued pragmas: the row matches only when the setting is in effect
+        REQUIRE(conn->prepare("UPDATE t SET x = x WHERE (SELECT * FROM pragma_journal_mode) = 'wal';")->exec() == 1);
+        REQUIRE(conn->prepare("UPDATE t SET x = x WHERE (SELECT * FROM pragma_synchronous) = 1;")->exec() == 1);
+        REQUIRE(conn->prepare("UPDATE t SET x = x WHERE (SELECT * FROM pragma_busy_timeout) = 1234;")->exec() == 1);
+        REQUIRE(conn->prepare("UPDATE t SET x = x WHERE (SELECT * FROM pragma_cache_size) = -2048;")->exec() == 1);
+        REQUIRE(conn->prepare("UPDATE t SET x = x WHERE (SELECT * FROM pragma_temp_store) = 2;")->exec() == 1);
+    }
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+}
+
+TEST_CASE("SQLite: background checkpointer copies WAL frames back", "[sqlite][profile]") {
+    const std::string path = "./test_checkpoint.db";
+    std::remove(path.c_str());
+    {
+        SqliteProfile prof = SqliteProfile::wal_tuned();
+        prof.wal_autocheckpoint = 0; // only the background thread checkpoints
+        PSQLConnection conn = make_sqlite_connection(prof);
+        conn->connect(path);
+        conn->prepare("CREATE TABLE t(x INTEGER);")->exec();
+        for (int i = 0; i < 50; ++i) conn->prepare("INSERT INTO t VALUES (1);")->exec();
+
+        SqliteCheckpointer ckpt(path, std::chrono::milliseconds(20));
+        for (int i = 0; i < 100 && ckpt.frames() == 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        REQUIRE(ckpt.checkpoints() > 0);
+        REQUIRE(ckpt.frames() > 0);
+    }
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+}
+
+TEST_CASE("Storage::co_insert / co_update run as coroutines on an event loop", "[sqlite][aio]") {
+    Storage st(":memory:", Dialect::SQLite);
+
+    OrmSchema schema;
+    schema.name = "people";
+    schema.version = 1;
+    OrmProp id;   id.name = "id";     id.type = PropType::Integer; id.is_id = true; id.id_kind = IdKind::Snowflake;
+    OrmProp name; name.name = "name"; name.type = PropType::String;
+    schema.fields[id.name] = id;
+    schema.fields[name.name] = name;
+    REQUIRE(st.addSchema(schema));
+    st.execDDL("CREATE TABLE people(id INTEGER PRIMARY KEY, name TEXT);");
+
+    jdoc rows, upd, bad;
+    jhlp::parse_str(R"([{"id": 1, "name":"a"},{"id": 2, "name":"b"}])", rows);
+    jhlp::parse_str(R"({"id": 2, "name":"bb"})", upd);
+    jhlp::parse_str(R"({"name":"no id"})", bad);
+
+    aio::EventLoop loop;
+    auto work = [&]() -> aio::Task<int> {
+        int n = co_await st.co_insert("people", rows, "");
+        n += co_await st.co_update("people", upd, "");
+        co_return n;
+    };
+    REQUIRE(aio::run(loop, work()) == 3);
+    REQUIRE(st.execDML("UPDATE people SET id = id WHERE name = 'bb';") == 1);
+
+    REQUIRE_THROWS(aio::run(loop, st.co_update("people", bad, ""))); // rolled back, connection returned
+    REQUIRE(aio::run(loop, st.co_insert("people", upd, "")) == 1);     // upsert on the same connection
+}
+
+TEST_CASE("Storage::insert_stream writes a streamed JSON array chunk by chunk", "[sqlite][stream]") {
+    Storage st(":memory:", Dialect::SQLite);
+
+    OrmSchema schema;
+    schema.name = "people";
+    schema.version = 1;
+    OrmProp id;   id.name = "id";     id.type = PropType::Integer; id.is_id = true; id.id_kind = IdKind::Snowflake;
+    OrmProp name; name.name = "name"; name.type = PropType::String;
+    schema.fields[id.name] = id;
+    schema.fields[name.name] = name;
+    REQUIRE(st.addSchema(schema));
+    st.execDDL("CREATE TABLE people(id INTEGER PRIMARY KEY, name TEXT);");
+    st.batch_size(7); // several flushes, last one partial
+
+    std::stringstream rows;
+    rows << "[";
+    for (int i = 1; i <= 100; ++i) rows << (i > 1 ? "," : "") << R"({"name":"n)" << i << R"(","extra":{"a":[1,2,{"b":null}]}})";
+    rows << ", 42 ]"; // non-object elements are skipped
+    REQUIRE(st.insert_stream("people", rows, "") == 100);
+    REQUIRE(st.execDML("UPDATE people SET id = id;") == 100);
+
+    std::stringstream one(R"({"id": 7, "name":"seven"})");
+    REQUIRE(st.insert_stream("people", one, "") == 1);
+
+    // a truncated payload rolls back the rows already flushed
+    std::stringstream broken(R"([{"name":"x"},{"name":"y"},{"name":"z"},{"name":"w"},{"name":"v"},{"name":"u"},{"name":"t"},{"name":"s"},{"na)");
+    REQUIRE_THROWS(st.insert_stream("people", broken, ""));
+    std::stringstream scalar("42");
+    REQUIRE_THROWS(st.insert_stream("people", scalar, ""));
+    REQUIRE(st.execDML("UPDATE people SET id = id;") == 101);
+}
+
+TEST_CASE("Storage catalog: lookups run against snapshots while schemas are added", "[storage][catalog]") {
+    Storage st(":memory:", Dialect::SQLite);
+    auto make = [](int i) {
+        OrmSchema s;
+        s.name = "t" + std::to_string(i);
+        OrmProp id; id.name = "id"; id.type = PropType::Integer; id.is_id = true;
+        s.fields[id.name] = id;
+        return s;
+    };
+    OrmSchema first = make(0);
+    REQUIRE(st.addSchema(first));
+    const auto before = st.catalog();
+
+    std::atomic<bool> done { false };
+    std::atomic<long> misses { 0 };
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                if (!st.hasSchema("t0")) ++misses;
+                auto snap = st.catalog();
+                for (const auto& [name, schema] : *snap) {
+                    if (!schema || schema->name != name) ++misses;
+                }
+            }
+        });
+    }
+    for (int i = 1; i <= 200; ++i) {
+        OrmSchema s = make(i);
+        REQUIRE(st.addSchema(s));
+    }
+    done = true;
+    for (auto& t : readers) t.join();
+
+    REQUIRE(misses == 0);
+    REQUIRE(before->size() == 1); // a held snapshot never changes
+    REQUIRE(st.catalog()->size() == 201);
+    REQUIRE(st.hasSchema("t200"));
+}
+
+TEST_CASE("Storage::createSchema runs every statement of the DDL script", "[sqlite][ddl]") {
+    Storage st(":memory:", Dialect::SQLite);
+
+    OrmSchema schema;
+    schema.name = "tags";
+    schema.version = 1;
+    OrmProp id;    id.name = "id";      id.type = PropType::Integer; id.is_id = true; id.id_kind = IdKind::Snowflake;
+    OrmProp label; label.name = "label"; label.type = PropType::String; label.is_indexed = true; label.index_name = "tags_label";
+    schema.fields[id.name] = id;
+    schema.fields[label.name] = label;
+
+    REQUIRE(st.createSchema(schema));
+    REQUIRE(st.createSchema(schema)); // IF NOT EXISTS: a restart finds the table
+    REQUIRE(st.execDML("INSERT INTO tags (id, label) VALUES (1, 'x');") == 1);
+    // the index is the script's second statement
+    REQUIRE(st.execDML("UPDATE tags SET id = id WHERE (SELECT count(*) FROM sqlite_master WHERE type = 'index' AND name = 'tags_label') = 1;") == 1);
+
+    OrmSchema broken; // an index on a missing column: the failing statement surfaces
+    broken.name = "broken";
+    broken.version = 1;
+    broken.fields[id.name] = id;
+    broken.indexes.push_back(OrmIndex { });
+    broken.indexes.back().fields = { "nope" };
+    REQUIRE_THROWS(st.createSchema(broken));
+}
@@ -0,0 +1,62 @@
+#include "catch.hpp"
+#include "stmtcache.hpp"
+#include <string>
+#include <vector>
+
+TEST_CASE("StmtCache: hit returns the same handle", "[stmtcache]") {
+    StmtCache<std::string> cache(4);
+    auto a = cache.put("INSERT INTO users (name) VALUES ($1);", "stmt-1");
+    auto b = cache.find("INSERT INTO users (name) VALUES ($1);");
+    REQUIRE(b);
+    REQUIRE(b.get() == a.get());
+    REQUIRE(b->handle == "stmt-1");
+    REQUIRE_FALSE(cache.find("DELETE FROM users WHERE id = $1;"));
+}
+
+TEST_CASE("StmtCache: LRU eviction calls drop for idle entries", "[stmtcache][lru]") {
+    std::vector<std::string> dropped;
+    StmtCache<std::string> cache(2, [&](StmtCache<std::string>::Entry& e) { dropped.push_back(e.handle); });
+
+    cache.put("q1", "s1");
+    cache.put("q2", "s2");
+    REQUIRE(cache.find("q1")); // q1 becomes most recently used
+    cache.put("q3", "s3");     // evicts q2
+
+    REQUIRE(cache.size() == 2);
+    REQUIRE(dropped.size() == 1);
+    REQUIRE(dropped[0] == "s2");
+    REQUIRE_FALSE(cache.find("q2"));
+    REQUIRE(cache.find("q1"));
+    REQUIRE(cache.find("q3"));
+}
+
+TEST_CASE("StmtCache: entries held by a statement are not evicted", "[stmtcache][lru]") {
+    std::vector<std::string> dropped;
+    StmtCache<std::string> cache(1, [&](StmtCache<std::string>::Entry& e) { dropped.push_back(e.handle); });
+
+    auto held = cache.put("q1", "s1");
+    cache.put("q2", "s2"); // over capacity, but both were in use while inserting
+    REQUIRE(cache.size() == 2);
+    REQUIRE(dropped.empty());
+
+    cache.put("q3", "s3"); // q2 is now idle -> evicted; q1 is still held
+    REQUIRE(dropped.size() == 1);
+    REQUIRE(dropped[0] == "s2");
+    REQUIRE(cache.find("q1"));
+
+    held.reset();
+    cache.capacity(0);
+    REQUIRE(cache.size() == 0);
+    REQUIRE(dropped.size() == 3);
+}
+
+TEST_CASE("StmtCache: clear drops every handle", "[stmtcache]") {
+    int drops = 0;
+    StmtCache<std::string> cache(8, [&](StmtCache<std::string>::Entry&) { ++drops; });
+    auto live = cache.put("q1", "s1");
+    cache.put("q2", "s2");
+    cache.clear();
+    REQUIRE(drops == 2);
+    REQUIRE(cache.size() == 0);
+    REQUIRE(live->handle.empty());
+}